@@ -0,0 +1,424 @@
+// Microbenchmark for the per-event cost of the congestion controllers.
+//
+// Replays a stream of send and ACK events through a CCC implementation
+// with set_timestamp driving virtual time, so the cost of onPktSent/onACK
+// can be measured apart from the network. The stream is either generated
+// synthetically (a fixed-rate sender over a path with a given RTT, jitter
+// and loss rate) or read from a file in the format written by 'dump='.
+//
+// For each controller it reports ns/event, heap allocations/event and,
+// where the kernel allows it, hardware cache misses/event read through
+// perf_event_open. Results can be written with 'out=' and compared against
+// an earlier run with 'baseline=', in which case the exit status is non-zero
+// if any controller regressed by more than 'tolerance'.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <linux/perf_event.h>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include "congctrls.hh"
+#include "fast_conv.hh"
+#include "markoviancc.hh"
+#include "random.hh"
+#include "remycc.hh"
+#include "slow_conv.hh"
+
+using namespace std;
+
+// see configs.hh for details
+double TRAINING_LINK_RATE = 4000000.0/1500.0;
+bool LINK_LOGGING = false;
+std::string LINK_LOGGING_FILENAME;
+
+/*************************** ALLOCATIONS ******************************/
+
+// Every heap allocation in the process goes through these, so the number of
+// allocations made while replaying is just the difference of the counter.
+static atomic<unsigned long> num_allocations(0);
+
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, memory_order_relaxed);
+  void* ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr)
+    throw bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+/************************** CACHE MISSES ******************************/
+
+// Counts hardware cache misses of this thread while enabled. If the kernel
+// does not allow it (eg. perf_event_paranoid, or inside a VM without a PMU),
+// valid() is false and stop() returns 0.
+class CacheMissCounter {
+  int fd;
+
+ public:
+  CacheMissCounter() : fd(-1) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+  ~CacheMissCounter() { if (fd >= 0) close(fd); }
+  CacheMissCounter(const CacheMissCounter&) = delete;
+  CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+  bool valid() const { return fd >= 0; }
+  void start() {
+    if (fd < 0) return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  unsigned long stop() {
+    if (fd < 0) return 0;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    unsigned long long count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+      return 0;
+    return count;
+  }
+};
+
+/**************************** EVENTS **********************************/
+
+struct Event {
+  enum Type {SENT, ACK} type;
+  double time;
+  // Sequence number for SENT, ack number (sequence number + 1, as CTCP
+  // passes it) for ACK
+  int seq;
+  double sent_time;
+  double receiver_timestamp;
+};
+
+// Generates the events seen by a sender transmitting at a constant rate
+// over a path with the given min. RTT. Each packet is lost with probability
+// 'loss' and otherwise delayed by an extra uniform(0, jitter) ms. ACKs are
+// kept in order, as if the extra delay were queuing.
+vector<Event> synthetic_events(int num_pkts, double link_rate, double rtt,
+                               double jitter, double loss, unsigned seed) {
+  PRNG prng(seed);
+  boost::random::uniform_real_distribution<> uniform(0.0, 1.0);
+  double intersend = 1000.0 / link_rate;
+
+  vector<Event> sends, acks;
+  double last_ack_time = 0.0;
+  for (int i = 0; i < num_pkts; ++i) {
+    double sent_time = 1.0 + i * intersend;
+    sends.push_back({Event::SENT, sent_time, i, sent_time, 0.0});
+    if (uniform(prng) < loss)
+      continue;
+    double ack_time = sent_time + rtt + jitter * uniform(prng);
+    ack_time = max(ack_time, last_ack_time + 1e-6);
+    last_ack_time = ack_time;
+    acks.push_back({Event::ACK, ack_time, i + 1, sent_time,
+                    ack_time - rtt / 2});
+  }
+
+  vector<Event> events;
+  events.reserve(sends.size() + acks.size());
+  merge(sends.begin(), sends.end(), acks.begin(), acks.end(),
+        back_inserter(events),
+        [](const Event& a, const Event& b) { return a.time < b.time; });
+  return events;
+}
+
+// Format: one event per line, either
+//   <time> S <seq>
+//   <time> A <ack> <sent_time> <receiver_timestamp>
+vector<Event> read_events(const string& filename) {
+  ifstream in(filename);
+  if (!in) {
+    cerr << "Could not open event file " << filename << endl;
+    exit(1);
+  }
+  vector<Event> events;
+  string line;
+  while (getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    istringstream ss(line);
+    Event e = {Event::SENT, 0, 0, 0, 0};
+    char type;
+    ss >> e.time >> type >> e.seq;
+    if (type == 'A') {
+      e.type = Event::ACK;
+      ss >> e.sent_time >> e.receiver_timestamp;
+    }
+    else
+      e.sent_time = e.time;
+    if (!ss) {
+      cerr << "Malformed event: " << line << endl;
+      exit(1);
+    }
+    events.push_back(e);
+  }
+  return events;
+}
+
+void write_events(const string& filename, const vector<Event>& events) {
+  ofstream out(filename);
+  out.precision(numeric_limits<double>::digits10 + 1);
+  for (const auto& e : events) {
+    if (e.type == Event::SENT)
+      out << e.time << " S " << e.seq << "\n";
+    else
+      out << e.time << " A " << e.seq << " " << e.sent_time << " "
+          << e.receiver_timestamp << "\n";
+  }
+}
+
+/*************************** BENCHMARK ********************************/
+
+struct Result {
+  double ns_per_event;
+  double allocs_per_event;
+  // Negative if cache misses could not be measured
+  double misses_per_event;
+};
+
+// Replays 'events' through 'congctrl' 'reps' times, calling init() before
+// each replay, and returns the fastest replay.
+template<class T>
+Result run_benchmark(T& congctrl, const vector<Event>& events, int reps) {
+  CacheMissCounter misses;
+  Result best = {numeric_limits<double>::max(), 0, -1};
+  for (int rep = 0; rep < reps; ++rep) {
+    congctrl.set_timestamp(0.0);
+    congctrl.init();
+
+    unsigned long allocs_start = num_allocations.load();
+    misses.start();
+    auto start = chrono::steady_clock::now();
+    for (const auto& e : events) {
+      congctrl.set_timestamp(e.time);
+      if (e.type == Event::SENT)
+        congctrl.onPktSent(e.seq);
+      else
+        congctrl.onACK(e.seq, e.receiver_timestamp, e.sent_time);
+    }
+    auto end = chrono::steady_clock::now();
+    unsigned long num_misses = misses.stop();
+    unsigned long allocs = num_allocations.load() - allocs_start;
+
+    double ns = chrono::duration_cast<chrono::duration<double, nano>>(
+      end - start).count() / events.size();
+    if (ns < best.ns_per_event) {
+      best.ns_per_event = ns;
+      best.allocs_per_event = double(allocs) / events.size();
+      best.misses_per_event = misses.valid() ?
+        double(num_misses) / events.size() : -1;
+    }
+  }
+  return best;
+}
+
+map<string, Result> read_results(const string& filename) {
+  map<string, Result> results;
+  ifstream in(filename);
+  if (!in) {
+    cerr << "Could not open baseline " << filename << endl;
+    exit(1);
+  }
+  string name;
+  Result r;
+  while (in >> name >> r.ns_per_event >> r.allocs_per_event
+         >> r.misses_per_event)
+    results[name] = r;
+  return results;
+}
+
+int main(int argc, char* argv[]) {
+  string cctypes = "markovian,remy,slow_conv,fast_conv,tcp";
+  string delta_conf = "do_ss:constant_delta:0.5";
+  string ratname = "";
+  string tracefile = "", dumpfile = "", outfile = "", baselinefile = "";
+  int num_pkts = 100000;
+  double link_rate = 10000; // pkts/sec
+  double rtt = 50, jitter = 5; // ms
+  double loss = 0.001;
+  unsigned seed = 1;
+  int reps = 5;
+  double tolerance = 0.1;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg.substr(0, 7) == "cctype=")
+      cctypes = arg.substr(7);
+    else if (arg.substr(0, 11) == "delta_conf=")
+      delta_conf = arg.substr(11);
+    else if (arg.substr(0, 3) == "if=")
+      ratname = arg.substr(3);
+    else if (arg.substr(0, 6) == "trace=")
+      tracefile = arg.substr(6);
+    else if (arg.substr(0, 5) == "dump=")
+      dumpfile = arg.substr(5);
+    else if (arg.substr(0, 4) == "out=")
+      outfile = arg.substr(4);
+    else if (arg.substr(0, 9) == "baseline=")
+      baselinefile = arg.substr(9);
+    else if (arg.substr(0, 9) == "num_pkts=")
+      num_pkts = atoi(arg.substr(9).c_str());
+    else if (arg.substr(0, 9) == "linkrate=")
+      link_rate = atof(arg.substr(9).c_str());
+    else if (arg.substr(0, 4) == "rtt=")
+      rtt = atof(arg.substr(4).c_str());
+    else if (arg.substr(0, 7) == "jitter=")
+      jitter = atof(arg.substr(7).c_str());
+    else if (arg.substr(0, 5) == "loss=")
+      loss = atof(arg.substr(5).c_str());
+    else if (arg.substr(0, 5) == "seed=")
+      seed = atoi(arg.substr(5).c_str());
+    else if (arg.substr(0, 5) == "reps=")
+      reps = atoi(arg.substr(5).c_str());
+    else if (arg.substr(0, 10) == "tolerance=")
+      tolerance = atof(arg.substr(10).c_str());
+    else {
+      fprintf(stderr, "Unrecognised option '%s'.\n", arg.c_str());
+      fprintf(stderr, "Usage: ccbench [cctype=markovian,remy,slow_conv,fast_conv,tcp] [delta_conf=(for MarkovianCC)] [if=(ratname)] [trace=(event file)|num_pkts= linkrate=(packets/sec) rtt=(ms) jitter=(ms) loss= seed=] [dump=(event file)] [reps=] [out=(results file)] [baseline=(results file)] [tolerance=]\n");
+      exit(1);
+    }
+  }
+
+  vector<Event> events;
+  if (tracefile != "")
+    events = read_events(tracefile);
+  else
+    events = synthetic_events(num_pkts, link_rate, rtt, jitter, loss, seed);
+  if (events.empty()) {
+    fprintf(stderr, "No events to replay.\n");
+    exit(1);
+  }
+  if (dumpfile != "")
+    write_events(dumpfile, events);
+
+  // The controllers print diagnostics on init(). Keep those away from the
+  // results.
+  streambuf* stdout_buf = cout.rdbuf();
+  ofstream devnull("/dev/null");
+
+  map<string, Result> results;
+  stringstream cctype_list(cctypes);
+  string cctype;
+  while (getline(cctype_list, cctype, ',')) {
+    cout.rdbuf(devnull.rdbuf());
+    if (cctype == "markovian") {
+      MarkovianCC congctrl(1.0);
+      congctrl.interpret_config_str(delta_conf);
+      results[cctype] = run_benchmark(congctrl, events, reps);
+    }
+    else if (cctype == "remy") {
+      if (ratname == "") {
+        cout.rdbuf(stdout_buf);
+        fprintf(stderr, "Skipping remy: specify the rat with if=<filename>\n");
+        continue;
+      }
+      int fd = open(ratname.c_str(), O_RDONLY);
+      if (fd < 0) {
+        perror("open");
+        exit(1);
+      }
+      RemyBuffers::WhiskerTree tree;
+      if (!tree.ParseFromFileDescriptor(fd)) {
+        fprintf(stderr, "Could not parse %s.\n", ratname.c_str());
+        exit(1);
+      }
+      close(fd);
+      WhiskerTree whiskers(tree);
+      RemyCC congctrl(whiskers);
+      results[cctype] = run_benchmark(congctrl, events, reps);
+    }
+    else if (cctype == "slow_conv") {
+      SlowConv congctrl;
+      results[cctype] = run_benchmark(congctrl, events, reps);
+    }
+    else if (cctype == "fast_conv") {
+      FastConv congctrl;
+      results[cctype] = run_benchmark(congctrl, events, reps);
+    }
+    else if (cctype == "tcp") {
+      DefaultCC congctrl;
+      results[cctype] = run_benchmark(congctrl, events, reps);
+    }
+    else {
+      cout.rdbuf(stdout_buf);
+      fprintf(stderr, "Unrecognised congestion control protocol '%s'.\n",
+              cctype.c_str());
+      exit(1);
+    }
+  }
+  cout.rdbuf(stdout_buf);
+
+  printf("Replayed %lu events, best of %d\n", events.size(), reps);
+  printf("%-12s %12s %14s %14s\n", "cctype", "ns/event", "allocs/event",
+         "misses/event");
+  for (const auto& x : results) {
+    char misses[32] = "-";
+    if (x.second.misses_per_event >= 0)
+      snprintf(misses, sizeof(misses), "%.3f", x.second.misses_per_event);
+    printf("%-12s %12.1f %14.3f %14s\n", x.first.c_str(),
+           x.second.ns_per_event, x.second.allocs_per_event, misses);
+  }
+
+  if (outfile != "") {
+    ofstream out(outfile);
+    for (const auto& x : results)
+      out << x.first << " " << x.second.ns_per_event << " "
+          << x.second.allocs_per_event << " " << x.second.misses_per_event
+          << "\n";
+  }
+
+  int regressions = 0;
+  if (baselinefile != "") {
+    map<string, Result> baseline = read_results(baselinefile);
+    for (const auto& x : results) {
+      if (baseline.count(x.first) == 0)
+        continue;
+      const Result& old = baseline[x.first];
+      if (x.second.ns_per_event > old.ns_per_event * (1 + tolerance)) {
+        printf("REGRESSION %s: %.1f ns/event (baseline %.1f)\n",
+               x.first.c_str(), x.second.ns_per_event, old.ns_per_event);
+        ++ regressions;
+      }
+      if (x.second.allocs_per_event > old.allocs_per_event + 1e-3) {
+        printf("REGRESSION %s: %.3f allocs/event (baseline %.3f)\n",
+               x.first.c_str(), x.second.allocs_per_event,
+               old.allocs_per_event);
+        ++ regressions;
+      }
+    }
+  }
+  return regressions == 0 ? 0 : 1;
+}
@@ -26,8 +26,15 @@ public:
   virtual void onPktSent( int seq_num __attribute((unused)) ) { }
   virtual void onDupACK() {}
   virtual void onTimeout() {}
+  // An ACK echoed an ECN congestion mark. Called at most once per window
+  // of data.
+  virtual void onECNMark() {}
   
   virtual void onLinkRateMeasurement( double measured_link_rate __attribute((unused)) ) {}
+  // Internal state worth watching live (see live-stats.hh), such as
+  // Copa's delta. Stores up to 'max' names (string literals) and values
+  // and returns how many.
+  virtual int get_state( const char** names __attribute((unused)), double* values __attribute((unused)), int max __attribute((unused)) ) const { return 0; }
   //virtual void onPktReceived(const CPacket* pkt) {}
   //virtual void processCustomMsg(const CPacket& pkt) {}
 
@@ -37,6 +44,8 @@ public:
   
   void set_timestamp(double) {}
   void set_min_rtt(double) {}
+  // Packets in the flow about to start, if known (see MarkovianCC)
+  void set_flow_length(int) {}
 
 protected:
   void setRTO(const int& usRTO){ _timeout = usRTO/1000.0;}
@@ -0,0 +1,244 @@
+// Aggregates the results the sender writes with 'results=' (see
+// results.hh) over any number of runs into a table, with a row per value
+// of the run options named in 'by='. Files are read in parallel.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "results.hh"
+#include "thread-pool.hh"
+
+using namespace std;
+
+// The flows of runs with the same values of the 'by=' options
+struct Group {
+  uint64_t runs, flows;
+  // Throughput is weighted by time and delay by packets, as
+  // parsing_scripts/analyse_data.py does
+  double time, throughput_time, packets, delay_packets;
+  double packets_sent, packets_lost;
+  vector<double> throughputs, rtt_p95s;
+
+  Group()
+    : runs(0), flows(0), time(0), throughput_time(0), packets(0),
+      delay_packets(0), packets_sent(0), packets_lost(0), throughputs(),
+      rtt_p95s() {}
+
+  void merge(const Group& other) {
+    runs += other.runs;
+    flows += other.flows;
+    time += other.time;
+    throughput_time += other.throughput_time;
+    packets += other.packets;
+    delay_packets += other.delay_packets;
+    packets_sent += other.packets_sent;
+    packets_lost += other.packets_lost;
+    throughputs.insert(throughputs.end(), other.throughputs.begin(),
+                       other.throughputs.end());
+    rtt_p95s.insert(rtt_p95s.end(), other.rtt_p95s.begin(),
+                    other.rtt_p95s.end());
+  }
+};
+
+// What is aggregated of a flow
+struct FlowResult {
+  double time, throughput, packets_acked, delay, packets_sent, packets_lost,
+    rtt_p95;
+};
+
+struct FileResult {
+  map<string, Group> groups;
+  uint64_t bad_lines;
+  bool read;
+  FileResult() : groups(), bad_lines(0), read(false) {}
+};
+
+static const string* find_field(const ResultFields& fields, const string& key) {
+  for (const auto& f : fields)
+    if (f.first == key)
+      return &f.second;
+  return nullptr;
+}
+
+static double number(const ResultFields& fields, const string& key) {
+  const string* value = find_field(fields, key);
+  return value ? atof(value->c_str()) : 0;
+}
+
+static void read_file(const string& filename, const vector<string>& by,
+                      FileResult& result) {
+  FILE* f = fopen(filename.c_str(), "rb");
+  if (f == nullptr) {
+    perror(filename.c_str());
+    return;
+  }
+  string text;
+  char buf[1 << 16];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    text.append(buf, n);
+  fclose(f);
+  result.read = true;
+
+  // The run record comes first, but is not relied on
+  ResultFields fields, run;
+  vector<FlowResult> flows;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find('\n', pos);
+    if (end == string::npos)
+      end = text.size();
+    if (end > pos) {
+      if (!parse_result(text.data() + pos, text.data() + end, fields))
+        result.bad_lines++;
+      else {
+        const string* type = find_field(fields, "type");
+        if (type != nullptr && *type == "run")
+          run.swap(fields);
+        else if (type != nullptr && *type == "flow")
+          flows.push_back({number(fields, "duration_ms") / 1e3,
+                           number(fields, "throughput_pps"),
+                           number(fields, "packets_acked"),
+                           number(fields, "delay_s") * 1e3,
+                           number(fields, "packets_sent"),
+                           number(fields, "packets_lost"),
+                           number(fields, "rtt_p95_ms")});
+      }
+    }
+    pos = end + 1;
+  }
+
+  if (run.empty() && flows.empty())
+    return;
+  string key;
+  for (size_t i = 0; i < by.size(); i++) {
+    const string* value = find_field(run, by[i]);
+    key += (i ? "\t" : "") + (value ? *value : string("-"));
+  }
+  Group& group = result.groups[key];
+  group.runs++;
+  for (const auto& flow : flows) {
+    group.flows++;
+    group.time += flow.time;
+    group.throughput_time += flow.throughput * flow.time;
+    group.packets += flow.packets_acked;
+    group.delay_packets += flow.delay * flow.packets_acked;
+    group.packets_sent += flow.packets_sent;
+    group.packets_lost += flow.packets_lost;
+    group.throughputs.push_back(flow.throughput);
+    group.rtt_p95s.push_back(flow.rtt_p95);
+  }
+}
+
+// Of sorted values
+static double percentile(const vector<double>& sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  size_t i = p / 100 * (sorted.size() - 1) + 0.5;
+  return sorted[min(i, sorted.size() - 1)];
+}
+
+static void add_directory(const string& dirname, vector<string>& files) {
+  DIR* dir = opendir(dirname.c_str());
+  if (dir == nullptr) {
+    perror(dirname.c_str());
+    exit(1);
+  }
+  vector<string> names;
+  while (struct dirent* entry = readdir(dir)) {
+    string path = dirname + "/" + entry->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+      names.push_back(path);
+  }
+  closedir(dir);
+  sort(names.begin(), names.end());
+  files.insert(files.end(), names.begin(), names.end());
+}
+
+int main(int argc, char* argv[]) {
+  vector<string> files;
+  vector<string> by = {"cctype"};
+  int num_threads = 0;
+  bool usage = argc < 2;
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+    if (arg.substr(0, 5) == "file=")
+      files.push_back(arg.substr(5));
+    else if (arg.substr(0, 4) == "dir=")
+      add_directory(arg.substr(4), files);
+    else if (arg.substr(0, 3) == "by=") {
+      by.clear();
+      string list = arg.substr(3);
+      size_t start = 0;
+      while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == string::npos)
+          end = list.size();
+        if (end > start)
+          by.push_back(list.substr(start, end - start));
+        start = end + 1;
+      }
+    }
+    else if (arg.substr(0, 8) == "threads=")
+      num_threads = atoi(arg.substr(8).c_str());
+    else {
+      fprintf(stderr, "Unrecognised option '%s'.\n", arg.c_str());
+      usage = true;
+    }
+  }
+  if (usage) {
+    fprintf(stderr, "Usage: ccresults file=(results of a sender, repeatable) dir=(of results, repeatable) [by=(comma separated sender options to group runs by, default cctype)] [threads=(0 for one per core)]\n");
+    exit(1);
+  }
+
+  auto start = chrono::steady_clock::now();
+  vector<FileResult> results(files.size());
+  ThreadPool pool(num_threads);
+  pool.run(files.size(), [&](size_t i) {
+    read_file(files[i], by, results[i]);
+  });
+
+  map<string, Group> groups;
+  uint64_t bad_lines = 0, files_read = 0;
+  for (auto& result : results) {
+    for (const auto& g : result.groups)
+      groups[g.first].merge(g.second);
+    bad_lines += result.bad_lines;
+    files_read += result.read;
+  }
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now() -
+                                            start).count();
+  fprintf(stderr, "Read %llu of %zu files in %.3f s.\n",
+          (unsigned long long) files_read, files.size(), elapsed);
+  if (bad_lines > 0)
+    fprintf(stderr, "Skipped %llu lines that are not results.\n",
+            (unsigned long long) bad_lines);
+
+  for (const auto& key : by)
+    printf("%s\t", key.c_str());
+  printf("runs\tflows\tthroughput_pps\tdelay_ms\tthroughput_p10\tthroughput_p50\tthroughput_p90\trtt_p95_median_ms\tloss_rate\n");
+  for (auto& g : groups) {
+    Group& group = g.second;
+    sort(group.throughputs.begin(), group.throughputs.end());
+    sort(group.rtt_p95s.begin(), group.rtt_p95s.end());
+    printf("%s\t%llu\t%llu\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.6f\n",
+           g.first.c_str(), (unsigned long long) group.runs,
+           (unsigned long long) group.flows,
+           group.time > 0 ? group.throughput_time / group.time : 0,
+           group.packets > 0 ? group.delay_packets / group.packets : 0,
+           percentile(group.throughputs, 10),
+           percentile(group.throughputs, 50),
+           percentile(group.throughputs, 90),
+           percentile(group.rtt_p95s, 50),
+           group.packets_sent > 0 ? group.packets_lost / group.packets_sent : 0);
+  }
+  return 0;
+}
@@ -0,0 +1,233 @@
+// Runs congestion controllers over a simulated dumbbell network in
+// virtual time: any number of senders share one bottleneck link with a
+// given rate, buffer and propagation delay. A 100 s experiment takes a few
+// seconds of CPU and gives the same results every time for the same
+// options (including 'seed'). With model=fluid the same experiment is
+// approximated by the fluid model in fluid-model.hh instead. With
+// topology=, the links and flows come from a topology file (see
+// topology.hh) and results are reported per flow and per link.
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "dumbbell.hh"
+#include "fluid-model.hh"
+#include "topology.hh"
+
+using namespace std;
+
+// see configs.hh for details
+double TRAINING_LINK_RATE = 4000000.0/1500.0;
+bool LINK_LOGGING = false;
+std::string LINK_LOGGING_FILENAME;
+
+// Splits a comma separated list
+vector<string> split_list(const string& list) {
+  vector<string> res;
+  stringstream ss(list);
+  string item;
+  while (getline(ss, item, ','))
+    res.push_back(item);
+  return res;
+}
+
+void print_topology_result(const TopologyResult& result, double duration,
+                           double cpu_time) {
+  printf("Simulated %.1f s in %.3f s of CPU (%lu events)\n", duration / 1000,
+         cpu_time, (unsigned long)result.num_events);
+  printf("%-16s %-10s %16s %12s %12s %10s %10s\n", "flow", "cctype",
+         "tput(pkts/s)", "avg_rtt(ms)", "base_rtt(ms)", "sent", "drops(%)");
+  for (const TopologyResult::Flow& f : result.flows)
+    printf("%-16s %-10s %16.1f %12.2f %12.2f %10ld %10.3f\n", f.name.c_str(),
+           f.cctype.c_str(), f.throughput, f.avg_rtt, f.base_rtt, f.pkts_sent,
+           f.pkts_sent ? 100.0 * f.pkts_dropped / f.pkts_sent : 0.0);
+  for (const TopologyResult::Link& l : result.links)
+    printf("Link %s: utilization %.1f%%, avg. queue %.1f pkts, max. queue %d pkts, %ld drops, %ld marks\n",
+           l.name.c_str(), 100.0 * l.utilization, l.avg_queue, l.max_queue,
+           l.drops, l.marks);
+  for (const auto& sample : result.fairness)
+    printf("Fairness at %.1f s: %.4f\n", sample.first / 1000, sample.second);
+  printf("Jain's fairness index: %.4f\n", result.jain_index);
+}
+
+int main(int argc, char* argv[]) {
+  DumbbellConfig config;
+  string ratname = "", model = "packet", topology_file = "";
+  double step = 0.5, interval = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg.substr(0, 7) == "cctype=")
+      config.cctypes = split_list(arg.substr(7));
+    else if (arg.substr(0, 11) == "delta_conf=")
+      config.delta_conf = arg.substr(11);
+    else if (arg.substr(0, 3) == "if=")
+      ratname = arg.substr(3);
+    else if (arg.substr(0, 12) == "num_senders=")
+      config.num_senders = atoi(arg.substr(12).c_str());
+    else if (arg.substr(0, 9) == "linkrate=")
+      config.link_rate = atof(arg.substr(9).c_str());
+    else if (arg.substr(0, 6) == "delay=")
+      config.delay = atof(arg.substr(6).c_str());
+    else if (arg.substr(0, 12) == "extra_delay=") {
+      config.extra_delays.clear();
+      for (const string& x : split_list(arg.substr(12)))
+        config.extra_delays.push_back(atof(x.c_str()));
+    }
+    else if (arg.substr(0, 7) == "buffer=")
+      config.buffer = atoi(arg.substr(7).c_str());
+    else if (arg.substr(0, 6) == "queue=")
+      config.queue = arg.substr(6);
+    else if (arg.substr(0, 11) == "queue_args=")
+      config.queue_args = arg.substr(11);
+    else if (arg.substr(0, 4) == "ecn=")
+      config.ecn = atoi(arg.substr(4).c_str()) != 0;
+    else if (arg.substr(0, 9) == "duration=")
+      config.duration = atof(arg.substr(9).c_str());
+    else if (arg.substr(0, 11) == "onduration=")
+      config.onduration = atof(arg.substr(11).c_str());
+    else if (arg.substr(0, 12) == "offduration=")
+      config.offduration = atof(arg.substr(12).c_str());
+    else if (arg.substr(0, 15) == "traffic_params=")
+      config.traffic_params = arg.substr(15);
+    else if (arg.substr(0, 6) == "model=")
+      model = arg.substr(6);
+    else if (arg.substr(0, 5) == "step=")
+      step = atof(arg.substr(5).c_str());
+    else if (arg.substr(0, 13) == "train_length=")
+      config.train_length = atoi(arg.substr(13).c_str());
+    else if (arg.substr(0, 5) == "seed=")
+      config.seed = atoi(arg.substr(5).c_str());
+    else if (arg.substr(0, 9) == "topology=")
+      topology_file = arg.substr(9);
+    else if (arg.substr(0, 9) == "interval=")
+      interval = atof(arg.substr(9).c_str());
+    else {
+      fprintf(stderr, "Unrecognised option '%s'.\n", arg.c_str());
+      fprintf(stderr, "Usage: ccsim [model=packet|fluid] [cctype=markovian|remy|slow_conv|fast_conv|tcp|cubic,...] [delta_conf=(for MarkovianCC)] [if=(ratname)] [num_senders=] [linkrate=(packets/sec)] [delay=(one-way ms)] [extra_delay=(ms,...)] [buffer=(packets)] [queue=droptail|infinite|codel|fq_codel|red|pie] [queue_args=] [ecn=0|1] [duration=(ms)] [onduration=] [offduration=] [traffic_params=] [train_length=] [seed=] [step=(ms, for the fluid model)] [topology=(filename)] [interval=(ms)]\n");
+      exit(1);
+    }
+  }
+
+  if (config.num_senders < 1 || config.cctypes.empty() ||
+      config.extra_delays.empty()) {
+    fprintf(stderr, "Need at least one sender, cctype and extra_delay.\n");
+    exit(1);
+  }
+  if (model != "packet" && model != "fluid") {
+    fprintf(stderr, "Unrecognised model '%s'.\n", model.c_str());
+    exit(1);
+  }
+  bool fluid = (model == "fluid");
+  Topology topology;
+  if (topology_file != "") {
+    if (fluid) {
+      fprintf(stderr, "The fluid model does not support topologies.\n");
+      exit(1);
+    }
+    if (!read_topology(topology_file, topology))
+      exit(1);
+    // Senders come from the topology
+    config.cctypes.clear();
+    for (const TopologyFlow& flow : topology.flows)
+      config.cctypes.push_back(flow.cctype);
+    for (size_t i = 0; i < topology.links.size(); ++i) {
+      if (topology.links[i].rate <= 0) {
+        fprintf(stderr, "Link '%s' needs a 'rate' in the simulator.\n",
+                topology.links[i].name.c_str());
+        exit(1);
+      }
+      if (make_topology_queue(topology, i) == nullptr)
+        exit(1);
+    }
+  }
+  if (fluid && step <= 0) {
+    fprintf(stderr, "step must be positive.\n");
+    exit(1);
+  }
+  if (fluid && (config.queue != "droptail" || config.queue_args != "" ||
+                config.ecn)) {
+    fprintf(stderr, "The fluid model only has a droptail buffer without ECN.\n");
+    exit(1);
+  }
+  if (!fluid && topology_file == "" && make_dumbbell_queue(config) == nullptr)
+    exit(1);
+  bool need_rat = false;
+  for (const string& cctype : config.cctypes) {
+    if (fluid ? !is_valid_fluid_cctype(cctype) : !is_valid_cctype(cctype)) {
+      fprintf(stderr, "Unrecognised congestion control protocol '%s' for the %s model.\n",
+              cctype.c_str(), model.c_str());
+      exit(1);
+    }
+    if (fluid && cctype == "markovian" &&
+        !is_valid_fluid_delta_conf(config.delta_conf)) {
+      fprintf(stderr, "The fluid model does not support delta_conf '%s'.\n",
+              config.delta_conf.c_str());
+      exit(1);
+    }
+    need_rat |= (cctype == "remy");
+  }
+
+  WhiskerTree whiskers;
+  if (ratname != "") {
+    int fd = open(ratname.c_str(), O_RDONLY);
+    if (fd < 0) {
+      perror("open");
+      exit(1);
+    }
+    RemyBuffers::WhiskerTree tree;
+    if (!tree.ParseFromFileDescriptor(fd)) {
+      fprintf(stderr, "Could not parse %s.\n", ratname.c_str());
+      exit(1);
+    }
+    close(fd);
+    whiskers = WhiskerTree(tree);
+    config.whiskers = &whiskers;
+  }
+  else if (need_rat) {
+    fprintf(stderr, "Please specify remy specification file using if=<filename>\n");
+    exit(1);
+  }
+
+  // The controllers print diagnostics on init(). Keep those away from the
+  // results.
+  cout.setstate(ios::badbit);
+  if (topology_file != "") {
+    clock_t start = clock();
+    TopologyResult result = run_topology(topology, config.whiskers,
+                                         config.duration, interval, config.seed);
+    double cpu_time = double(clock() - start) / CLOCKS_PER_SEC;
+    cout.clear();
+    print_topology_result(result, config.duration, cpu_time);
+    return 0;
+  }
+  clock_t start = clock();
+  DumbbellResult result = fluid ? run_dumbbell_fluid(config, step) :
+    run_dumbbell(config);
+  double cpu_time = double(clock() - start) / CLOCKS_PER_SEC;
+  cout.clear();
+
+  printf("Simulated %.1f s in %.3f s of CPU (%lu %s)\n",
+         config.duration / 1000, cpu_time, (unsigned long)result.num_events,
+         fluid ? "steps" : "events");
+  printf("%-6s %-10s %16s %12s %10s %10s\n", "sender", "cctype",
+         "tput(pkts/s)", "avg_rtt(ms)", "sent", "drops(%)");
+  for (size_t i = 0; i < result.senders.size(); ++i) {
+    const DumbbellResult::Sender& s = result.senders[i];
+    printf("%-6lu %-10s %16.1f %12.2f %10ld %10.3f\n", i, s.cctype.c_str(),
+           s.throughput, s.avg_rtt, s.pkts_sent,
+           s.pkts_sent ? 100.0 * s.pkts_dropped / s.pkts_sent : 0.0);
+  }
+  printf("Link: utilization %.1f%%, avg. queue %.1f pkts, max. queue %d pkts, %ld drops, %ld marks\n",
+         100.0 * result.utilization, result.avg_queue, result.max_queue,
+         result.drops, result.marks);
+  printf("Jain's fairness index: %.4f\n", result.jain_index);
+  return 0;
+}
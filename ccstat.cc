@@ -0,0 +1,137 @@
+// Samples the live statistics of running senders and receivers (see
+// live-stats.hh) and prints a line per flow per sample.
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "live-stats.hh"
+
+using namespace std;
+
+struct Segment {
+  string name;
+  unique_ptr<LiveStats> stats;
+};
+
+// The names of all the segments in /dev/shm
+static vector<string> find_segments() {
+  vector<string> names;
+  const string prefix = "genericcc.";
+  DIR* dir = opendir("/dev/shm");
+  if (dir == nullptr)
+    return names;
+  while (struct dirent* entry = readdir(dir)) {
+    string file(entry->d_name);
+    if (file.compare(0, prefix.size(), prefix) == 0)
+      names.push_back(file.substr(prefix.size()));
+  }
+  closedir(dir);
+  return names;
+}
+
+static void open_segments(const vector<string>& names,
+                          vector<Segment>& segments) {
+  segments.clear();
+  for (const auto& name : names) {
+    LiveStats* stats = LiveStats::open(name);
+    if (stats == nullptr)
+      continue;
+    // A segment left behind by a process that was killed
+    if (kill(stats->pid(), 0) < 0 && errno == ESRCH) {
+      delete stats;
+      continue;
+    }
+    segments.push_back(Segment{name, unique_ptr<LiveStats>(stats)});
+  }
+}
+
+int main(int argc, char* argv[]) {
+  vector<string> names;
+  double rate = 1;
+  long count = 0;
+  bool all = false;
+
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+    if (arg.substr(0, 5) == "name=")
+      names.push_back(arg.substr(5));
+    else if (arg.substr(0, 5) == "rate=")
+      rate = atof(arg.substr(5).c_str());
+    else if (arg.substr(0, 6) == "count=")
+      count = atol(arg.substr(6).c_str());
+    else if (arg.substr(0, 4) == "all=")
+      all = atoi(arg.substr(4).c_str()) != 0;
+    else {
+      fprintf(stderr, "Unrecognised option '%s'.\n", arg.c_str());
+      fprintf(stderr, "Usage: ccstat [name=(segment, repeatable; default all)] [rate=(samples/sec)] [count=(samples, 0 for ever)] [all=(1 to include finished flows)]\n");
+      exit(1);
+    }
+  }
+  if (rate <= 0) {
+    fprintf(stderr, "'rate' must be positive.\n");
+    exit(1);
+  }
+  const bool scan = names.empty();
+
+  vector<Segment> segments;
+  open_segments(scan ? find_segments() : names, segments);
+
+  printf("time\tname\trole\tpid\tsrc_id\tflow_id\tstate\tduration\tsent\tacked\tlosses\tcwnd\tintersend\tmin_rtt\tsrtt\trtt\tlink_rate\tcc_state\n");
+
+  const auto period = chrono::duration_cast<chrono::steady_clock::duration>(
+    chrono::duration<double>(1.0 / rate));
+  const auto start = chrono::steady_clock::now();
+  auto next = start;
+  auto last_open = start;
+  FlowStats stats;
+  for (long sample = 0; count == 0 || sample < count; sample++) {
+    this_thread::sleep_until(next);
+    next += period;
+
+    auto now = chrono::steady_clock::now();
+    // Pick up senders and receivers started since, once a second
+    if (now - last_open > chrono::seconds(1)) {
+      open_segments(scan ? find_segments() : names, segments);
+      last_open = now;
+    }
+
+    double t = chrono::duration<double>(now - start).count();
+    for (const auto& segment : segments) {
+      for (unsigned i = 0; i < segment.stats->num_slots(); i++) {
+        if (!segment.stats->read(i, stats) || stats.state == FlowStats::FREE)
+          continue;
+        if (stats.state == FlowStats::FINISHED && !all)
+          continue;
+        printf("%.6f\t%s\t%c\t%d\t%d\t%d\t%s\t%.1f\t%llu\t%llu\t%llu\t%g\t%g\t%g\t%g\t%g\t%g\t",
+               t, segment.name.c_str(), segment.stats->role(),
+               segment.stats->pid(), stats.src_id, stats.flow_id,
+               stats.state == FlowStats::ACTIVE ? "active" : "finished",
+               stats.duration, (unsigned long long) stats.packets_sent,
+               (unsigned long long) stats.packets_acked,
+               (unsigned long long) stats.losses, stats.cwnd,
+               stats.intersend_time, stats.min_rtt, stats.srtt,
+               stats.last_rtt, stats.link_rate);
+        // name=value pairs
+        stats.cc_state_names[sizeof(stats.cc_state_names) - 1] = '\0';
+        char* saveptr = nullptr;
+        char* name = strtok_r(stats.cc_state_names, ",", &saveptr);
+        for (unsigned j = 0; j < stats.num_cc_state && j < STATS_STATE_SIZE && name; j++) {
+          printf("%s%s=%g", j ? "," : "", name, stats.cc_state[j]);
+          name = strtok_r(nullptr, ",", &saveptr);
+        }
+        printf("\n");
+      }
+    }
+    fflush(stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,340 @@
+// Runs a grid of simulated experiments (see dumbbell.hh) in parallel and
+// writes one line of results per experiment. Every dimension of the grid
+// is given by repeating its option, e.g.
+//
+//   ccsweep cctype=markovian cctype=tcp linkrate=1000 linkrate=10000
+//           rtt=20 rtt=100 num_senders=1 num_senders=4 runs=5
+//
+// runs 2*2*2*2*5 = 80 experiments. delta_conf is only varied for
+// experiments that contain a MarkovianCC sender. Experiments are spread
+// over all hardware threads (or threads=) and results are written as soon
+// as each finishes, tagged with the experiment's index in the grid, so a
+// sweep that is interrupted keeps what it has done. With model=fluid the
+// experiments use the fluid model (fluid-model.hh), which is cheap enough
+// to prune large grids before running them packet by packet.
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "dumbbell.hh"
+#include "fluid-model.hh"
+#include "thread-pool.hh"
+
+using namespace std;
+
+// see configs.hh for details
+double TRAINING_LINK_RATE = 4000000.0/1500.0;
+bool LINK_LOGGING = false;
+std::string LINK_LOGGING_FILENAME;
+
+struct Experiment {
+  DumbbellConfig config;
+  string cctype;
+  string delta_conf;
+  double rtt;
+  string buffer;
+  string queue;
+
+  Experiment() :
+    config(), cctype(), delta_conf(), rtt(0), buffer(), queue()
+  {}
+};
+
+// Splits a comma separated list
+vector<string> split_list(const string& list) {
+  vector<string> res;
+  stringstream ss(list);
+  string item;
+  while (getline(ss, item, ','))
+    res.push_back(item);
+  return res;
+}
+
+// A buffer is given in packets, or as a multiple of the bandwidth-delay
+// product if it ends with 'bdp' (e.g. 0.5bdp)
+int parse_buffer(const string& buffer, double link_rate, double rtt) {
+  if (buffer.size() > 3 && buffer.substr(buffer.size() - 3) == "bdp")
+    return max(1, int(atof(buffer.c_str()) * link_rate * rtt / 1000));
+  return atoi(buffer.c_str());
+}
+
+// A queue is given as its type, optionally followed by ':' and its
+// arguments (e.g. red:min_th=5,max_th=15,ecn=1)
+void split_queue(const string& queue, string& type, string& args) {
+  size_t colon = queue.find(':');
+  type = queue.substr(0, colon);
+  args = (colon == string::npos) ? "" : queue.substr(colon + 1);
+}
+
+void write_result(FILE* out, size_t id, const Experiment& exp,
+                  const DumbbellResult& res, double cpu_time) {
+  double tput_sum = 0, rtt_sum = 0;
+  long sent = 0, dropped = 0, marked = 0;
+  stringstream tputs;
+  for (size_t i = 0; i < res.senders.size(); ++i) {
+    const DumbbellResult::Sender& s = res.senders[i];
+    tput_sum += s.throughput;
+    rtt_sum += s.avg_rtt;
+    sent += s.pkts_sent;
+    dropped += s.pkts_dropped;
+    marked += s.pkts_marked;
+    tputs << (i ? "," : "") << int(s.throughput + 0.5);
+  }
+  fprintf(out, "%lu\t%s\t%s\t%g\t%g\t%s\t%s\t%d\t%s\t%u\t"
+          "%.4f\t%.2f\t%.2f\t%.2f\t%.5f\t%.5f\t%.4f\t%s\t%.3f\n",
+          id, exp.cctype.c_str(), exp.delta_conf.c_str(),
+          exp.config.link_rate, exp.rtt, exp.buffer.c_str(),
+          exp.queue.c_str(), exp.config.num_senders,
+          exp.config.traffic_params.c_str(), exp.config.seed,
+          res.utilization, res.avg_queue, tput_sum,
+          rtt_sum / res.senders.size(),
+          sent ? double(dropped) / sent : 0.0,
+          sent ? double(marked) / sent : 0.0, res.jain_index,
+          tputs.str().c_str(), cpu_time);
+  fflush(out);
+}
+
+int main(int argc, char* argv[]) {
+  vector<string> cctypes, delta_confs, buffers, queues, traffic_params;
+  vector<double> link_rates, rtts;
+  vector<int> num_senders;
+  DumbbellConfig base;
+  string ratname = "", outname = "-", model = "packet";
+  double step = 0.5;
+  int runs = 1, num_threads = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg.substr(0, 7) == "cctype=")
+      cctypes.push_back(arg.substr(7));
+    else if (arg.substr(0, 11) == "delta_conf=")
+      delta_confs.push_back(arg.substr(11));
+    else if (arg.substr(0, 9) == "linkrate=")
+      link_rates.push_back(atof(arg.substr(9).c_str()));
+    else if (arg.substr(0, 4) == "rtt=")
+      rtts.push_back(atof(arg.substr(4).c_str()));
+    else if (arg.substr(0, 7) == "buffer=")
+      buffers.push_back(arg.substr(7));
+    else if (arg.substr(0, 6) == "queue=")
+      queues.push_back(arg.substr(6));
+    else if (arg.substr(0, 4) == "ecn=")
+      base.ecn = atoi(arg.substr(4).c_str()) != 0;
+    else if (arg.substr(0, 12) == "num_senders=")
+      num_senders.push_back(atoi(arg.substr(12).c_str()));
+    else if (arg.substr(0, 15) == "traffic_params=")
+      traffic_params.push_back(arg.substr(15));
+    else if (arg.substr(0, 3) == "if=")
+      ratname = arg.substr(3);
+    else if (arg.substr(0, 9) == "duration=")
+      base.duration = atof(arg.substr(9).c_str());
+    else if (arg.substr(0, 11) == "onduration=")
+      base.onduration = atof(arg.substr(11).c_str());
+    else if (arg.substr(0, 12) == "offduration=")
+      base.offduration = atof(arg.substr(12).c_str());
+    else if (arg.substr(0, 6) == "model=")
+      model = arg.substr(6);
+    else if (arg.substr(0, 5) == "step=")
+      step = atof(arg.substr(5).c_str());
+    else if (arg.substr(0, 13) == "train_length=")
+      base.train_length = atoi(arg.substr(13).c_str());
+    else if (arg.substr(0, 5) == "runs=")
+      runs = atoi(arg.substr(5).c_str());
+    else if (arg.substr(0, 8) == "threads=")
+      num_threads = atoi(arg.substr(8).c_str());
+    else if (arg.substr(0, 4) == "out=")
+      outname = arg.substr(4);
+    else {
+      fprintf(stderr, "Unrecognised option '%s'.\n", arg.c_str());
+      fprintf(stderr, "Usage: ccsweep [model=packet|fluid] [cctype=markovian|remy|slow_conv|fast_conv|tcp|cubic[,...]]... [delta_conf=]... [linkrate=(packets/sec)]... [rtt=(ms)]... [buffer=(packets)|(x)bdp]... [queue=(type)[:(args)]]... [ecn=0|1] [num_senders=]... [traffic_params=]... [if=(ratname)] [duration=(ms)] [onduration=] [offduration=] [train_length=] [step=(ms, for the fluid model)] [runs=] [threads=] [out=(filename)]\n");
+      exit(1);
+    }
+  }
+
+  // Dimensions that were not given take ccsim's defaults
+  if (cctypes.empty()) cctypes.push_back("markovian");
+  if (delta_confs.empty()) delta_confs.push_back(base.delta_conf);
+  if (link_rates.empty()) link_rates.push_back(base.link_rate);
+  if (rtts.empty()) rtts.push_back(2 * base.delay);
+  if (buffers.empty()) buffers.push_back("1bdp");
+  if (queues.empty()) queues.push_back(base.queue);
+  if (num_senders.empty()) num_senders.push_back(base.num_senders);
+  if (traffic_params.empty()) traffic_params.push_back(base.traffic_params);
+  if (runs < 1) {
+    fprintf(stderr, "runs must be at least 1.\n");
+    exit(1);
+  }
+
+  if (model != "packet" && model != "fluid") {
+    fprintf(stderr, "Unrecognised model '%s'.\n", model.c_str());
+    exit(1);
+  }
+  bool fluid = (model == "fluid");
+  if (fluid && step <= 0) {
+    fprintf(stderr, "step must be positive.\n");
+    exit(1);
+  }
+  bool need_rat = false, any_markovian = false;
+  for (const string& cctype_list : cctypes) {
+    for (const string& cctype : split_list(cctype_list)) {
+      if (fluid ? !is_valid_fluid_cctype(cctype) : !is_valid_cctype(cctype)) {
+        fprintf(stderr, "Unrecognised congestion control protocol '%s' for the %s model.\n",
+                cctype.c_str(), model.c_str());
+        exit(1);
+      }
+      need_rat |= (cctype == "remy");
+      any_markovian |= (cctype == "markovian");
+    }
+  }
+  if (fluid && (queues.size() > 1 || queues[0] != "droptail" || base.ecn)) {
+    fprintf(stderr, "The fluid model only has a droptail buffer without ECN.\n");
+    exit(1);
+  }
+  for (const string& queue : queues) {
+    DumbbellConfig config = base;
+    split_queue(queue, config.queue, config.queue_args);
+    if (make_dumbbell_queue(config) == nullptr)
+      exit(1);
+  }
+  for (const string& delta_conf : delta_confs) {
+    if (fluid && any_markovian && !is_valid_fluid_delta_conf(delta_conf)) {
+      fprintf(stderr, "The fluid model does not support delta_conf '%s'.\n",
+              delta_conf.c_str());
+      exit(1);
+    }
+  }
+  for (int n : num_senders) {
+    if (n < 1) {
+      fprintf(stderr, "num_senders must be at least 1.\n");
+      exit(1);
+    }
+  }
+
+  WhiskerTree whiskers;
+  if (ratname != "") {
+    int fd = open(ratname.c_str(), O_RDONLY);
+    if (fd < 0) {
+      perror("open");
+      exit(1);
+    }
+    RemyBuffers::WhiskerTree tree;
+    if (!tree.ParseFromFileDescriptor(fd)) {
+      fprintf(stderr, "Could not parse %s.\n", ratname.c_str());
+      exit(1);
+    }
+    close(fd);
+    whiskers = WhiskerTree(tree);
+    base.whiskers = &whiskers;
+  }
+  else if (need_rat) {
+    fprintf(stderr, "Please specify remy specification file using if=<filename>\n");
+    exit(1);
+  }
+
+  // Expand the grid. The seed varies fastest so that the runs of one
+  // configuration are adjacent.
+  vector<Experiment> experiments;
+  for (const string& cctype : cctypes) {
+    vector<string> cc_list = split_list(cctype);
+    bool has_markovian = false;
+    for (const string& cc : cc_list)
+      has_markovian |= (cc == "markovian");
+    vector<string> confs = has_markovian ? delta_confs : vector<string>{"-"};
+    for (const string& delta_conf : confs)
+    for (double link_rate : link_rates)
+    for (double rtt : rtts)
+    for (const string& buffer : buffers)
+    for (const string& queue : queues)
+    for (int n : num_senders)
+    for (const string& traffic : traffic_params)
+    for (int run = 0; run < runs; ++run) {
+      Experiment exp;
+      exp.config = base;
+      exp.config.cctypes = cc_list;
+      exp.config.delta_conf = delta_conf;
+      exp.config.link_rate = link_rate;
+      exp.config.delay = rtt / 2;
+      exp.config.buffer = parse_buffer(buffer, link_rate, rtt);
+      exp.config.num_senders = n;
+      exp.config.traffic_params = traffic;
+      // Each sender uses seed + its index
+      exp.config.seed = 1 + run * n;
+      exp.cctype = cctype;
+      exp.delta_conf = delta_conf;
+      exp.rtt = rtt;
+      exp.buffer = buffer;
+      exp.queue = queue;
+      split_queue(queue, exp.config.queue, exp.config.queue_args);
+      if (exp.config.buffer < 1) {
+        fprintf(stderr, "Buffer '%s' must be at least one packet.\n",
+                buffer.c_str());
+        exit(1);
+      }
+      experiments.push_back(exp);
+    }
+  }
+
+  FILE* out = stdout;
+  if (outname != "-") {
+    out = fopen(outname.c_str(), "w");
+    if (out == nullptr) {
+      perror("fopen");
+      exit(1);
+    }
+  }
+  fprintf(out, "id\tcctype\tdelta_conf\tlinkrate\trtt\tbuffer\tqueue\t"
+          "num_senders\ttraffic_params\tseed\tutilization\tavg_queue\ttput\t"
+          "avg_rtt\tloss_rate\tmark_rate\tjain\tsender_tputs\tcpu_time\n");
+  fflush(out);
+
+  ThreadPool pool(num_threads);
+  fprintf(stderr, "Running %lu experiments on %d threads\n",
+          experiments.size(), pool.get_num_threads());
+
+  // The controllers print diagnostics on init(). Silence them without
+  // touching cout's buffer, which other threads may be using.
+  cout.setstate(ios::badbit);
+
+  typedef chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now(), last_progress = start;
+  mutex out_mutex;
+  size_t num_done = 0;
+  pool.run(experiments.size(), [&](size_t id) {
+    timespec cpu_start, cpu_end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+    DumbbellResult res = fluid ?
+      run_dumbbell_fluid(experiments[id].config, step) :
+      run_dumbbell(experiments[id].config);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+    double cpu_time = (cpu_end.tv_sec - cpu_start.tv_sec) +
+      (cpu_end.tv_nsec - cpu_start.tv_nsec) * 1e-9;
+
+    lock_guard<mutex> lock(out_mutex);
+    write_result(out, id, experiments[id], res, cpu_time);
+    ++ num_done;
+    Clock::time_point now = Clock::now();
+    if (now - last_progress > chrono::seconds(1)) {
+      double elapsed = chrono::duration<double>(now - start).count();
+      fprintf(stderr, "\r%lu/%lu done, %.0f configs/hour", num_done,
+              experiments.size(), num_done * 3600 / elapsed);
+      last_progress = now;
+    }
+  });
+
+  cout.clear();
+  double elapsed = chrono::duration<double>(Clock::now() - start).count();
+  fprintf(stderr, "\r%lu experiments in %.1f s: %.0f configs/hour\n",
+          experiments.size(), elapsed, experiments.size() * 3600 / elapsed);
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
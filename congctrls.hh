@@ -45,6 +45,15 @@ public:
       }
    }
 
+   virtual void onECNMark()
+   {
+      m_bSlowStart = false;
+      m_issthresh = _the_window / 2;
+      if (m_issthresh < 2)
+         m_issthresh = 2;
+      _the_window = m_issthresh;
+   }
+
    virtual void onTimeout()
    {
       //m_issthresh = getPerfInfo()->pktFlightSize / 2;
@@ -9,7 +9,13 @@
 #include <thread>
 
 #include "ccc.hh"
+#include "cycle-accounting.hh"
+#include "latency-histogram.hh"
+#include "link-rate-estimator.hh"
+#include "live-stats.hh"
 #include "remycc.hh"
+#include "results.hh"
+#include "rtt-window.hh"
 #include "tcp-header.hh"
 #include "udp-socket.hh"
 
@@ -35,7 +41,11 @@ private:
   int dstport;
   int srcport;
 
+  // packets per probe train and packets from one train to the next, see
+  // link-rate-estimator.hh
   int train_length;
+  int probe_interval;
+  LinkRateEstimator link_rate_estimator;
 
   double _last_send_time;
 
@@ -46,11 +56,38 @@ private:
   int tot_bytes_transmitted;
   int tot_packets_transmitted;
 
+  // Of the current flow and of all flows so far. Queuing delay is the RTT
+  // less the minimum in rtt_window.
+  RTTWindow rtt_window;
+  LatencyHistogram rtt_histogram, queuing_delay_histogram, inter_ack_histogram;
+  LatencyHistogram run_rtt_histogram, run_queuing_delay_histogram,
+    run_inter_ack_histogram;
+  // Of the current flow and of all flows so far; empty unless compiled
+  // with CYCLE_ACCOUNTING
+  CycleAccounts cycles, run_cycles;
+  int num_flows;
+
+  // ms between interval reports, 0 for none. An interval is reported
+  // from the difference of the flow's counters (and RTT histogram) since
+  // its start, so the reports cost nothing per packet.
+  double report_interval;
+  struct IntervalStart {
+    double time;
+    int packets_sent, packets_acked, packets_lost;
+    LatencyHistogram rtt_histogram;
+    CycleAccounts cycles;
+    IntervalStart() : time( 0 ), packets_sent( 0 ), packets_acked( 0 ),
+                      packets_lost( 0 ), rtt_histogram(), cycles() {}
+  };
+
   void tcp_handshake();
+  void publish_stats( int slot, FlowStats& stats, double cur_time );
+  void report( int src_id, int flow_id, double cur_time, int packets_sent,
+               int packets_acked, int packets_lost, IntervalStart& start );
 
 public:
 
-  CTCP( T& s_congctrl, string ipaddr, int port, int srcport, int train_length )
+  CTCP( T& s_congctrl, string ipaddr, int port, int srcport, int train_length, int probe_interval = 16, double report_interval = 0 )
     :   congctrl( s_congctrl ), 
         socket(), 
         conntype( SENDER ),
@@ -58,12 +95,25 @@ public:
         dstport( port ),
         srcport( srcport),
         train_length( train_length ),
+        probe_interval( probe_interval ),
+        link_rate_estimator( train_length, probe_interval ),
         _last_send_time( 0.0 ),
         _largest_ack( -1 ),
         tot_time_transmitted( 0 ),
         tot_delay( 0 ),
         tot_bytes_transmitted( 0 ),
-        tot_packets_transmitted( 0 )
+        tot_packets_transmitted( 0 ),
+        rtt_window(),
+        rtt_histogram(),
+        queuing_delay_histogram(),
+        inter_ack_histogram(),
+        run_rtt_histogram(),
+        run_queuing_delay_histogram(),
+        run_inter_ack_histogram(),
+        cycles(),
+        run_cycles(),
+        num_flows( 0 ),
+        report_interval( report_interval )
   {
     socket.bindsocket( ipaddr, port, srcport );
   }
@@ -75,16 +125,33 @@ public:
       dstaddr( other.dstaddr ),
       dstport( other.dstport ),
       srcport( other.srcport ),
+      train_length( other.train_length ),
+      probe_interval( other.probe_interval ),
+      link_rate_estimator( train_length, probe_interval ),
       _last_send_time( 0.0 ),
       _largest_ack( -1 ),
       tot_time_transmitted( 0 ),
       tot_delay( 0 ),
       tot_bytes_transmitted( 0 ),
-      tot_packets_transmitted( 0 )
+      tot_packets_transmitted( 0 ),
+      rtt_window(),
+      rtt_histogram(),
+      queuing_delay_histogram(),
+      inter_ack_histogram(),
+      run_rtt_histogram(),
+      run_queuing_delay_histogram(),
+      run_inter_ack_histogram(),
+      cycles(),
+      run_cycles(),
+      num_flows( 0 ),
+      report_interval( other.report_interval )
   {
     socket.bindsocket( dstaddr, dstport, srcport );
   }
 
+  // Prints the latency percentiles of all the flows
+  ~CTCP();
+
   //duration in milliseconds
   void send_data ( double flow_size, bool byte_switched, int flow_id, int src_id );
 
@@ -415,18 +482,59 @@ void CTCP<T>::send_data( double flow_size, bool byte_switched, int flow_id, int
   _last_send_time = 0;
 
   int num_packets_transmitted = 0;
+  int num_packets_lost = 0;
   double delay_sum = 0;
+  double last_ack_time = -1;
+  rtt_window.clear();
+  rtt_histogram.reset();
+  queuing_delay_histogram.reset();
+  inter_ack_histogram.reset();
+  cycles.reset();
+  IntervalStart interval;
+
+  // Live statistics, if enabled (see live-stats.hh)
+  LiveStats* live_stats = LiveStats::instance();
+  int stats_slot = live_stats ? live_stats->open_slot() : -1;
+  FlowStats stats;
+  if (stats_slot >= 0) {
+    stats.state = FlowStats::ACTIVE;
+    stats.src_id = src_id;
+    stats.flow_id = flow_id;
+    stats.start_time = chrono::duration_cast<chrono::duration<double>>(
+      chrono::system_clock::now().time_since_epoch()).count();
+    const char* names[STATS_STATE_SIZE];
+    double values[STATS_STATE_SIZE];
+    stats.num_cc_state = congctrl.get_state(names, values, STATS_STATE_SIZE);
+    string joined;
+    for (unsigned i = 0; i < stats.num_cc_state; i++)
+      joined += (i ? "," : "") + string(names[i]);
+    strncpy(stats.cc_state_names, joined.c_str(), sizeof(stats.cc_state_names) - 1);
+  }
 
   cur_time = current_timestamp( start_time_point );
   congctrl.set_timestamp(cur_time);
   congctrl.init();
+  if (byte_switched)
+    congctrl.set_flow_length(ceil(flow_size / data_size));
+  // The bottleneck is usually the same as for the previous flow
+  link_rate_estimator.new_flow();
+  if (link_rate_estimator.get_link_rate() > 0)
+    congctrl.onLinkRateMeasurement(link_rate_estimator.get_link_rate());
 
   while ((byte_switched?(num_packets_transmitted*data_size):cur_time) < flow_size) {
+    uint64_t cycle_start = cycles.now();
     cur_time = current_timestamp( start_time_point );
     congctrl.set_timestamp(cur_time);
-
+    cycles.lap(PHASE_CLOCK, cycle_start);
+    if (report_interval > 0 && cur_time >= interval.time + report_interval)
+      report(src_id, flow_id, cur_time, seq_num, num_packets_transmitted,
+             num_packets_lost, interval);
+
+    // Packets of a probe train go back to back, without waiting for the
+    // pacer; the ones after the train wait for the time they took
+    bool in_train = link_rate_estimator.in_train(seq_num);
     if ((seq_num < _largest_ack + 1 + congctrl.get_the_window()) &&
-      (_last_send_time + congctrl.get_intersend_time() * train_length <=
+      (in_train || _last_send_time + congctrl.get_intersend_time() <=
       cur_time)) {
       header.seq_num = seq_num;
       header.flow_id = flow_id;
@@ -434,17 +542,32 @@ void CTCP<T>::send_data( double flow_size, bool byte_switched, int flow_id, int
       header.sender_timestamp = cur_time;
       header.receiver_timestamp = 0;
       memcpy( buf, &header, sizeof(TCPHeader) );
+      cycle_start = cycles.now();
       socket.senddata( buf, packet_size, NULL );
-
-      _last_send_time = cur_time;
-      congctrl.onPktSent( header.seq_num / train_length );
+      cycles.lap(PHASE_SEND, cycle_start);
+
+      if (in_train)
+        _last_send_time += congctrl.get_intersend_time();
+      else
+        _last_send_time = cur_time;
+      link_rate_estimator.on_send(seq_num, cur_time);
+      cycle_start = cycles.now();
+      congctrl.onPktSent( header.seq_num );
+      cycles.lap(PHASE_ON_PKT_SENT, cycle_start);
       seq_num++;
+      stats.packets_sent++;
+      // Send the rest of a train before anything else
+      if (link_rate_estimator.in_train(seq_num))
+        continue;
     }
 
     sockaddr_in other_addr;
+    cycle_start = cycles.now();
     if(socket.receivedata(buf, packet_size, 0, other_addr) == 0) {
+      cycles.lap(PHASE_POLL, cycle_start);
       continue;
     }
+    cycles.lap(PHASE_RECEIVE, cycle_start);
 
     memcpy(&ack_header, buf, sizeof(TCPHeader));
     ack_header.seq_num++; // because the receiver doesn't do that for us yet
@@ -455,17 +578,60 @@ void CTCP<T>::send_data( double flow_size, bool byte_switched, int flow_id, int
       }
       continue;
     }
-    delay_sum += cur_time - ack_header.sender_timestamp;
-    congctrl.onACK(ack_header.seq_num / train_length,
+    // The time may have moved on while polling the socket
+    cycle_start = cycles.now();
+    cur_time = current_timestamp( start_time_point );
+    congctrl.set_timestamp(cur_time);
+    uint64_t bookkeeping_start = cycles.lap(PHASE_CLOCK, cycle_start);
+    if (link_rate_estimator.on_ack(ack_header.seq_num - 1,
+                                   ack_header.receiver_timestamp))
+      congctrl.onLinkRateMeasurement(link_rate_estimator.get_link_rate());
+
+    double rtt = cur_time - ack_header.sender_timestamp;
+    delay_sum += rtt;
+    rtt_window.new_rtt_sample(rtt, cur_time);
+    rtt_histogram.record(rtt);
+    queuing_delay_histogram.record(rtt - rtt_window.get_min_rtt());
+    if (last_ack_time >= 0)
+      inter_ack_histogram.record(cur_time - last_ack_time);
+    last_ack_time = cur_time;
+    cycle_start = cycles.now();
+    congctrl.onACK(ack_header.seq_num,
                     ack_header.receiver_timestamp,
                     ack_header.sender_timestamp);
+    uint64_t bookkeeping_restart = cycles.lap(PHASE_ON_ACK, cycle_start);
+
+    // Packets skipped over by the ACKs are counted lost. ACK n is for
+    // packet n - 1.
+    int expected_ack = max(_largest_ack, 0) + 1;
+    if (ack_header.seq_num > expected_ack)
+      num_packets_lost += ack_header.seq_num - expected_ack;
+    if (stats_slot >= 0) {
+      stats.packets_acked++;
+      stats.losses = num_packets_lost;
+      stats.last_rtt = rtt;
+      stats.min_rtt = (stats.packets_acked == 1) ? rtt : min(stats.min_rtt, rtt);
+      stats.srtt = (stats.packets_acked == 1) ? rtt : 0.875 * stats.srtt + 0.125 * rtt;
+      publish_stats(stats_slot, stats, cur_time);
+    }
+
     _largest_ack = max(_largest_ack, ack_header.seq_num);
     num_packets_transmitted++;
+    cycles.record(PHASE_BOOKKEEPING, (cycle_start - bookkeeping_start) +
+                  (cycles.now() - bookkeeping_restart));
   }
 
   cur_time = current_timestamp( start_time_point );
   congctrl.set_timestamp(cur_time);
+  // The rest of the last interval
+  if (report_interval > 0 && cur_time > interval.time)
+    report(src_id, flow_id, cur_time, seq_num, num_packets_transmitted,
+           num_packets_lost, interval);
   congctrl.close();
+  if (stats_slot >= 0) {
+    stats.state = FlowStats::FINISHED;
+    publish_stats(stats_slot, stats, cur_time);
+  }
 
   double throughput = num_packets_transmitted/( cur_time / 1000.0 );
   double delay = (delay_sum / 1000) / num_packets_transmitted;
@@ -473,7 +639,118 @@ void CTCP<T>::send_data( double flow_size, bool byte_switched, int flow_id, int
   std::cout << "\nData Successfully Transmitted\n\tThroughput: " << throughput
 			<< " packets/sec\n\tAverage Delay: " << delay
 			<< " sec/packet\n\tCompletion time: " << cur_time / 1000.0
-			<< "sec\n";
+			<< "sec\n\tRTT (ms): " << rtt_histogram.summary()
+			<< "\n\tQueuing delay (ms): " << queuing_delay_histogram.summary()
+			<< "\n\tInter-ACK time (ms): " << inter_ack_histogram.summary()
+			<< "\n" << cycles.summary("\t", cur_time);
+
+  if (ResultLog::instance() != nullptr) {
+    ResultRecord record("flow");
+    record.add("src_id", src_id)
+      .add("flow_id", flow_id)
+      .add(byte_switched ? "flow_bytes" : "flow_ms", flow_size)
+      .add("duration_ms", cur_time)
+      .add("packets_sent", seq_num)
+      .add("packets_acked", num_packets_transmitted)
+      .add("packets_lost", num_packets_lost)
+      .add("throughput_pps", throughput)
+      .add("delay_s", delay)
+      .add("rtt_mean_ms", rtt_histogram.mean())
+      .add("rtt_p50_ms", rtt_histogram.percentile(50))
+      .add("rtt_p95_ms", rtt_histogram.percentile(95))
+      .add("rtt_p99_ms", rtt_histogram.percentile(99))
+      .add("queuing_delay_p50_ms", queuing_delay_histogram.percentile(50))
+      .add("queuing_delay_p95_ms", queuing_delay_histogram.percentile(95))
+      .add("inter_ack_p50_ms", inter_ack_histogram.percentile(50));
+    for (int i = 0; cycle_accounting && i < NUM_CYCLE_PHASES; i++)
+      record.add(("cycles_" + string(cycle_phase_names[i]) + "_mean").c_str(),
+                 cycles.mean(CyclePhase(i)));
+    ResultLog::instance()->write(record);
+  }
+
+  run_rtt_histogram.merge(rtt_histogram);
+  run_queuing_delay_histogram.merge(queuing_delay_histogram);
+  run_inter_ack_histogram.merge(inter_ack_histogram);
+  run_cycles.merge(cycles);
+  tot_time_transmitted += cur_time;
+  num_flows++;
+}
+
+template<class T>
+CTCP<T>::~CTCP(){
+  if (num_flows == 0)
+    return;
+  std::cout << "\nAll " << num_flows << " flows\n\tRTT (ms): "
+            << run_rtt_histogram.summary()
+            << "\n\tQueuing delay (ms): "
+            << run_queuing_delay_histogram.summary()
+            << "\n\tInter-ACK time (ms): "
+            << run_inter_ack_histogram.summary() << "\n"
+            << run_cycles.summary("\t", tot_time_transmitted);
+}
+
+template<class T>
+void CTCP<T>::publish_stats( int slot, FlowStats& stats, double cur_time ){
+  stats.duration = cur_time;
+  stats.cwnd = congctrl.get_the_window();
+  stats.intersend_time = congctrl.get_intersend_time();
+  stats.link_rate = link_rate_estimator.get_link_rate();
+  const char* names[STATS_STATE_SIZE];
+  stats.num_cc_state = congctrl.get_state(names, stats.cc_state, STATS_STATE_SIZE);
+  LiveStats::instance()->publish(slot, stats);
+}
+
+template<class T>
+void CTCP<T>::report( int src_id, int flow_id, double cur_time,
+                      int packets_sent, int packets_acked, int packets_lost,
+                      IntervalStart& start ){
+  double duration = (cur_time - start.time) / 1000.0;
+  int acked = packets_acked - start.packets_acked;
+  int lost = packets_lost - start.packets_lost;
+  double goodput = acked * data_size * 8 / duration / 1e6;
+  LatencyHistogram rtt = rtt_histogram;
+  rtt.subtract(start.rtt_histogram);
+
+  char buf[256];
+  snprintf(buf, sizeof(buf), "\tInterval %.3f-%.3f s: goodput %.3f Mbit/s, "
+           "%.0f ACKs/s, RTT (ms) p50=%.3f p95=%.3f p99=%.3f, %d lost, "
+           "window %.2f, intersend %.4f ms", start.time / 1000.0,
+           cur_time / 1000.0, goodput, acked / duration, rtt.percentile(50),
+           rtt.percentile(95), rtt.percentile(99), lost,
+           double(congctrl.get_the_window()), congctrl.get_intersend_time());
+  std::cout << buf;
+  if (cycle_accounting)
+    std::cout << ", mean cycles" << cycles.interval_means(start.cycles);
+  std::cout << "\n";
+
+  if (ResultLog::instance() != nullptr) {
+    ResultRecord record("interval");
+    record.add("src_id", src_id)
+      .add("flow_id", flow_id)
+      .add("start_ms", start.time)
+      .add("end_ms", cur_time)
+      .add("packets_sent", packets_sent - start.packets_sent)
+      .add("packets_acked", acked)
+      .add("packets_lost", lost)
+      .add("goodput_mbps", goodput)
+      .add("ack_rate", acked / duration)
+      .add("rtt_p50_ms", rtt.percentile(50))
+      .add("rtt_p95_ms", rtt.percentile(95))
+      .add("rtt_p99_ms", rtt.percentile(99))
+      .add("window", congctrl.get_the_window())
+      .add("intersend_ms", congctrl.get_intersend_time());
+    for (int i = 0; cycle_accounting && i < NUM_CYCLE_PHASES; i++)
+      record.add(("cycles_" + string(cycle_phase_names[i]) + "_mean").c_str(),
+                 cycles.interval_mean(start.cycles, CyclePhase(i)));
+    ResultLog::instance()->write(record);
+  }
+
+  start.time = cur_time;
+  start.packets_sent = packets_sent;
+  start.packets_acked = packets_acked;
+  start.packets_lost = packets_lost;
+  start.rtt_histogram = rtt_histogram;
+  start.cycles = cycles;
 }
 
 template<class T>
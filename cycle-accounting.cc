@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "cycle-accounting.hh"
+
+const char* const cycle_phase_names[NUM_CYCLE_PHASES] = {
+  "clock", "send", "poll", "receive", "onPktSent", "onACK", "bookkeeping",
+};
+
+double cycles_per_ns() {
+  static double rate = 0;
+  if (rate > 0)
+    return rate;
+#if defined(__x86_64__) || defined(__i386__)
+  auto start_time = std::chrono::steady_clock::now();
+  uint64_t start = read_cycles();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  uint64_t cycles = read_cycles() - start;
+  double ns = std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now() - start_time).count();
+  rate = cycles / ns;
+#else
+  rate = 1;
+#endif
+  return rate;
+}
+
+CycleAccounts::CycleAccounts() : phases() {
+  reset();
+}
+
+uint64_t CycleAccounts::highest_in(int bucket) {
+  if (bucket < 4)
+    return bucket;
+  int msb = bucket / 4;
+  uint64_t sub = bucket % 4 + 4;
+  return ((sub + 1) << (msb - 2)) - 1;
+}
+
+double CycleAccounts::percentile(const Phase& phase, double p) const {
+  if (phase.total == 0)
+    return 0;
+  uint64_t rank = std::ceil(p / 100 * phase.total);
+  rank = std::min(std::max(rank, uint64_t(1)), phase.total);
+  uint64_t seen = 0;
+  int bucket = 0;
+  for (; bucket < num_buckets - 1; bucket++) {
+    seen += phase.counts[bucket];
+    if (seen >= rank)
+      break;
+  }
+  return std::min(highest_in(bucket), phase.max);
+}
+
+void CycleAccounts::merge(const CycleAccounts& other) {
+  if (!cycle_accounting)
+    return;
+  for (int i = 0; i < NUM_CYCLE_PHASES; i++) {
+    Phase& p = phases[i];
+    const Phase& o = other.phases[i];
+    for (int b = 0; b < num_buckets; b++)
+      p.counts[b] += o.counts[b];
+    p.total += o.total;
+    p.sum += o.sum;
+    p.max = std::max(p.max, o.max);
+  }
+}
+
+void CycleAccounts::reset() {
+  memset(phases, 0, sizeof(phases));
+}
+
+std::string CycleAccounts::summary(const std::string& indent,
+                                   double duration_ms) const {
+  if (!cycle_accounting)
+    return "";
+  double flow_cycles = duration_ms * 1e6 * cycles_per_ns();
+  std::string out;
+  for (int i = 0; i < NUM_CYCLE_PHASES; i++) {
+    const Phase& p = phases[i];
+    double mean = this->mean(CyclePhase(i));
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "%sCycles %s: n=%llu mean=%.0f p50=%.0f p99=%.0f max=%llu "
+             "(%.1f ns mean, %.1f%% of the time)\n",
+             indent.c_str(), cycle_phase_names[i],
+             (unsigned long long) p.total, mean, percentile(p, 50),
+             percentile(p, 99), (unsigned long long) p.max,
+             mean / cycles_per_ns(),
+             flow_cycles > 0 ? 100 * p.sum / flow_cycles : 0);
+    out += buf;
+  }
+  return out;
+}
+
+double CycleAccounts::mean(CyclePhase phase) const {
+  const Phase& p = phases[phase];
+  return p.total ? double(p.sum) / p.total : 0;
+}
+
+double CycleAccounts::interval_mean(const CycleAccounts& earlier,
+                                    CyclePhase phase) const {
+  uint64_t n = phases[phase].total - earlier.phases[phase].total;
+  uint64_t sum = phases[phase].sum - earlier.phases[phase].sum;
+  return n ? double(sum) / n : 0;
+}
+
+std::string CycleAccounts::interval_means(const CycleAccounts& earlier) const {
+  if (!cycle_accounting)
+    return "";
+  std::string out;
+  for (int i = 0; i < NUM_CYCLE_PHASES; i++) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), " %s=%.0f", cycle_phase_names[i],
+             interval_mean(earlier, CyclePhase(i)));
+    out += buf;
+  }
+  return out;
+}
@@ -0,0 +1,123 @@
+#ifndef CYCLE_ACCOUNTING_HH
+#define CYCLE_ACCOUNTING_HH
+
+#include <cstdint>
+#include <string>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Where the time of a sender goes, per phase of CTCP::send_data: a
+// histogram of the cycles (TSC ticks, or ns where there is no TSC) each
+// call took. Compiled in with -DCYCLE_ACCOUNTING (eg. 'make
+// CXXFLAGS+=-DCYCLE_ACCOUNTING'); otherwise every call below does nothing
+// and is optimised away, so CTCP makes them unconditionally.
+
+#ifdef CYCLE_ACCOUNTING
+static const bool cycle_accounting = true;
+#else
+static const bool cycle_accounting = false;
+#endif
+
+enum CyclePhase {
+  // current_timestamp and set_timestamp
+  PHASE_CLOCK,
+  // Sending a packet, and polling the socket for an ACK: with one and
+  // without
+  PHASE_SEND,
+  PHASE_POLL,
+  PHASE_RECEIVE,
+  // The controller's callbacks
+  PHASE_ON_PKT_SENT,
+  PHASE_ON_ACK,
+  // The rest of handling an ACK: RTT histograms, the link rate estimate,
+  // live statistics
+  PHASE_BOOKKEEPING,
+  NUM_CYCLE_PHASES
+};
+
+extern const char* const cycle_phase_names[NUM_CYCLE_PHASES];
+
+inline uint64_t read_cycles() {
+  if (!cycle_accounting)
+    return 0;
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+// Cycles per ns, measured once against the system clock
+double cycles_per_ns();
+
+class CycleAccounts {
+  // Four buckets per power of two, so percentiles are within 19%. A
+  // single bucket when compiled out.
+  static const int num_buckets = cycle_accounting ? 64 * 4 : 1;
+
+  struct Phase {
+    uint64_t counts[num_buckets];
+    uint64_t total, sum, max;
+  };
+  Phase phases[NUM_CYCLE_PHASES];
+
+  static int bucket_of(uint64_t cycles);
+  static uint64_t highest_in(int bucket);
+  double percentile(const Phase& phase, double p) const;
+
+ public:
+  CycleAccounts();
+
+  // Readings of the counter, for timing a phase from one to the next
+  uint64_t now() const { return read_cycles(); }
+  void record(CyclePhase phase, uint64_t cycles);
+  // Records the cycles since 'start' and returns the reading taken to
+  // do so, which may start the next phase
+  uint64_t lap(CyclePhase phase, uint64_t start);
+
+  void merge(const CycleAccounts& other);
+  void reset();
+
+  // A line per phase (after 'indent') of counts, mean and percentiles in
+  // cycles and the share of 'duration_ms' it took. Empty when compiled
+  // out.
+  std::string summary(const std::string& indent, double duration_ms) const;
+  // The mean cycles of each phase since 'earlier', a copy of these
+  // accounts, as " name=mean" pairs. Empty when compiled out.
+  std::string interval_means(const CycleAccounts& earlier) const;
+  double mean(CyclePhase phase) const;
+  // Of the calls since 'earlier'
+  double interval_mean(const CycleAccounts& earlier, CyclePhase phase) const;
+};
+
+inline void CycleAccounts::record(CyclePhase phase, uint64_t cycles) {
+  if (!cycle_accounting)
+    return;
+  Phase& p = phases[phase];
+  p.counts[bucket_of(cycles)]++;
+  p.total++;
+  p.sum += cycles;
+  if (cycles > p.max)
+    p.max = cycles;
+}
+
+inline uint64_t CycleAccounts::lap(CyclePhase phase, uint64_t start) {
+  if (!cycle_accounting)
+    return 0;
+  uint64_t end = read_cycles();
+  record(phase, end - start);
+  return end;
+}
+
+inline int CycleAccounts::bucket_of(uint64_t cycles) {
+  if (cycles < 4)
+    return cycles;
+  int msb = 63 - __builtin_clzll(cycles);
+  return msb * 4 + ((cycles >> (msb - 2)) & 3);
+}
+
+#endif
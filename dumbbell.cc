@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cassert>
+
+#include "congctrls.hh"
+#include "dumbbell.hh"
+#include "fast_conv.hh"
+#include "markoviancc.hh"
+#include "remycc.hh"
+#include "simulator.hh"
+#include "slow_conv.hh"
+
+using namespace std;
+
+DumbbellConfig::DumbbellConfig() :
+  cctypes({"markovian"}),
+  delta_conf("do_ss:auto:0.5"),
+  whiskers(nullptr),
+  num_senders(1),
+  link_rate(1000),
+  delay(25),
+  extra_delays({0}),
+  buffer(-1),
+  queue("droptail"),
+  queue_args(""),
+  ecn(false),
+  duration(100000),
+  onduration(-1),
+  offduration(0),
+  traffic_params("deterministic,num_cycles=1"),
+  train_length(1),
+  seed(1)
+{}
+
+DumbbellResult::Sender::Sender() :
+  cctype(),
+  throughput(0),
+  avg_rtt(0),
+  pkts_sent(0),
+  pkts_dropped(0),
+  pkts_marked(0)
+{}
+
+DumbbellResult::DumbbellResult() :
+  senders(),
+  utilization(0),
+  avg_queue(0),
+  max_queue(0),
+  drops(0),
+  marks(0),
+  jain_index(0),
+  num_events(0)
+{}
+
+TopologyResult::Flow::Flow() :
+  name(),
+  cctype(),
+  throughput(0),
+  avg_rtt(0),
+  base_rtt(0),
+  pkts_sent(0),
+  pkts_dropped(0),
+  pkts_marked(0)
+{}
+
+TopologyResult::Link::Link() :
+  name(),
+  utilization(0),
+  avg_queue(0),
+  max_queue(0),
+  drops(0),
+  marks(0)
+{}
+
+TopologyResult::TopologyResult() :
+  flows(),
+  links(),
+  jain_index(0),
+  fairness(),
+  num_events(0)
+{}
+
+bool is_valid_cctype(const string& cctype) {
+  return cctype == "markovian" || cctype == "remy" || cctype == "slow_conv" ||
+    cctype == "fast_conv" || cctype == "tcp";
+}
+
+unique_ptr<QueueDisc> make_dumbbell_queue(const DumbbellConfig& config) {
+  int buffer = config.buffer;
+  if (buffer < 0)
+    buffer = max(1, int(config.link_rate * 2 * config.delay / 1000));
+  string args = config.queue_args;
+  if (config.queue != "infinite" && args.find("packets=") == string::npos &&
+      args.find("bytes=") == string::npos)
+    args = "packets=" + to_string(buffer) + (args.empty() ? "" : ",") + args;
+  return make_queue_disc(config.queue, args);
+}
+
+SenderConfig dumbbell_sender_config(const DumbbellConfig& config, int link,
+                                    int i) {
+  SenderConfig sender_config;
+  sender_config.route = {link};
+  sender_config.ack_delay = 2 * config.delay +
+    config.extra_delays[i % config.extra_delays.size()];
+  sender_config.train_length = config.train_length;
+  sender_config.onduration = config.onduration < 0 ?
+    config.duration : config.onduration;
+  sender_config.offduration = config.offduration;
+  sender_config.traffic_params = config.traffic_params;
+  sender_config.seed = config.seed + i;
+  sender_config.ecn = config.ecn;
+  return sender_config;
+}
+
+void add_sim_sender(Simulator& sim, const SenderConfig& sender_config,
+                    const string& cctype, const string& delta_conf,
+                    const WhiskerTree* whiskers) {
+  if (cctype == "markovian") {
+    auto& sender = sim.add_sender<MarkovianCC>(sender_config, 1.0);
+    sender.get_congctrl().interpret_config_str(delta_conf);
+  }
+  else if (cctype == "remy") {
+    assert(whiskers != nullptr);
+    WhiskerTree copy(*whiskers);
+    sim.add_sender<RemyCC>(sender_config, copy);
+  }
+  else if (cctype == "slow_conv")
+    sim.add_sender<SlowConv>(sender_config);
+  else if (cctype == "fast_conv")
+    sim.add_sender<FastConv>(sender_config);
+  else if (cctype == "tcp")
+    sim.add_sender<DefaultCC>(sender_config);
+  else
+    assert(false);
+}
+
+DumbbellResult run_dumbbell(const DumbbellConfig& config) {
+  assert(config.num_senders >= 1);
+  assert(!config.cctypes.empty() && !config.extra_delays.empty());
+
+  unique_ptr<QueueDisc> queue = make_dumbbell_queue(config);
+  assert(queue != nullptr);
+  Simulator sim;
+  int link = sim.add_link(config.link_rate, config.delay, move(queue));
+
+  for (int i = 0; i < config.num_senders; ++i)
+    add_sim_sender(sim, dumbbell_sender_config(config, link, i),
+                   config.cctypes[i % config.cctypes.size()],
+                   config.delta_conf, config.whiskers);
+
+  sim.run(config.duration);
+
+  DumbbellResult result;
+  vector<double> throughputs;
+  for (int i = 0; i < sim.get_num_senders(); ++i) {
+    const SimSender& sender = sim.get_sender(i);
+    DumbbellResult::Sender res;
+    res.cctype = config.cctypes[i % config.cctypes.size()];
+    res.throughput = sender.get_throughput(sim.now());
+    res.avg_rtt = sender.get_avg_rtt();
+    res.pkts_sent = sender.get_stats().pkts_sent;
+    res.pkts_dropped = sender.get_stats().pkts_dropped;
+    res.pkts_marked = sender.get_stats().pkts_marked;
+    result.senders.push_back(res);
+    throughputs.push_back(res.throughput);
+  }
+  const Link& l = sim.get_link(link);
+  result.utilization = l.pkts_delivered * l.tx_time(sim_packet_size) /
+    config.duration;
+  result.avg_queue = l.avg_queue(sim.now());
+  result.max_queue = l.max_queue;
+  result.drops = l.queue->drops();
+  result.marks = l.queue->marks();
+  result.jain_index = jain_index(throughputs);
+  result.num_events = sim.get_num_events();
+  return result;
+}
+
+TopologyResult run_topology(const Topology& topology,
+                            const WhiskerTree* whiskers, double duration,
+                            double interval, unsigned seed) {
+  Simulator sim;
+  for (size_t i = 0; i < topology.links.size(); ++i) {
+    const TopologyLink& link = topology.links[i];
+    unique_ptr<QueueDisc> queue = make_topology_queue(topology, i);
+    assert(queue != nullptr && link.rate > 0);
+    sim.add_link(link.rate, link.delay, move(queue));
+  }
+
+  TopologyResult result;
+  for (const TopologyFlow& flow : topology.flows) {
+    SenderConfig sender_config;
+    sender_config.route = flow.route;
+    // The propagation delay of the last link, then back along the route
+    sender_config.ack_delay = flow.extra_delay +
+      topology.links[flow.route.back()].delay;
+    for (int link : flow.route)
+      sender_config.ack_delay += topology.links[link].delay;
+    sender_config.onduration = flow.onduration < 0 ? duration : flow.onduration;
+    sender_config.offduration = flow.offduration;
+    sender_config.traffic_params = flow.traffic_params;
+    sender_config.ecn = flow.ecn;
+
+    for (int i = 0; i < flow.count; ++i) {
+      sender_config.seed = seed + sim.get_num_senders();
+      add_sim_sender(sim, sender_config, flow.cctype, flow.delta_conf,
+                     whiskers);
+      TopologyResult::Flow res;
+      res.name = flow.count == 1 ? flow.name : flow.name + "." + to_string(i);
+      res.cctype = flow.cctype;
+      res.base_rtt = sim.base_rtt(sender_config);
+      result.flows.push_back(res);
+    }
+  }
+
+  if (interval > 0) {
+    for (double t = interval; t < duration; t += interval) {
+      sim.run(t);
+      result.fairness.push_back(make_pair(t, sim.sample_fairness()));
+    }
+  }
+  sim.run(duration);
+  if (interval > 0)
+    result.fairness.push_back(make_pair(duration, sim.sample_fairness()));
+
+  vector<double> throughputs;
+  for (int i = 0; i < sim.get_num_senders(); ++i) {
+    const SimSender& sender = sim.get_sender(i);
+    TopologyResult::Flow& res = result.flows[i];
+    res.throughput = sender.get_throughput(sim.now());
+    res.avg_rtt = sender.get_avg_rtt();
+    res.pkts_sent = sender.get_stats().pkts_sent;
+    res.pkts_dropped = sender.get_stats().pkts_dropped;
+    res.pkts_marked = sender.get_stats().pkts_marked;
+    throughputs.push_back(res.throughput);
+  }
+  for (int i = 0; i < sim.get_num_links(); ++i) {
+    const Link& l = sim.get_link(i);
+    TopologyResult::Link res;
+    res.name = topology.links[i].name;
+    res.utilization = l.pkts_delivered * l.tx_time(sim_packet_size) / duration;
+    res.avg_queue = l.avg_queue(sim.now());
+    res.max_queue = l.max_queue;
+    res.drops = l.queue->drops();
+    res.marks = l.queue->marks();
+    result.links.push_back(res);
+  }
+  result.jain_index = jain_index(throughputs);
+  result.num_events = sim.get_num_events();
+  return result;
+}
@@ -0,0 +1,144 @@
+#ifndef DUMBBELL_HH
+#define DUMBBELL_HH
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "queue-disc.hh"
+#include "simulator.hh"
+#include "topology.hh"
+#include "whiskertree.hh"
+
+// Simulates senders sharing one bottleneck (see simulator.hh), or the
+// links and flows of a topology file (see topology.hh).
+// Used by ccsim for single runs and by ccsweep for parameter sweeps. Runs
+// are independent, so several may execute on different threads at once.
+struct DumbbellConfig {
+  // Controller of each sender, assigned round-robin. One of markovian,
+  // remy, slow_conv, fast_conv or tcp.
+  std::vector<std::string> cctypes;
+  // For MarkovianCC
+  std::string delta_conf;
+  // For RemyCC. Each sender gets its own copy.
+  const WhiskerTree* whiskers;
+  int num_senders;
+  // Bottleneck rate (packets/s) and one-way propagation delay (ms)
+  double link_rate;
+  double delay;
+  // Additional RTT of each sender (ms), assigned round-robin
+  std::vector<double> extra_delays;
+  // In packets. If negative, one bandwidth-delay product.
+  int buffer;
+  // Queueing discipline and its arguments, as for make_queue_disc. Unless
+  // the arguments say otherwise, 'buffer' is its limit.
+  std::string queue;
+  std::string queue_args;
+  // Whether senders send ECN capable packets
+  bool ecn;
+  // Simulated time (ms)
+  double duration;
+  // As for the sender. If onduration is negative, senders stay on for the
+  // whole run.
+  double onduration;
+  double offduration;
+  std::string traffic_params;
+  int train_length;
+  unsigned seed;
+
+  DumbbellConfig();
+  DumbbellConfig(const DumbbellConfig&) = default;
+  DumbbellConfig& operator=(const DumbbellConfig&) = default;
+};
+
+struct DumbbellResult {
+  struct Sender {
+    std::string cctype;
+    // pkts/s over the time the sender was on
+    double throughput;
+    double avg_rtt;
+    long pkts_sent;
+    long pkts_dropped;
+    long pkts_marked;
+
+    Sender();
+  };
+  std::vector<Sender> senders;
+  // Fraction of the link capacity used
+  double utilization;
+  // Time averaged, in packets
+  double avg_queue;
+  int max_queue;
+  long drops;
+  long marks;
+  double jain_index;
+  uint64_t num_events;
+
+  DumbbellResult();
+};
+
+// Whether 'cctype' names a controller run_dumbbell knows
+bool is_valid_cctype(const std::string& cctype);
+
+// The bottleneck queue for 'config'. Prints an error and returns null if
+// the queue or its arguments are invalid.
+std::unique_ptr<QueueDisc> make_dumbbell_queue(const DumbbellConfig& config);
+
+// The configuration of sender 'i' of 'config', whose bottleneck is 'link'
+SenderConfig dumbbell_sender_config(const DumbbellConfig& config, int link,
+                                    int i);
+
+// Adds a sender running 'cctype' (see is_valid_cctype) to 'sim'. Remy
+// senders get their own copy of 'whiskers'.
+void add_sim_sender(Simulator& sim, const SenderConfig& sender_config,
+                    const std::string& cctype, const std::string& delta_conf,
+                    const WhiskerTree* whiskers);
+
+DumbbellResult run_dumbbell(const DumbbellConfig& config);
+
+struct TopologyResult {
+  struct Flow {
+    // Flows with count > 1 are numbered: name.0, name.1, ...
+    std::string name;
+    std::string cctype;
+    // pkts/s over the time the flow was on
+    double throughput;
+    double avg_rtt;
+    // RTT on an empty network
+    double base_rtt;
+    long pkts_sent;
+    long pkts_dropped;
+    long pkts_marked;
+
+    Flow();
+  };
+  struct Link {
+    std::string name;
+    double utilization;
+    double avg_queue;
+    int max_queue;
+    long drops;
+    long marks;
+
+    Link();
+  };
+  std::vector<Flow> flows;
+  std::vector<Link> links;
+  // Jain's index of the throughputs of all flows
+  double jain_index;
+  // (end time, Jain's index) of each reporting interval, as given by
+  // Simulator::sample_fairness
+  std::vector< std::pair<double, double> > fairness;
+  uint64_t num_events;
+
+  TopologyResult();
+};
+
+// Runs 'topology' for 'duration' ms. Every flow's cctype must be valid. If
+// 'interval' is positive, fairness is sampled every 'interval' ms.
+TopologyResult run_topology(const Topology& topology,
+                            const WhiskerTree* whiskers, double duration,
+                            double interval, unsigned seed);
+
+#endif
@@ -1,8 +1,15 @@
+#include <algorithm>
 #include <iostream>
 #include <limits>
 
 #include "estimators.hh"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 using namespace std;
 
 void TimeEwma::reset() {
@@ -43,39 +50,115 @@ void TimeEwma::force_set(double value, double timestamp) {
 
 
 /*************************** PERCENTILE *******************************/
-void Percentile::push(ValType val) {
-	window.push(val);
-	if (window.size() > window_len)
-		window.pop();
+Percentile::Percentile(double percentile, int window_len) :
+	percentile(percentile),
+	window_len(window_len),
+	vals(window_len),
+	oldest(0),
+	count(0),
+	pos(window_len),
+	in_upper(window_len),
+	lower(),
+	upper()
+{
+	assert(window_len > 0);
+	lower.reserve(window_len);
+	upper.reserve(window_len);
+}
+
+// Whether slot a belongs closer to the top of the heap than slot b
+bool Percentile::before(const Heap& heap, int a, int b) const {
+	if (&heap == &upper)
+		return vals[a] < vals[b];
+	return vals[a] > vals[b];
 }
 
-Percentile::ValType Percentile::get_percentile_value() {
-	int N = (1.0 - percentile) * window_len;
-	ValType largest[window_len+1]; // Last element is only for making code shorter
-	for (int i = 0; i < N; i++) largest[i] = -1;
+void Percentile::swap_entries(Heap& heap, int i, int j) {
+	swap(heap[i], heap[j]);
+	pos[heap[i]] = i;
+	pos[heap[j]] = j;
+}
 
-	if (window.size() == 0)
-		return 0;
+void Percentile::sift_up(Heap& heap, int i) {
+	while (i > 0 && before(heap, heap[i], heap[(i - 1) / 2])) {
+		swap_entries(heap, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+void Percentile::sift_down(Heap& heap, int i) {
+	int n = heap.size();
+	while (true) {
+		int best = i, l = 2 * i + 1, r = 2 * i + 2;
+		if (l < n && before(heap, heap[l], heap[best])) best = l;
+		if (r < n && before(heap, heap[r], heap[best])) best = r;
+		if (best == i)
+			return;
+		swap_entries(heap, i, best);
+		i = best;
+	}
+}
+
+void Percentile::heap_push(Heap& heap, int slot) {
+	in_upper[slot] = (&heap == &upper);
+	pos[slot] = heap.size();
+	heap.push_back(slot);
+	sift_up(heap, heap.size() - 1);
+}
+
+int Percentile::heap_pop(Heap& heap) {
+	int slot = heap[0];
+	heap_erase(heap, slot);
+	return slot;
+}
 
-	for (int i = 0;i < window_len; i++) {
-		ValType val = window.front(), x = val;
-		window.pop();
-		for (int j = 0;j < N; j++) {
-			if (x <= largest[N-1]) continue;
-			if (x > largest[j]) {
-				ValType t = largest[j];
-				largest[j] = x;
-				x = t;
-			}
-		}
-		window.push(val);
+void Percentile::heap_erase(Heap& heap, int slot) {
+	int i = pos[slot];
+	swap_entries(heap, i, heap.size() - 1);
+	heap.pop_back();
+	if (i < (int)heap.size()) {
+		int moved = heap[i];
+		sift_up(heap, i);
+		sift_down(heap, pos[moved]);
 	}
-	return largest[N-1];
+}
+
+int Percentile::num_upper() const {
+	int n = (1.0 - percentile) * count;
+	return min(max(n, 1), count);
+}
+
+void Percentile::push(ValType val) {
+	if (count == window_len) {
+		heap_erase(in_upper[oldest] ? upper : lower, oldest);
+		oldest = (oldest + 1) % window_len;
+		-- count;
+	}
+	int slot = (oldest + count) % window_len;
+	vals[slot] = val;
+	++ count;
+	if (!lower.empty() && val <= vals[lower[0]])
+		heap_push(lower, slot);
+	else
+		heap_push(upper, slot);
+
+	int n = num_upper();
+	while ((int)upper.size() > n)
+		heap_push(lower, heap_pop(upper));
+	while ((int)upper.size() < n)
+		heap_push(upper, heap_pop(lower));
+}
+
+Percentile::ValType Percentile::get_percentile_value() const {
+	if (count == 0)
+		return 0;
+	return vals[upper[0]];
 }
 
 void Percentile::reset() {
-  while (!window.empty())
-    window.pop();
+	oldest = count = 0;
+	lower.clear();
+	upper.clear();
 }
 
 
@@ -137,15 +220,83 @@ void ReduceOnLoss::reset() {
 
 /*************************** TIME WINDOW ******************************/
 
+// Maximum of p[0..n). Uses SSE2/NEON where available. Plain loops are
+// not vectorized here since max is not associative under IEEE semantics
+// without -ffast-math.
+static double max_of(const double* p, size_t n, double res) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  if (n >= 2) {
+    __m128d acc = _mm_set1_pd(res);
+    for (; i + 2 <= n; i += 2)
+      acc = _mm_max_pd(acc, _mm_loadu_pd(p + i));
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    res = max(lanes[0], lanes[1]);
+  }
+#elif defined(__aarch64__)
+  if (n >= 2) {
+    float64x2_t acc = vdupq_n_f64(res);
+    for (; i + 2 <= n; i += 2)
+      acc = vmaxq_f64(acc, vld1q_f64(p + i));
+    res = vmaxvq_f64(acc);
+  }
+#endif
+  for (; i < n; ++i)
+    res = max(res, p[i]);
+  return res;
+}
+
+// Whether any of p[0..n) is less than threshold
+static bool any_below(const double* p, size_t n, double threshold) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  __m128d thresh = _mm_set1_pd(threshold);
+  __m128d acc = _mm_setzero_pd();
+  for (; i + 2 <= n; i += 2)
+    acc = _mm_or_pd(acc, _mm_cmplt_pd(_mm_loadu_pd(p + i), thresh));
+  if (_mm_movemask_pd(acc) != 0)
+    return true;
+#elif defined(__aarch64__)
+  float64x2_t thresh = vdupq_n_f64(threshold);
+  uint64x2_t acc = vdupq_n_u64(0);
+  for (; i + 2 <= n; i += 2)
+    acc = vorrq_u64(acc, vcltq_f64(vld1q_f64(p + i), thresh));
+  if ((vgetq_lane_u64(acc, 0) | vgetq_lane_u64(acc, 1)) != 0)
+    return true;
+#endif
+  for (; i < n; ++i)
+    if (p[i] < threshold)
+      return true;
+  return false;
+}
+
 TimeWindow::TimeWindow(double window_size) :
   window_size(window_size),
-  window()
+  times(),
+  data(),
+  min_queue(),
+  max_queue()
 {}
 
-void TimeWindow::update(double data, double time) {
-  window.push_back(make_pair(time, data));
-  while (!window.empty() && window.front().first < time - window_size)
-    window.pop_front();
+void TimeWindow::update(double value, double time) {
+  times.push_back(time);
+  data.push_back(value);
+  while (!min_queue.empty() && min_queue.back().second > value)
+    min_queue.pop_back();
+  min_queue.push_back(make_pair(time, value));
+  while (!max_queue.empty() && max_queue.back().second < value)
+    max_queue.pop_back();
+  max_queue.push_back(make_pair(time, value));
+
+  while (!times.empty() && times.front() < time - window_size) {
+    times.pop_front();
+    data.pop_front();
+  }
+  while (min_queue.front().first < time - window_size)
+    min_queue.pop_front();
+  while (max_queue.front().first < time - window_size)
+    max_queue.pop_front();
 }
 
 void TimeWindow::update_window_size(double new_window_size) {
@@ -153,96 +304,97 @@ void TimeWindow::update_window_size(double new_window_size) {
 }
 
 double TimeWindow::get_min() const {
-  if (window.empty())
+  if (times.empty())
     return 0;
-  double res = numeric_limits<double>::max();
-  for (const auto& x : window)
-    if (x.second < res)
-      res = x.second;
-  return res;
+  return min_queue.front().second;
 }
 
 double TimeWindow::get_max() const {
-  if (window.empty())
+  if (times.empty())
     return 0;
-  double res = numeric_limits<double>::min();
-  for (const auto& x : window)
-    if (x.second > res)
-      res = x.second;
-  return res;
+  return max_queue.front().second;
 }
 
-bool TimeWindow::is_copa(double rtt, double cur_time) const {
-  double min_rtt = numeric_limits<double>::max();
-  double max_rtt = numeric_limits<double>::min();
-  for (auto x = window.rbegin(); x != window.rend(); ++x) {
-    if (x->first > cur_time - 4*rtt)
-      max_rtt = max(max_rtt, x->second);
-    min_rtt = min(min_rtt, x->second);
-  }
-
-  bool before = false, after = false;
-  double threshold = min_rtt + 0.1 * (max_rtt - min_rtt);
-  int num_before = 0, num_after = 0;
-  for (auto x = window.rbegin(); x != window.rend(); ++x) {
-    if (x->first > cur_time - 2*rtt) {
-      if (x->second < threshold)
-        after = true;
-      ++ num_after;
-    }
-    else if (x->first > cur_time - 4*rtt) {
-      if (x->second < threshold)
-        before = true;
-      ++ num_before;
-    }
+size_t TimeWindow::first_after(double time) const {
+  size_t lo = 0, hi = times.size();
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (times[mid] > time)
+      hi = mid;
     else
-      break;
+      lo = mid + 1;
   }
+  return lo;
+}
+
+bool TimeWindow::is_copa(double rtt, double cur_time) const {
+  // Data-points in [begin_before, begin_after) are from 4 to 2 RTTs ago,
+  // those from begin_after onwards are from the last 2 RTTs
+  size_t begin_before = first_after(cur_time - 4*rtt);
+  size_t begin_after = first_after(cur_time - 2*rtt);
+  size_t num_before = begin_after - begin_before;
+  size_t num_after = times.size() - begin_after;
   if (num_after < 4 || num_before < 4)
     return true;
+
+  double min_rtt = get_min();
+  double max_rtt = numeric_limits<double>::lowest();
+  data.for_each_segment(begin_before, times.size(),
+    [&max_rtt](const double* p, size_t n) { max_rtt = max_of(p, n, max_rtt); });
+
+  double threshold = min_rtt + 0.1 * (max_rtt - min_rtt);
+  bool before = false, after = false;
+  data.for_each_segment(begin_before, begin_after,
+    [&](const double* p, size_t n) { before = before || any_below(p, n, threshold); });
+  data.for_each_segment(begin_after, times.size(),
+    [&](const double* p, size_t n) { after = after || any_below(p, n, threshold); });
   return before && after;
 }
 
 bool TimeWindow::empty() const {
-  return window.empty();
+  return times.empty();
 }
 
 void TimeWindow::reset() {
-  while (!window.empty()) {
-    window.pop_front();
-  }
+  times.clear();
+  data.clear();
+  min_queue.clear();
+  max_queue.clear();
 }
 
 /******************** Is Uniform Distribution? ************************/
 
-// Returns n choose k
-double combinatoral_nck(int n, int k) {
-  double res = 1;
-  if (k > n/2) k = n-k;
-  for (int i = n-k+1; i <= n; ++i)
-    res *= i;
-  for (int i = 1; i <= k; ++i)
-    res /= i;
-  return res;
+double IsUniformDistr::confidence(int num_seen, int num_greater) {
+  // Flat triangular table: row i (window size) has i + 1 entries, one per
+  // possible number of 'trues' j, holding P(Binomial(i, 1/2) < j).
+  static const vector<double> table = [] {
+    vector<double> res;
+    res.reserve((max_window_len + 1) * (max_window_len + 2) / 2);
+    // Row of Pascal's triangle, ie. i choose k
+    vector<double> nck(1, 1.0);
+    for (int i = 0; i <= max_window_len; ++i) {
+      double confidence = 0;
+      for (int j = 0; j <= i; ++j) {
+        res.push_back(ldexp(confidence, -i));
+        confidence += nck[j];
+      }
+      nck.push_back(1.0);
+      for (int k = i; k > 0; --k)
+        nck[k] += nck[k - 1];
+    }
+    return res;
+  }();
+  assert(0 <= num_greater && num_greater <= num_seen &&
+         num_seen <= max_window_len);
+  return table[num_seen * (num_seen + 1) / 2 + num_greater];
 }
 
 IsUniformDistr::IsUniformDistr(int window_len) :
   window_len(window_len),
-  window(),
-  sum(0),
-  precomputed()
+  window(window_len + 1),
+  sum(0)
 {
-  for (int i = 0; i <= window_len; ++i) {
-    precomputed.push_back(*(new vector<double>()));
-    for (int j = 0; j <= i; ++j) {
-      double confidence = 0;
-      for (int k = 0; k < j; ++k)
-        confidence += combinatoral_nck(i, k);
-      for (int k = 0; k < i; ++k)
-        confidence /= 2.0;
-      precomputed[i].push_back(confidence);
-    }
-  }
+  assert(window_len <= max_window_len);
 }
 
 void IsUniformDistr::update(double data) {
@@ -266,7 +418,7 @@ double IsUniformDistr::get_confidence(const TimeWindow& rtt_window) const {
     if (*it > mid)
       ++ num_greater;
     ++ num_seen;
-    double confidence = precomputed[num_seen][num_greater];
+    double confidence = IsUniformDistr::confidence(num_seen, num_greater);
     if (confidence > max_confidence)
       max_confidence = confidence;
   }
@@ -274,7 +426,6 @@ double IsUniformDistr::get_confidence(const TimeWindow& rtt_window) const {
 }
 
 void IsUniformDistr::reset() {
-  while (!window.empty())
-    window.pop_back();
+  window.clear();
   sum = 0;
 }
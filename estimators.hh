@@ -2,14 +2,13 @@
 #define ESTIMATORS_HH
 
 #include <cassert>
-#include <deque>
 #include <iostream>
-#include <list>
 #include <math.h>
-#include <queue>
 #include <tuple>
 #include <vector>
 
+#include "ring-buffer.hh"
+
 class TimeEwma {
 	double ewma;
 	double denominator;
@@ -79,7 +78,7 @@ class PlainEwma {
 // equal weightage.
 class WindowAverage {
 	// Format: (value, timestamp)
-	std::queue< std::pair<double, double> > window;
+	RingBuffer< std::pair<double, double> > window;
 	double window_size; // In time units
 	double sum;
 	// Timestamp of the value last popped. If 0.0, no value has been
@@ -102,13 +101,13 @@ class WindowAverage {
 	void update(double value, double timestamp) {
 		if (window.size() == 0) {
 			// Push two nearby values into the window
-			window.push(std::make_pair(value, timestamp - 1e-3));
+			window.push_back(std::make_pair(value, timestamp - 1e-3));
 			assert(prev_popped_timestamp == 0.0);
 			update(value, timestamp);
 			return;
 		}
 		sum += value * (timestamp - window.back().second);
-		window.push(std::make_pair(value, timestamp));
+		window.push_back(std::make_pair(value, timestamp));
 
 		// std::cout << "Sum = " << sum << " for " << window.size() << " at " << double(*(this)) << std::endl;
 
@@ -117,15 +116,14 @@ class WindowAverage {
 			if (prev_popped_timestamp != 0.0)
 				sum -= window.front().first * (window.front().second - prev_popped_timestamp);
 			prev_popped_timestamp = window.front().second;
-			window.pop();
+			window.pop_front();
 		}
 	}
 
 	void round() {assert(false);}
 
 	void reset() {
-		while (!window.empty())
-			window.pop();
+		window.clear();
 		sum = 0.0;
 		prev_popped_timestamp = 0.0;
 	}
@@ -141,25 +139,47 @@ class WindowAverage {
 	}
 };
 
-// Maintains the x percentile value over a small window
+// Maintains the x percentile value over a sliding window of the last
+// window_len values. The window is split into two heaps: a max-heap of
+// the values below the percentile and a min-heap of the values at or
+// above it, whose top is the answer. Every value knows its position in
+// its heap so the one leaving the window can be removed directly. A push
+// costs O(log window_len), a query is O(1), and all storage is allocated
+// once in the constructor.
 class Percentile {
-  // The following can be dynamic too. Constant makes it a little more
-  // efficient and to emphasize that the implementation is not
-  // efficient for large window sizes.
-  static constexpr int window_len = 100;
-  double percentile;
   typedef double ValType;
-  
-  std::queue<ValType> window;
+  // A heap of slot indices into 'vals'
+  typedef std::vector<int> Heap;
+
+  double percentile;
+  int window_len;
+
+  // Circular buffer of the values in the window, indexed by slot
+  std::vector<ValType> vals;
+  int oldest;
+  int count;
+  // For each slot, its index in the heap it belongs to and which heap
+  std::vector<int> pos;
+  std::vector<bool> in_upper;
+  // Max-heap of the values below the percentile value
+  Heap lower;
+  // Min-heap of the (1 - percentile) * count largest values
+  Heap upper;
+
+  bool before(const Heap& heap, int a, int b) const;
+  void swap_entries(Heap& heap, int i, int j);
+  void sift_up(Heap& heap, int i);
+  void sift_down(Heap& heap, int i);
+  void heap_push(Heap& heap, int slot);
+  int heap_pop(Heap& heap);
+  void heap_erase(Heap& heap, int slot);
+  int num_upper() const;
 
  public:
-  Percentile(double percentile) :
-    percentile(percentile),
-    window()
-  {}
+  Percentile(double percentile, int window_len = 100);
   
   void push(ValType val);
-  ValType get_percentile_value();
+  ValType get_percentile_value() const;
   void reset();
 };
 
@@ -168,11 +188,11 @@ class Percentile {
 // Applications"
 class LossRateEstimate {
   const int window = 8;
-  std::list<double> loss_events;
+  RingBuffer<double> loss_events;
   int cur_loss_interval;
 
 public:
-  LossRateEstimate() : loss_events(), cur_loss_interval() {}
+  LossRateEstimate() : loss_events(window + 1), cur_loss_interval() {}
 
   void reset() {loss_events.clear(); cur_loss_interval = 0; }
 	void update(bool lost);
@@ -202,10 +222,22 @@ public:
 
 // Maintains data-points in a given time window and provides
 // statistics on that.
+//
+// Times and data are stored as separate arrays so the scans in is_copa
+// run over contiguous doubles. The minimum and maximum are maintained
+// incrementally with monotone queues (as in ExtremeWindow), so get_min
+// and get_max are O(1).
 class TimeWindow {
   double window_size;
-  // Pair of (time, data) values.
-  std::deque< std::pair<double, double> > window;
+  RingBuffer<double> times;
+  RingBuffer<double> data;
+  // (time, data) pairs whose data is increasing (decreasing for
+  // max_queue). The front holds the minimum (maximum) of the window.
+  RingBuffer< std::pair<double, double> > min_queue;
+  RingBuffer< std::pair<double, double> > max_queue;
+
+  // Index of the first data-point with time strictly greater than 'time'
+  size_t first_after(double time) const;
 
 public:
   TimeWindow(double window_size);
@@ -228,14 +260,20 @@ public:
 // Reports true or false based on whether the confidence is greater
 // than a given alpha.
 class IsUniformDistr {
+  // Largest supported window_len. Bounds the size of the shared table of
+  // confidence values.
+  static constexpr int max_window_len = 64;
+
   int window_len;
-  std::deque<double> window;
+  RingBuffer<double> window;
 
   // Sum of values in the window. Used to compute average.
   double sum;
-  // Precomputed confidence values given window size and number of
-  // 'trues' in binomial hypothesis testing.
-  std::vector< std::vector<double> > precomputed;
+
+  // Confidence value given window size and number of 'trues' in
+  // binomial hypothesis testing. Looked up in a triangular table that is
+  // computed once per process and shared by all instances.
+  static double confidence(int num_seen, int num_greater);
 
  public:
   IsUniformDistr(int window_len);
@@ -0,0 +1,33 @@
+#ifndef FAIRNESS_HH
+#define FAIRNESS_HH
+
+// Jain's fairness index, (sum x)^2 / (n * sum x^2), of a set of values
+// that change one at a time (eg. packets delivered per flow). Only the
+// two sums are kept, so an update is O(1) and the index can be read at
+// any point of a run without a pass over thousands of flows.
+class JainIndex {
+  double sum;
+  double sum_sq;
+
+ public:
+  JainIndex() : sum(0), sum_sq(0) {}
+
+  // One of the values changed from 'old_val' to 'new_val'
+  void update(double old_val, double new_val) {
+    sum += new_val - old_val;
+    sum_sq += new_val * new_val - old_val * old_val;
+  }
+
+  // All values are 0 again
+  void reset() { sum = sum_sq = 0; }
+
+  // The index over 'n' values, those never updated being 0. 1 if all are
+  // 0.
+  double get(int n) const {
+    if (n <= 0 || sum_sq <= 0)
+      return 1;
+    return sum * sum / (n * sum_sq);
+  }
+};
+
+#endif
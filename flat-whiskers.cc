@@ -0,0 +1,243 @@
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "flat-whiskers.hh"
+
+using namespace std;
+
+static const char flat_magic[ 8 ] = { 'R', 'E', 'M', 'Y', 'F', 'L', 'A', 'T' };
+static const uint32_t flat_version = 2;
+static const uint32_t flat_byte_order = 0x01020304;
+
+static_assert( sizeof( FlatWhiskerHeader ) % alignof( FlatWhiskerNode ) == 0,
+	       "the nodes must be aligned in the mapped image" );
+static_assert( MemoryDefault::datasize <= FLAT_MAX_DATASIZE
+	       && MemoryWithLossSignal::datasize <= FLAT_MAX_DATASIZE
+	       && MemoryWithoutSlowRewma::datasize <= FLAT_MAX_DATASIZE,
+	       "FLAT_MAX_DATASIZE is too small" );
+
+template < typename MemoryType >
+bool FlatWhiskerNode::contains( const MemoryType & query ) const
+{
+  /* as MemoryRange::contains */
+  for ( unsigned int i = 0; i < MemoryType::datasize; i++ ) {
+    if ( !(query.field( i ) >= lower[ i ]) || !(query.field( i ) < upper[ i ]) ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+FlatWhiskerTree::~FlatWhiskerTree()
+{
+  if ( _image ) {
+    munmap( const_cast< void * >( _image ), _size );
+  }
+}
+
+bool FlatWhiskerTree::load( const string & filename )
+{
+  int fd = open( filename.c_str(), O_RDONLY );
+  if ( fd < 0 ) {
+    perror( "open" );
+    return false;
+  }
+
+  struct stat st;
+  if ( fstat( fd, &st ) < 0 ) {
+    perror( "fstat" );
+    close( fd );
+    return false;
+  }
+  size_t size = st.st_size;
+  if ( size < sizeof( FlatWhiskerHeader ) ) {
+    fprintf( stderr, "%s is not a compiled whisker tree.\n", filename.c_str() );
+    close( fd );
+    return false;
+  }
+
+  /* MAP_SHARED so that all the processes using the file share its pages */
+  void * image = mmap( nullptr, size, PROT_READ, MAP_SHARED, fd, 0 );
+  close( fd );
+  if ( image == MAP_FAILED ) {
+    perror( "mmap" );
+    return false;
+  }
+
+  const FlatWhiskerHeader * header = static_cast< const FlatWhiskerHeader * >( image );
+  const char * error = nullptr;
+  if ( memcmp( header->magic, flat_magic, sizeof( flat_magic ) ) != 0 ) {
+    error = "is not a compiled whisker tree";
+  } else if ( header->version != flat_version ) {
+    error = "has an unsupported version";
+  } else if ( header->byte_order != flat_byte_order ) {
+    error = "was compiled on a machine of different byte order";
+  } else if ( !RemyBuffers::MemoryType_IsValid( header->memory_type ) ) {
+    error = "has an unknown memory type";
+  } else if ( header->num_nodes == 0
+              || size != sizeof( FlatWhiskerHeader ) + header->num_nodes * sizeof( FlatWhiskerNode ) ) {
+    error = "is truncated or corrupt";
+  }
+
+  const FlatWhiskerNode * nodes = reinterpret_cast< const FlatWhiskerNode * >( header + 1 );
+  /* Children always follow their parent, so lookups stay in bounds and
+     terminate */
+  for ( uint32_t i = 0; !error && i < header->num_nodes; i++ ) {
+    const FlatWhiskerNode & node = nodes[ i ];
+    if ( node.num_children > 0
+         && ( node.first_child <= i || node.num_children > header->num_nodes - node.first_child ) ) {
+      error = "is corrupt";
+    }
+  }
+
+  if ( error ) {
+    fprintf( stderr, "%s %s.\n", filename.c_str(), error );
+    munmap( image, size );
+    return false;
+  }
+
+  if ( _image ) {
+    munmap( const_cast< void * >( _image ), _size );
+  }
+  _image = image;
+  _size = size;
+  _nodes = nodes;
+  _num_nodes = header->num_nodes;
+  _memory_type = RemyBuffers::MemoryType( header->memory_type );
+  return true;
+}
+
+template < typename MemoryType >
+const FlatWhisker & FlatWhiskerTree::use_whisker( const MemoryType & memory ) const
+{
+  assert( _nodes && MemoryType::type == _memory_type );
+
+  const FlatWhiskerNode * node = _nodes;
+  if ( !node->contains( memory ) ) {
+    node = nullptr;
+  }
+
+  /* descend */
+  while ( node && node->num_children > 0 ) {
+    const FlatWhiskerNode * child = _nodes + node->first_child;
+    const FlatWhiskerNode * end = child + node->num_children;
+    while ( child < end && !child->contains( memory ) ) {
+      child++;
+    }
+    node = child < end ? child : nullptr;
+  }
+
+  if ( !node ) {
+    fprintf( stderr, "ERROR: No whisker found for %s\n", memory.str().c_str() );
+    exit( 1 );
+  }
+
+  return node->whisker;
+}
+
+template const FlatWhisker & FlatWhiskerTree::use_whisker( const MemoryDefault & ) const;
+template const FlatWhisker & FlatWhiskerTree::use_whisker( const MemoryWithLossSignal & ) const;
+template const FlatWhisker & FlatWhiskerTree::use_whisker( const MemoryWithoutSlowRewma & ) const;
+
+bool FlatWhiskerTree::is_flat( const string & filename )
+{
+  char magic[ sizeof( flat_magic ) ];
+  FILE * f = fopen( filename.c_str(), "rb" );
+  if ( !f ) {
+    return false;
+  }
+  bool ret = fread( magic, sizeof( magic ), 1, f ) == 1
+    && memcmp( magic, flat_magic, sizeof( flat_magic ) ) == 0;
+  fclose( f );
+  return ret;
+}
+
+/* missing fields are wildcards, as for MemoryRange */
+template < typename MemoryType >
+static void set_domain( FlatWhiskerNode & node, const RemyBuffers::MemoryRange & domain )
+{
+  const MemoryType lower( true, domain.lower() ), upper( false, domain.upper() );
+  for ( unsigned int j = 0; j < MemoryType::datasize; j++ ) {
+    node.lower[ j ] = lower.field( j );
+    node.upper[ j ] = upper.field( j );
+  }
+}
+
+bool FlatWhiskerTree::compile( const RemyBuffers::WhiskerTree & dna, const string & filename )
+{
+  const RemyBuffers::MemoryType memory_type = dna_memory_type( dna );
+
+  /* breadth first, so that siblings are adjacent */
+  vector< const RemyBuffers::WhiskerTree * > order( 1, &dna );
+  vector< FlatWhiskerNode > nodes;
+  for ( size_t i = 0; i < order.size(); i++ ) {
+    const RemyBuffers::WhiskerTree & tree = *order[ i ];
+
+    FlatWhiskerNode node;
+    memset( &node, 0, sizeof( node ) );
+    switch ( memory_type ) {
+    case RemyBuffers::MEMORY_WITH_LOSS_SIGNAL:
+      set_domain< MemoryWithLossSignal >( node, tree.domain() );
+      break;
+    case RemyBuffers::MEMORY_WITHOUT_SLOW_REWMA:
+      set_domain< MemoryWithoutSlowRewma >( node, tree.domain() );
+      break;
+    default:
+      set_domain< MemoryDefault >( node, tree.domain() );
+    }
+
+    if ( tree.has_leaf() ) {
+      if ( tree.children_size() > 0 ) {
+        fprintf( stderr, "Invalid whisker tree: a node has both a leaf and children.\n" );
+        return false;
+      }
+      node.whisker.window_increment = tree.leaf().window_increment();
+      node.whisker.window_multiple = tree.leaf().window_multiple();
+      node.whisker.intersend = tree.leaf().intersend();
+    } else {
+      if ( tree.children_size() == 0 ) {
+        fprintf( stderr, "Invalid whisker tree: a node has neither a leaf nor children.\n" );
+        return false;
+      }
+      node.first_child = order.size();
+      node.num_children = tree.children_size();
+      for ( const auto &x : tree.children() ) {
+        order.push_back( &x );
+      }
+    }
+    nodes.push_back( node );
+  }
+
+  FlatWhiskerHeader header;
+  memset( &header, 0, sizeof( header ) );
+  memcpy( header.magic, flat_magic, sizeof( flat_magic ) );
+  header.version = flat_version;
+  header.byte_order = flat_byte_order;
+  header.memory_type = memory_type;
+  header.num_nodes = nodes.size();
+
+  /* write to a temporary file and rename it, so that senders mapping the
+     old image are not affected */
+  string tmpname = filename + ".tmp";
+  FILE * f = fopen( tmpname.c_str(), "wb" );
+  if ( !f ) {
+    perror( "fopen" );
+    return false;
+  }
+  bool ok = fwrite( &header, sizeof( header ), 1, f ) == 1
+    && fwrite( nodes.data(), sizeof( FlatWhiskerNode ), nodes.size(), f ) == nodes.size();
+  ok = ( fclose( f ) == 0 ) && ok;
+  if ( !ok || rename( tmpname.c_str(), filename.c_str() ) < 0 ) {
+    perror( "write" );
+    unlink( tmpname.c_str() );
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,100 @@
+#ifndef FLAT_WHISKERS_HH
+#define FLAT_WHISKERS_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "memory.hh"
+#include "dna.pb.h"
+
+/* A whisker tree compiled into one flat, position-independent image, so
+   that a RemyCC can mmap it read-only and query it in place: loading is a
+   page fault instead of a protobuf parse and a recursive build of
+   WhiskerTrees, and every sender process on a host shares one physical
+   copy. Compile with remy-compile; sender's if= accepts either format.
+
+   The image is a FlatWhiskerHeader followed by num_nodes FlatWhiskerNodes
+   in breadth-first order, so the children of a node are contiguous and
+   referred to by index. It holds native-endian doubles, so it is only
+   valid on machines of the byte order it was compiled on (load() checks),
+   and records the memory type of the tree, which lookups must be made
+   with.
+   Unlike a WhiskerTree it does not count whisker usage, which only
+   training needs. */
+
+/* The most signals of any memory type */
+const unsigned int FLAT_MAX_DATASIZE = 4;
+
+struct FlatWhisker {
+  int32_t window_increment;
+  uint32_t padding;
+  double window_multiple;
+  double intersend;
+
+  /* as Whisker::window */
+  unsigned int window( const unsigned int previous_window ) const { return std::min( std::max( 0, int( previous_window * window_multiple + window_increment ) ), 1000000 ); }
+};
+
+struct FlatWhiskerNode {
+  /* only the first MemoryType::datasize are used */
+  double lower[ FLAT_MAX_DATASIZE ];
+  double upper[ FLAT_MAX_DATASIZE ];
+  /* 0 children for a leaf, whose action is 'whisker' */
+  uint32_t first_child;
+  uint32_t num_children;
+  FlatWhisker whisker;
+
+  template < typename MemoryType >
+  bool contains( const MemoryType & query ) const;
+};
+
+struct FlatWhiskerHeader {
+  char magic[ 8 ];
+  uint32_t version;
+  /* 0x01020304 as written by the compiling machine */
+  uint32_t byte_order;
+  /* a RemyBuffers::MemoryType */
+  uint32_t memory_type;
+  uint32_t num_nodes;
+};
+
+class FlatWhiskerTree {
+private:
+  const void * _image;
+  size_t _size;
+  const FlatWhiskerNode * _nodes;
+  uint32_t _num_nodes;
+  RemyBuffers::MemoryType _memory_type;
+
+public:
+  FlatWhiskerTree() : _image( nullptr ), _size( 0 ), _nodes( nullptr ), _num_nodes( 0 ), _memory_type( RemyBuffers::MEMORY_DEFAULT ) {}
+  ~FlatWhiskerTree();
+
+  FlatWhiskerTree( const FlatWhiskerTree & ) = delete;
+  FlatWhiskerTree & operator=( const FlatWhiskerTree & ) = delete;
+
+  /* Maps 'filename'. Prints an error and returns false if it is not a
+     valid image for this machine. */
+  bool load( const std::string & filename );
+
+  bool loaded( void ) const { return _nodes != nullptr; }
+
+  /* The leaf whose domain contains 'memory', as WhiskerTree::use_whisker
+     (which exits if there is none). MemoryType must be memory_type(). */
+  template < typename MemoryType >
+  const FlatWhisker & use_whisker( const MemoryType & memory ) const;
+
+  unsigned int num_nodes( void ) const { return _num_nodes; }
+  const FlatWhiskerNode & node( const unsigned int i ) const { return _nodes[ i ]; }
+  RemyBuffers::MemoryType memory_type( void ) const { return _memory_type; }
+
+  /* Whether 'filename' starts like a compiled image (rather than DNA) */
+  static bool is_flat( const std::string & filename );
+
+  /* Writes the image of 'dna' (of dna_memory_type( dna )) to 'filename'.
+     Prints an error and returns false on failure. */
+  static bool compile( const RemyBuffers::WhiskerTree & dna, const std::string & filename );
+};
+
+#endif
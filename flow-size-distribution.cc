@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include "flow-size-distribution.hh"
+
+FlowSizeDistribution::FlowSizeDistribution()
+  : sizes(), keep(), alias(), mean_size(0)
+{}
+
+bool FlowSizeDistribution::load(const std::string& filename, double unit) {
+  std::ifstream in(filename);
+  if (!in) {
+    perror(filename.c_str());
+    return false;
+  }
+  std::vector<double> points, cdf;
+  std::string line;
+  int line_number = 0;
+  while (getline(in, line)) {
+    line_number++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::vector<double> values;
+    double value;
+    while (fields >> value)
+      values.push_back(value);
+    if (values.empty() && fields.eof())
+      continue;
+    if (values.size() < 2 || !fields.eof()) {
+      fprintf(stderr, "%s:%d: expected 'size cdf'.\n", filename.c_str(),
+              line_number);
+      return false;
+    }
+    double size = values[0] * unit, p = values.back();
+    if (size < 0 || p < 0 || p > 1 + 1e-9 ||
+        (!points.empty() && (size < points.back() || p < cdf.back()))) {
+      fprintf(stderr, "%s:%d: sizes and the cdf must not decrease, and the "
+              "cdf must be in [0, 1].\n", filename.c_str(), line_number);
+      return false;
+    }
+    points.push_back(size);
+    cdf.push_back(std::min(p, 1.0));
+  }
+  if (points.empty() || std::fabs(cdf.back() - 1) > 1e-6) {
+    fprintf(stderr, "%s: the cdf must end at 1.\n", filename.c_str());
+    return false;
+  }
+
+  // The probability of each segment, and the mean
+  size_t n = points.size();
+  std::vector<double> probability(n);
+  mean_size = 0;
+  for (size_t i = 0; i < n; i++) {
+    probability[i] = cdf[i] - (i ? cdf[i - 1] : 0);
+    double mid = i ? (points[i - 1] + points[i]) / 2 : points[0];
+    mean_size += probability[i] * mid;
+  }
+
+  // Vose's alias method: segments above the average probability give
+  // their excess to those below
+  keep.assign(n, 1);
+  alias.assign(n, 0);
+  std::vector<double> scaled(n);
+  std::vector<int> small, large;
+  for (size_t i = 0; i < n; i++) {
+    scaled[i] = probability[i] * n;
+    alias[i] = i;
+    (scaled[i] < 1 ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    int s = small.back(), l = large.back();
+    small.pop_back();
+    keep[s] = scaled[s];
+    alias[s] = l;
+    scaled[l] -= 1 - scaled[s];
+    if (scaled[l] < 1) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // What is left is 1 but for rounding
+  for (int i : small)
+    keep[i] = 1;
+  for (int i : large)
+    keep[i] = 1;
+  sizes.swap(points);
+  return true;
+}
+
+double FlowSizeDistribution::sample(PRNG& prng) const {
+  boost::random::uniform_real_distribution<> uniform(0, 1);
+  size_t i = std::min<size_t>(uniform(prng) * sizes.size(), sizes.size() - 1);
+  if (uniform(prng) >= keep[i])
+    i = alias[i];
+  double size = sizes[i];
+  if (i > 0)
+    size = sizes[i - 1] + uniform(prng) * (sizes[i] - sizes[i - 1]);
+  return std::max(std::ceil(size), 1.0);
+}
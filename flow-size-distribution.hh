@@ -0,0 +1,40 @@
+#ifndef FLOW_SIZE_DISTRIBUTION_HH
+#define FLOW_SIZE_DISTRIBUTION_HH
+
+#include <string>
+#include <vector>
+
+#include "random.hh"
+
+// An empirical distribution of flow sizes, such as the web search and
+// data mining workloads of the DCTCP and VL2 papers, read from a file of
+// lines "size cdf" (further columns before the cdf are ignored, as in the
+// files of pFabric and its successors; '#' starts a comment). Sizes
+// between two points are uniform, as ns-2's EmpiricalRandomVariable
+// interpolates. Sampling picks a segment with Vose's alias method and a
+// size within it, in O(1) however many points there are.
+class FlowSizeDistribution {
+  // Bytes, at each point of the CDF
+  std::vector<double> sizes;
+  // Segment 0 is the first point, segment i > 0 the sizes between points
+  // i - 1 and i. The alias table: segment i is kept with probability
+  // keep[i], else alias[i] is taken.
+  std::vector<double> keep;
+  std::vector<int> alias;
+  double mean_size;
+
+ public:
+  FlowSizeDistribution();
+
+  // Sizes in the file are multiplied by 'unit' (eg. 1460 for files in
+  // packets). Prints an error and returns false if it cannot be read or
+  // is not a CDF.
+  bool load(const std::string& filename, double unit);
+  bool loaded() const { return !sizes.empty(); }
+
+  // Bytes, at least 1
+  double sample(PRNG& prng) const;
+  double mean() const { return mean_size; }
+};
+
+#endif
@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "fluid-model.hh"
+#include "simulator.hh"
+
+using namespace std;
+
+namespace {
+
+enum FluidType { COPA, AIMD, CUBIC };
+
+enum CopaMode { CONSTANT_DELTA, AUTO_MODE, TCP_COOP };
+
+const double min_window = 2;
+// In packets, with time in seconds, as in Linux
+const double cubic_c = 0.4;
+const double cubic_beta = 0.7;
+
+struct CopaConf {
+  CopaMode mode;
+  double default_delta;
+};
+
+// Parses the part of delta_conf the fluid model understands. Returns false
+// if there is anything else.
+bool parse_copa_conf(string conf, CopaConf& res) {
+  if (conf.substr(0, 6) == "do_ss:")
+    conf = conf.substr(6);
+  if (conf.substr(0, 17) == "keep_ext_min_rtt:")
+    conf = conf.substr(17);
+  res.default_delta = 0.5;
+  if (conf.substr(0, 15) == "constant_delta:") {
+    res.mode = CONSTANT_DELTA;
+    res.default_delta = atof(conf.substr(15).c_str());
+  }
+  else if (conf.substr(0, 5) == "auto:") {
+    res.mode = AUTO_MODE;
+    res.default_delta = atof(conf.substr(5).c_str());
+  }
+  else if (conf.substr(0, 8) == "tcp_coop")
+    res.mode = TCP_COOP;
+  else
+    return false;
+  return res.default_delta > 0;
+}
+
+FluidType fluid_type(const string& cctype) {
+  if (cctype == "markovian")
+    return COPA;
+  if (cctype == "tcp")
+    return AIMD;
+  assert(cctype == "cubic");
+  return CUBIC;
+}
+
+// State of all flows, one entry per flow in each array. Flows are sorted
+// by controller so that each controller's update is one loop over a
+// contiguous range, and the loops shared by all controllers are straight
+// line code the compiler can vectorize.
+struct Flows {
+  size_t n;
+  // Shared. Times in ms, windows in packets and rates in packets/ms.
+  vector<double> window, base_rtt, rtt, rate, queue_seen, loss_seen;
+  vector<size_t> lag;  // base_rtt in steps
+  vector<double> loss_credit, last_loss;
+  vector<char> loss_event, slow_start;
+  // Accounting
+  vector<double> sent, delivered, dropped, rtt_sum;
+  // Copa
+  vector<double> delta, velocity, dir_sum, last_velocity_update;
+  vector<double> last_delta_update, peak_qdelay, last_drain;
+  vector<int> prev_dir;
+  // Cubic
+  vector<double> w_max, w_est, epoch, cubic_k;
+
+  Flows(size_t n) :
+    n(n),
+    window(n, min_window), base_rtt(n), rtt(n), rate(n), queue_seen(n),
+    loss_seen(n), lag(n), loss_credit(n), last_loss(n, -1e9),
+    loss_event(n), slow_start(n, 1),
+    sent(n), delivered(n), dropped(n), rtt_sum(n),
+    delta(n), velocity(n, 1), dir_sum(n), last_velocity_update(n),
+    last_delta_update(n), peak_qdelay(n), last_drain(n), prev_dir(n, 1),
+    w_max(n), w_est(n, min_window), epoch(n), cubic_k(n)
+  {}
+};
+
+/*** CONTROLLERS ***/
+
+// Copa as in MarkovianCC::update_intersend_time. Each ACK moves the window
+// by velocity / (delta * window) towards the target, i.e. by velocity /
+// delta per RTT. The velocity doubles every RTT the direction stays the
+// same.
+void update_copa(Flows& f, size_t begin, size_t end, const CopaConf& conf,
+                 double link_rate, double t, double dt) {
+  for (size_t i = begin; i < end; ++i) {
+    double qdelay = f.queue_seen[i] / link_rate;
+    double rtt = f.rtt[i];
+
+    // Delta. In auto mode Copa falls back to the loss-sensitive update when
+    // the queue has not nearly emptied in the last few RTTs (see
+    // TimeWindow::is_copa), which is the sign of a buffer-filling
+    // competitor.
+    f.peak_qdelay[i] = max(qdelay, f.peak_qdelay[i] * (1 - dt / (4 * rtt)));
+    if (qdelay <= 0.1 * f.peak_qdelay[i])
+      f.last_drain[i] = t;
+    bool loss_sensitive = conf.mode == TCP_COOP ||
+      (conf.mode == AUTO_MODE && t - f.last_drain[i] > 4 * rtt);
+    if (loss_sensitive) {
+      if (f.loss_event[i])
+        f.delta[i] *= 2;
+      else if (t - f.last_delta_update[i] >= rtt) {
+        f.delta[i] = 1. / (1. / f.delta[i] + 1.);
+        f.last_delta_update[i] = t;
+      }
+      f.delta[i] = min(f.delta[i], conf.default_delta);
+    }
+    else
+      f.delta[i] = conf.default_delta;
+
+    double target = (qdelay > 0) ? rtt / (qdelay * f.delta[i]) :
+      numeric_limits<double>::max();
+    if (f.slow_start[i]) {
+      f.window[i] += f.window[i] * dt / rtt;
+      if (f.window[i] >= target)
+        f.slow_start[i] = 0;
+    }
+    else {
+      int dir = (f.window[i] < target) ? 1 : -1;
+      f.dir_sum[i] += dir * dt;
+      f.window[i] += dir * f.velocity[i] * dt / (f.delta[i] * rtt);
+      if (t - f.last_velocity_update[i] >= rtt) {
+        int cur_dir = (f.dir_sum[i] >= 0) ? 1 : -1;
+        f.velocity[i] = (cur_dir == f.prev_dir[i]) ? 2 * f.velocity[i] : 1;
+        f.prev_dir[i] = cur_dir;
+        f.dir_sum[i] = 0;
+        f.last_velocity_update[i] = t;
+      }
+      if (f.velocity[i] > f.window[i] * f.delta[i])
+        f.velocity[i] /= 2;
+      f.velocity[i] = max(f.velocity[i], 1.);
+    }
+    f.window[i] = max(min_window, f.window[i]);
+  }
+}
+
+// Idealised AIMD: additive increase of one packet per RTT and halving on
+// loss, without slow start. DefaultCC does not halve on loss, so this is
+// not a model of it.
+void update_aimd(Flows& f, size_t begin, size_t end, double dt) {
+  for (size_t i = begin; i < end; ++i) {
+    double w = f.window[i];
+    w = f.loss_event[i] ? 0.5 * w : w + dt / f.rtt[i];
+    f.window[i] = max(min_window, w);
+  }
+}
+
+// Cubic as in Linux, with fast convergence and the TCP-friendly region.
+// The window grows by at most half its size per RTT.
+void update_cubic(Flows& f, size_t begin, size_t end, double t, double dt) {
+  for (size_t i = begin; i < end; ++i) {
+    double w = f.window[i];
+    if (f.loss_event[i]) {
+      f.w_max[i] = (w < f.w_max[i]) ? w * (1 + cubic_beta) / 2 : w;
+      w = max(min_window, cubic_beta * w);
+      f.w_est[i] = w;
+      f.epoch[i] = t;
+      f.cubic_k[i] = cbrt(f.w_max[i] * (1 - cubic_beta) / cubic_c);
+      f.slow_start[i] = 0;
+    }
+    else if (f.slow_start[i])
+      w += w * dt / f.rtt[i];
+    else {
+      double s = (t - f.epoch[i]) / 1000 - f.cubic_k[i];
+      double w_cubic = cubic_c * s * s * s + f.w_max[i];
+      f.w_est[i] += 3 * (1 - cubic_beta) / (1 + cubic_beta) * dt / f.rtt[i];
+      double target = max(w_cubic, f.w_est[i]);
+      w = max(w, min(target, w + 0.5 * w * dt / f.rtt[i]));
+    }
+    f.window[i] = w;
+  }
+}
+
+}  // namespace
+
+/*** MODEL ***/
+
+bool is_valid_fluid_cctype(const string& cctype) {
+  return cctype == "markovian" || cctype == "tcp" || cctype == "cubic";
+}
+
+bool is_valid_fluid_delta_conf(const string& delta_conf) {
+  CopaConf conf;
+  return parse_copa_conf(delta_conf, conf);
+}
+
+DumbbellResult run_dumbbell_fluid(const DumbbellConfig& config, double step) {
+  assert(config.num_senders >= 1 && step > 0);
+  assert(!config.cctypes.empty() && !config.extra_delays.empty());
+  CopaConf copa_conf = {CONSTANT_DELTA, 0.5};
+  bool copa_conf_ok = parse_copa_conf(config.delta_conf, copa_conf);
+
+  const size_t n = config.num_senders;
+  const double dt = step;
+  const double link_rate = config.link_rate / 1000;
+  const double buffer = (config.buffer < 0) ?
+    max(1., config.link_rate * 2 * config.delay / 1000) : config.buffer;
+
+  // Sort the senders by controller, remembering where each came from
+  vector<size_t> order(n);
+  for (size_t i = 0; i < n; ++i)
+    order[i] = i;
+  auto type_of = [&](size_t i) {
+    return fluid_type(config.cctypes[i % config.cctypes.size()]);
+  };
+  stable_sort(order.begin(), order.end(),
+              [&](size_t a, size_t b) { return type_of(a) < type_of(b); });
+  size_t type_begin[4] = {0, 0, 0, 0};
+  for (size_t i = 0; i < n; ++i)
+    ++ type_begin[type_of(order[i]) + 1];
+  for (int i = 1; i < 4; ++i)
+    type_begin[i] += type_begin[i - 1];
+  assert(type_begin[COPA + 1] == type_begin[COPA] || copa_conf_ok);
+
+  Flows f(n);
+  size_t max_lag = 1;
+  for (size_t i = 0; i < n; ++i) {
+    f.base_rtt[i] = 2 * config.delay +
+      config.extra_delays[order[i] % config.extra_delays.size()];
+    f.lag[i] = max<size_t>(1, size_t(f.base_rtt[i] / dt + 0.5));
+    max_lag = max(max_lag, f.lag[i]);
+    f.delta[i] = copa_conf.default_delta;
+  }
+
+  // The queue and loss rate of the last max_lag steps
+  size_t history_len = 1;
+  while (history_len <= max_lag)
+    history_len *= 2;
+  const size_t mask = history_len - 1;
+  vector<double> queue_history(history_len), loss_history(history_len);
+
+  double queue = 0, queue_integral = 0, max_queue = 0;
+  double served = 0, total_drops = 0;
+  const size_t num_steps = size_t(config.duration / dt);
+  for (size_t k = 0; k < num_steps; ++k) {
+    double t = k * dt;
+
+    // What each sender sees now and how fast it sends
+    double arrival_rate = 0;
+    for (size_t i = 0; i < n; ++i) {
+      size_t past = (k + history_len - f.lag[i]) & mask;
+      f.queue_seen[i] = queue_history[past];
+      f.loss_seen[i] = loss_history[past];
+      f.rtt[i] = f.base_rtt[i] + f.queue_seen[i] / link_rate;
+      f.rate[i] = f.window[i] / f.rtt[i];
+      arrival_rate += f.rate[i];
+    }
+
+    // The bottleneck
+    double arrived = arrival_rate * dt;
+    double new_queue = queue + arrived - link_rate * dt;
+    double overflow = max(0., new_queue - buffer);
+    new_queue = min(max(new_queue, 0.), buffer);
+    double loss_rate = (arrived > 0) ? overflow / arrived : 0;
+    served += queue + arrived - overflow - new_queue;
+    total_drops += overflow;
+    queue_integral += 0.5 * (queue + new_queue) * dt;
+    max_queue = max(max_queue, new_queue);
+    queue = new_queue;
+    queue_history[k & mask] = queue;
+    loss_history[k & mask] = loss_rate;
+
+    // Per-flow accounting, and loss events as the senders see them. A
+    // sender reacts once it has seen a full packet's worth of losses, and
+    // at most once per RTT.
+    for (size_t i = 0; i < n; ++i) {
+      double pkts = f.rate[i] * dt;
+      f.sent[i] += pkts;
+      f.delivered[i] += pkts * (1 - loss_rate);
+      f.dropped[i] += pkts * loss_rate;
+      f.rtt_sum[i] += pkts * f.rtt[i];
+
+      f.loss_credit[i] += pkts * f.loss_seen[i];
+      bool lost = f.loss_credit[i] >= 1;
+      f.loss_credit[i] = lost ? 0 : f.loss_credit[i];
+      f.loss_event[i] = lost && t - f.last_loss[i] >= f.rtt[i];
+      f.last_loss[i] = f.loss_event[i] ? t : f.last_loss[i];
+    }
+
+    update_copa(f, type_begin[COPA], type_begin[COPA + 1], copa_conf,
+                link_rate, t, dt);
+    update_aimd(f, type_begin[AIMD], type_begin[AIMD + 1], dt);
+    update_cubic(f, type_begin[CUBIC], type_begin[CUBIC + 1], t, dt);
+  }
+
+  double duration = num_steps * dt;
+  DumbbellResult result;
+  result.senders.resize(n);
+  vector<double> throughputs(n);
+  for (size_t i = 0; i < n; ++i) {
+    DumbbellResult::Sender& res = result.senders[order[i]];
+    res.cctype = config.cctypes[order[i] % config.cctypes.size()];
+    res.throughput = f.delivered[i] * 1000 / duration;
+    res.avg_rtt = (f.sent[i] > 0) ? f.rtt_sum[i] / f.sent[i] : 0;
+    res.pkts_sent = long(f.sent[i] + 0.5);
+    res.pkts_dropped = long(f.dropped[i] + 0.5);
+    throughputs[order[i]] = res.throughput;
+  }
+  result.utilization = served / (link_rate * duration);
+  result.avg_queue = queue_integral / duration;
+  result.max_queue = int(max_queue + 0.5);
+  result.drops = long(total_drops + 0.5);
+  result.jain_index = jain_index(throughputs);
+  result.num_events = num_steps;
+  return result;
+}
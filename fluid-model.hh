@@ -0,0 +1,36 @@
+#ifndef FLUID_MODEL_HH
+#define FLUID_MODEL_HH
+
+#include <string>
+
+#include "dumbbell.hh"
+
+// Approximates a dumbbell experiment with a fluid model instead of
+// simulating packets: every flow is a window that evolves continuously,
+// the bottleneck queue is the integral of the excess arrival rate, and
+// senders see the queue and the loss rate one base RTT late. The ODEs are
+// integrated with a fixed step, so the cost is independent of the link
+// rate and a 100 s run of 100 flows takes well under a second. It is
+// meant for pruning large parameter spaces before running the
+// packet-level simulator, not as a substitute for it.
+//
+// Supported controllers are markovian (Copa's target_window = rtt /
+// (queuing_delay * delta) with velocity and, in auto and tcp_coop modes,
+// the loss-driven delta adaptation), tcp and cubic. tcp is an idealised
+// AIMD that halves its window on every loss event, not a model of
+// DefaultCC, which never halves it and so loses far more.
+// Senders are always on and the bottleneck is a droptail buffer:
+// onduration, offduration, traffic_params, train_length, seed, queue,
+// queue_args and ecn are ignored.
+
+bool is_valid_fluid_cctype(const std::string& cctype);
+
+// Whether the fluid model understands 'delta_conf' (constant_delta:, auto:
+// or tcp_coop, optionally preceded by do_ss: and keep_ext_min_rtt:)
+bool is_valid_fluid_delta_conf(const std::string& delta_conf);
+
+// 'step' is the integration step in ms. It should be well below the
+// smallest RTT.
+DumbbellResult run_dumbbell_fluid(const DumbbellConfig& config, double step);
+
+#endif
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "latency-histogram.hh"
+
+LatencyHistogram::LatencyHistogram()
+  : counts(num_buckets, 0), total(0), sum(0), min_value(0), max_value(0)
+{}
+
+// Values below 2 * sub_buckets have a bucket each. Above, the value is
+// shifted right until it is in [sub_buckets, 2 * sub_buckets), and each
+// shift adds sub_buckets buckets.
+int LatencyHistogram::bucket_of(uint64_t us) {
+  if (us < 2 * sub_buckets)
+    return us;
+  if (us >= (uint64_t(1) << max_bits))
+    return num_buckets - 1;
+  int shift = 63 - __builtin_clzll(us) - 6;
+  return shift * sub_buckets + (us >> shift);
+}
+
+uint64_t LatencyHistogram::highest_in(int bucket) {
+  if (bucket < 2 * sub_buckets)
+    return bucket;
+  int shift = bucket / sub_buckets - 1;
+  uint64_t sub = bucket % sub_buckets + sub_buckets;
+  return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(double ms) {
+  double us = std::max(ms, 0.0) * 1e3 + 0.5;
+  if (us < double(uint64_t(1) << max_bits))
+    counts[bucket_of(us)]++;
+  else
+    counts[num_buckets - 1]++;
+  if (total == 0 || ms < min_value)
+    min_value = ms;
+  if (total == 0 || ms > max_value)
+    max_value = ms;
+  total++;
+  sum += ms;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+  if (other.total == 0)
+    return;
+  for (int i = 0; i < num_buckets; i++)
+    counts[i] += other.counts[i];
+  min_value = (total == 0) ? other.min_value : std::min(min_value, other.min_value);
+  max_value = (total == 0) ? other.max_value : std::max(max_value, other.max_value);
+  total += other.total;
+  sum += other.sum;
+}
+
+void LatencyHistogram::subtract(const LatencyHistogram& earlier) {
+  int lowest = -1, highest = -1;
+  for (int i = 0; i < num_buckets; i++) {
+    counts[i] -= earlier.counts[i];
+    if (counts[i] != 0) {
+      if (lowest < 0)
+        lowest = i;
+      highest = i;
+    }
+  }
+  total -= earlier.total;
+  sum -= earlier.sum;
+  if (total == 0) {
+    reset();
+    return;
+  }
+  // Within what was recorded in all
+  double low = lowest ? (highest_in(lowest - 1) + 1) / 1e3 : 0;
+  min_value = std::min(std::max(low, min_value), max_value);
+  max_value = std::min(highest_in(highest) / 1e3, max_value);
+}
+
+void LatencyHistogram::reset() {
+  std::fill(counts.begin(), counts.end(), 0);
+  total = 0;
+  sum = 0;
+  min_value = 0;
+  max_value = 0;
+}
+
+double LatencyHistogram::mean() const {
+  return total ? sum / total : 0;
+}
+
+double LatencyHistogram::percentile(double p) const {
+  if (total == 0)
+    return 0;
+  uint64_t rank = std::ceil(p / 100 * total);
+  rank = std::min(std::max(rank, uint64_t(1)), total);
+  uint64_t seen = 0;
+  int bucket = 0;
+  for (; bucket < num_buckets - 1; bucket++) {
+    seen += counts[bucket];
+    if (seen >= rank)
+      break;
+  }
+  // The bucket's bound may lie outside what was actually recorded
+  double ms = highest_in(bucket) / 1e3;
+  return std::min(std::max(ms, min_value), max_value);
+}
+
+std::string LatencyHistogram::summary() const {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "n=%llu mean=%.3f p50=%.3f p90=%.3f p99=%.3f p99.9=%.3f max=%.3f",
+           (unsigned long long) total, mean(), percentile(50),
+           percentile(90), percentile(99), percentile(99.9), max_value);
+  return buf;
+}
@@ -0,0 +1,887 @@
+// A userspace stand-in for mahimahi's mm-link and mm-delay shells. It
+// relays UDP between senders and a receiver: senders send to
+// 'listenport', their packets are forwarded to serverip:serverport from a
+// separate socket per sender, and the receiver's replies are relayed back
+// to the sender they belong to.
+//
+// Each direction is a buffer (droptail, codel, ...) drained at the
+// delivery opportunities of a mahimahi packet delivery trace, followed by
+// a fixed one-way delay. As in mm-link, every line of the trace is a time
+// in ms at which 1504 bytes may be delivered, the trace repeats with a
+// period equal to its last time, and unused opportunities are lost. A
+// direction without a trace is not rate limited.
+//
+// Arrival times come from the kernel (SO_TIMESTAMPNS) with nanosecond
+// resolution, timers use timerfd and sockets are read and written in
+// batches with recvmmsg/sendmmsg, so one emulator can carry many paths.
+//
+// The ECN bits of arriving packets (IP_RECVTOS) are kept when they are
+// relayed, so queues with 'ecn=1' can mark ECN capable packets instead of
+// dropping them.
+//
+// With 'topology=', the path is instead the links of a topology file (see
+// topology.hh), in series: every flow of the file gets its own listening
+// port and receiver, and its packets cross the links of its route, so
+// cross traffic can enter and leave mid-path. ACKs come back after the
+// propagation delay of the route, without queueing, as in the simulator.
+// Links are processed in the order packets cross them, so a packet can go
+// through several links in one pass.
+
+#include <cassert>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "fairness.hh"
+#include "queue-disc.hh"
+#include "ring-buffer.hh"
+#include "topology.hh"
+
+using namespace std;
+
+// Bytes per delivery opportunity, as in mahimahi
+const int opportunity_size = 1504;
+// IP and UDP headers, which count towards the size of a packet on the link
+const int header_size = 28;
+const int max_payload = 2048;
+const int batch_size = 32;
+const uint64_t ns_per_ms = 1000000;
+// ECN field of the IP TOS byte (RFC 3168). Both bits set is CE.
+const int ecn_ce = 3;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+void handle_signal(int) {
+  stop_requested = 1;
+}
+
+uint64_t clock_ns(clockid_t clock) {
+  timespec ts;
+  clock_gettime(clock, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**************************** PAYLOADS ********************************/
+
+// Storage for packets while they are in the emulator. Queues only hold
+// the index of a slot.
+class SlotPool {
+ public:
+  struct Slot {
+    char data[max_payload];
+    int len;
+    // Sender the packet came from or is going to
+    int client;
+    // IP TOS byte, including the ECN bits
+    int tos;
+    // Whether the packet goes to the server, and its position on the route
+    bool forward;
+    int hop;
+    // When it entered the emulator
+    uint64_t arrival;
+  };
+
+ private:
+  vector<Slot> slots;
+  vector<int> free_slots;
+
+ public:
+  SlotPool() : slots(), free_slots() {}
+
+  int alloc() {
+    if (free_slots.empty()) {
+      slots.emplace_back();
+      return slots.size() - 1;
+    }
+    int slot = free_slots.back();
+    free_slots.pop_back();
+    return slot;
+  }
+  void release(int slot) { free_slots.push_back(slot); }
+  Slot& operator[](int slot) { return slots[slot]; }
+};
+
+/*************************** DIRECTION ********************************/
+
+// One link of the path: buffer, trace-driven link and delay
+class Direction {
+ public:
+  struct Stats {
+    long pkts_in;
+    long pkts_delivered;
+    long bytes_delivered;
+    double queueing_delay_sum;
+  };
+
+ private:
+  string name;
+  SlotPool& pool;
+  vector<uint64_t> trace;
+  unique_ptr<QueueDisc> queue;
+  uint64_t delay;
+  uint64_t start_time;
+
+  // Packet partially delivered by earlier opportunities
+  bool in_transit;
+  QueuedPacket transit_pkt;
+  int transit_bytes_left;
+
+  uint64_t next_opportunity_index;
+  uint64_t next_opportunity;
+
+  // (time due, slot) of packets that left the link, in order
+  RingBuffer< pair<uint64_t, int> > delayed;
+
+  Stats stats;
+
+  double to_ms(uint64_t t) const { return double(t - start_time) / ns_per_ms; }
+
+  uint64_t opportunity_time(uint64_t index) const {
+    uint64_t period = trace.back();
+    return start_time + (trace[index % trace.size()] +
+                         (index / trace.size()) * period) * ns_per_ms;
+  }
+
+  void use_opportunity(uint64_t now);
+
+ public:
+  Direction(const string& name, SlotPool& pool, const vector<uint64_t>& trace,
+            unique_ptr<QueueDisc> queue, double delay_ms, uint64_t start_time);
+
+  // Runs the link up to time 'now'
+  void advance(uint64_t now);
+  // Adds a packet (in 'slot') that arrived at 'now'
+  void arrive(int slot, uint64_t now);
+  // When something next needs to happen, or UINT64_MAX
+  uint64_t next_event() const;
+
+  bool has_due(uint64_t now) const { return !delayed.empty() && delayed.front().first <= now; }
+  int due_slot() const { return delayed.front().second; }
+  uint64_t due_time() const { return delayed.front().first; }
+  void pop_due() { delayed.pop_front(); }
+
+  const string& get_name() const { return name; }
+  const Stats& get_stats() const { return stats; }
+  long get_drops() const { return queue->drops(); }
+  long get_marks() const { return queue->marks(); }
+};
+
+Direction::Direction(const string& name, SlotPool& pool,
+                     const vector<uint64_t>& trace, unique_ptr<QueueDisc> queue,
+                     double delay_ms, uint64_t start_time) :
+  name(name),
+  pool(pool),
+  trace(trace),
+  queue(move(queue)),
+  delay(uint64_t(delay_ms * ns_per_ms)),
+  start_time(start_time),
+  in_transit(false),
+  transit_pkt(),
+  transit_bytes_left(0),
+  next_opportunity_index(0),
+  next_opportunity(0),
+  delayed(),
+  stats({0, 0, 0, 0})
+{
+  this->queue->set_drop_callback([this](const QueuedPacket& pkt) {
+    this->pool.release(pkt.tag);
+  });
+  if (!this->trace.empty())
+    next_opportunity = opportunity_time(0);
+}
+
+void Direction::use_opportunity(uint64_t now) {
+  double now_ms = to_ms(now);
+  int budget = opportunity_size;
+  while (budget > 0) {
+    if (!in_transit) {
+      if (!queue->dequeue(transit_pkt, now_ms))
+        return;
+      in_transit = true;
+      transit_bytes_left = transit_pkt.size;
+      stats.queueing_delay_sum += now_ms - transit_pkt.enqueue_time;
+    }
+    int used = min(budget, transit_bytes_left);
+    budget -= used;
+    transit_bytes_left -= used;
+    if (transit_bytes_left == 0) {
+      in_transit = false;
+      if (transit_pkt.ce)
+        pool[transit_pkt.tag].tos |= ecn_ce;
+      ++ stats.pkts_delivered;
+      stats.bytes_delivered += transit_pkt.size;
+      delayed.push_back(make_pair(now + delay, transit_pkt.tag));
+    }
+  }
+}
+
+void Direction::advance(uint64_t now) {
+  if (trace.empty())
+    return;
+  while (next_opportunity <= now) {
+    if (!in_transit && queue->empty()) {
+      // Idle link: opportunities up to now are wasted
+      uint64_t period = trace.back() * ns_per_ms;
+      if (now - next_opportunity > period)
+        next_opportunity_index += ((now - next_opportunity) / period) * trace.size();
+    }
+    else
+      use_opportunity(next_opportunity);
+    next_opportunity = opportunity_time(++ next_opportunity_index);
+  }
+}
+
+void Direction::arrive(int slot, uint64_t now) {
+  ++ stats.pkts_in;
+  if (trace.empty()) {
+    ++ stats.pkts_delivered;
+    stats.bytes_delivered += pool[slot].len + header_size;
+    delayed.push_back(make_pair(now + delay, slot));
+    return;
+  }
+  // Opportunities before the arrival must not serve this packet
+  advance(now);
+  QueuedPacket pkt = QueuedPacket();
+  pkt.sent_time = to_ms(now);
+  pkt.size = pool[slot].len + header_size;
+  pkt.flow_id = pool[slot].client;
+  pkt.tag = slot;
+  pkt.ect = (pool[slot].tos & ecn_ce) != 0;
+  pkt.ce = (pool[slot].tos & ecn_ce) == ecn_ce;
+  queue->enqueue(pkt, to_ms(now));
+}
+
+uint64_t Direction::next_event() const {
+  uint64_t res = numeric_limits<uint64_t>::max();
+  if (!trace.empty() && (in_transit || !queue->empty()))
+    res = next_opportunity;
+  if (!delayed.empty())
+    res = min(res, delayed.front().first);
+  return res;
+}
+
+/**************************** SOCKETS *********************************/
+
+// Per-socket buffers for recvmmsg/sendmmsg
+struct Batch {
+  mmsghdr msgs[batch_size];
+  iovec iovs[batch_size];
+  sockaddr_in addrs[batch_size];
+  char control[batch_size][CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(int))];
+  int slots[batch_size];
+};
+
+int make_socket() {
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if (fd < 0) {
+    perror("socket");
+    exit(1);
+  }
+  int on = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0)
+    perror("setsockopt(SO_TIMESTAMPNS)");
+  if (setsockopt(fd, IPPROTO_IP, IP_RECVTOS, &on, sizeof(on)) < 0)
+    perror("setsockopt(IP_RECVTOS)");
+  int bufsize = 4 << 20;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+  return fd;
+}
+
+sockaddr_in make_addr(const string& ip, int port) {
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (ip == "")
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  else if (inet_aton(ip.c_str(), &addr.sin_addr) == 0) {
+    fprintf(stderr, "Invalid IP address '%s'.\n", ip.c_str());
+    exit(1);
+  }
+  return addr;
+}
+
+bool same_addr(const sockaddr_in& a, const sockaddr_in& b) {
+  return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+class Emulator {
+ public:
+  // A link, as given to the constructor
+  struct LinkSpec {
+    string name;
+    // Empty if not rate limited
+    vector<uint64_t> trace;
+    unique_ptr<QueueDisc> queue;
+    double delay;
+
+    LinkSpec(const string& name, const vector<uint64_t>& trace,
+             unique_ptr<QueueDisc> queue, double delay)
+      : name(name), trace(trace), queue(move(queue)), delay(delay) {}
+  };
+  // Where the packets of a flow enter the emulator
+  struct IngressSpec {
+    string name;
+    int listen_port;
+    sockaddr_in server_addr;
+    // Indices of the links crossed to the server and back
+    vector<int> route;
+    vector<int> return_route;
+
+    IngressSpec(const string& name, int listen_port,
+                const sockaddr_in& server_addr, const vector<int>& route,
+                const vector<int>& return_route)
+      : name(name), listen_port(listen_port), server_addr(server_addr),
+        route(route), return_route(return_route) {}
+  };
+
+ private:
+  struct Ingress {
+    IngressSpec spec;
+    int fd;
+  };
+  struct Client {
+    sockaddr_in addr;
+    int ingress;
+    // Connected to the server
+    int fd;
+    // Packets that left the last link towards the server
+    long pkts_delivered;
+    long bytes_delivered;
+    // Time from entering the emulator to leaving the last link (ms)
+    double delay_sum;
+    uint64_t first_arrival;
+    uint64_t last_delivery;
+  };
+
+  // epoll data of the timer. Listening sockets are numbered from 1 and
+  // clients from first_client.
+  enum {TIMER = 0};
+
+  int epoll_fd;
+  int timer_fd;
+  vector<Ingress> ingresses;
+  uint32_t first_client;
+  vector<Client> clients;
+  SlotPool pool;
+  vector< unique_ptr<Direction> > links;
+  // Links in the order packets cross them
+  vector<int> link_order;
+  Batch batch;
+  uint64_t start_time;
+  // Offset of CLOCK_REALTIME (used by SO_TIMESTAMPNS) from CLOCK_MONOTONIC
+  int64_t realtime_offset;
+  // Over the bytes delivered by each client
+  JainIndex fairness;
+
+  int find_client(int ingress, const sockaddr_in& addr);
+  void receive(int fd, int ingress, int client);
+  void delivered(Client& client, const SlotPool::Slot& slot, uint64_t now);
+  bool flush(int link, uint64_t now);
+  void arm_timer(uint64_t when);
+
+ public:
+  Emulator(uint64_t start_time, vector<LinkSpec>& link_specs,
+           const vector<IngressSpec>& ingress_specs);
+  ~Emulator();
+  Emulator(const Emulator&) = delete;
+  Emulator& operator=(const Emulator&) = delete;
+
+  void run();
+  void print_stats() const;
+};
+
+Emulator::Emulator(uint64_t start_time, vector<LinkSpec>& link_specs,
+                   const vector<IngressSpec>& ingress_specs) :
+  epoll_fd(epoll_create1(0)),
+  timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)),
+  ingresses(),
+  first_client(1 + ingress_specs.size()),
+  clients(),
+  pool(),
+  links(),
+  link_order(),
+  batch(),
+  start_time(start_time),
+  realtime_offset(int64_t(clock_ns(CLOCK_REALTIME)) -
+                  int64_t(clock_ns(CLOCK_MONOTONIC))),
+  fairness()
+{
+  if (epoll_fd < 0 || timer_fd < 0) {
+    perror("epoll/timerfd");
+    exit(1);
+  }
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u32 = TIMER;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+
+  for (LinkSpec& spec : link_specs)
+    links.emplace_back(new Direction(spec.name, pool, spec.trace,
+                                     move(spec.queue), spec.delay, start_time));
+
+  for (size_t i = 0; i < ingress_specs.size(); ++i) {
+    Ingress ingress = {ingress_specs[i], make_socket()};
+    sockaddr_in addr = make_addr("", ingress.spec.listen_port);
+    if (bind(ingress.fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+      perror("bind");
+      exit(1);
+    }
+    ev.data.u32 = 1 + i;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ingress.fd, &ev);
+    ingresses.push_back(ingress);
+  }
+
+  // Order the links so that every link comes before the ones packets go
+  // to next (Kahn's algorithm). Links on a cycle, which only a strange
+  // topology has, go last in their original order.
+  vector< vector<int> > next(links.size());
+  vector<int> num_prev(links.size(), 0);
+  for (const Ingress& ingress : ingresses)
+    for (const vector<int>* route : {&ingress.spec.route, &ingress.spec.return_route})
+      for (size_t h = 0; h + 1 < route->size(); ++h) {
+        next[(*route)[h]].push_back((*route)[h + 1]);
+        ++ num_prev[(*route)[h + 1]];
+      }
+  vector<bool> placed(links.size(), false);
+  for (size_t l = 0; l < links.size(); ++l)
+    if (num_prev[l] == 0)
+      link_order.push_back(l);
+  for (size_t i = 0; i < link_order.size(); ++i) {
+    placed[link_order[i]] = true;
+    for (int n : next[link_order[i]])
+      if (-- num_prev[n] == 0)
+        link_order.push_back(n);
+  }
+  for (size_t l = 0; l < links.size(); ++l)
+    if (!placed[l])
+      link_order.push_back(l);
+}
+
+Emulator::~Emulator() {
+  for (const auto& client : clients)
+    close(client.fd);
+  for (const auto& ingress : ingresses)
+    close(ingress.fd);
+  close(timer_fd);
+  close(epoll_fd);
+}
+
+// Returns the index of the client with address 'addr' on 'ingress',
+// creating a socket to the server for it if it is new
+int Emulator::find_client(int ingress, const sockaddr_in& addr) {
+  for (size_t i = 0; i < clients.size(); ++i)
+    if (clients[i].ingress == ingress && same_addr(clients[i].addr, addr))
+      return i;
+
+  const sockaddr_in& server_addr = ingresses[ingress].spec.server_addr;
+  Client client = {addr, ingress, make_socket(), 0, 0, 0, 0, 0};
+  if (connect(client.fd, (const sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+    perror("connect");
+    exit(1);
+  }
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u32 = first_client + clients.size();
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client.fd, &ev);
+  clients.push_back(client);
+  const string& name = ingresses[ingress].spec.name;
+  fprintf(stderr, "New sender %s:%d%s%s\n", inet_ntoa(addr.sin_addr),
+          ntohs(addr.sin_port), name.empty() ? "" : " on ", name.c_str());
+  return clients.size() - 1;
+}
+
+// Reads everything available on 'fd'. 'client' is -1 for the listening
+// socket of 'ingress' (packets from senders) or the client whose server
+// socket it is.
+void Emulator::receive(int fd, int ingress, int client) {
+  while (true) {
+    // Allocating may move the slots, so take all of them before pointing
+    // at any
+    for (int i = 0; i < batch_size; ++i)
+      batch.slots[i] = pool.alloc();
+    for (int i = 0; i < batch_size; ++i) {
+      batch.iovs[i].iov_base = pool[batch.slots[i]].data;
+      batch.iovs[i].iov_len = max_payload;
+      memset(&batch.msgs[i].msg_hdr, 0, sizeof(msghdr));
+      batch.msgs[i].msg_hdr.msg_iov = &batch.iovs[i];
+      batch.msgs[i].msg_hdr.msg_iovlen = 1;
+      batch.msgs[i].msg_hdr.msg_name = &batch.addrs[i];
+      batch.msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+      batch.msgs[i].msg_hdr.msg_control = batch.control[i];
+      batch.msgs[i].msg_hdr.msg_controllen = sizeof(batch.control[i]);
+    }
+    int n = recvmmsg(fd, batch.msgs, batch_size, MSG_DONTWAIT, nullptr);
+    uint64_t now = clock_ns(CLOCK_MONOTONIC);
+    for (int i = max(n, 0); i < batch_size; ++i)
+      pool.release(batch.slots[i]);
+    if (n <= 0) {
+      if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED)
+        perror("recvmmsg");
+      return;
+    }
+
+    for (int i = 0; i < n; ++i) {
+      msghdr& hdr = batch.msgs[i].msg_hdr;
+      int slot = batch.slots[i];
+      if (hdr.msg_flags & MSG_TRUNC) {
+        fprintf(stderr, "Dropping packet larger than %d bytes\n", max_payload);
+        pool.release(slot);
+        continue;
+      }
+      // Kernel receive time, if available and sane, and the TOS byte
+      uint64_t arrival = now;
+      pool[slot].tos = 0;
+      for (cmsghdr* c = CMSG_FIRSTHDR(&hdr); c != nullptr; c = CMSG_NXTHDR(&hdr, c)) {
+        if (c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_TOS)
+          pool[slot].tos = *(unsigned char*)CMSG_DATA(c);
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_TIMESTAMPNS) {
+          timespec ts;
+          memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+          int64_t t = int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec - realtime_offset;
+          if (t >= int64_t(start_time) && uint64_t(t) <= now)
+            arrival = t;
+        }
+      }
+
+      SlotPool::Slot& s = pool[slot];
+      s.len = batch.msgs[i].msg_len;
+      s.forward = client < 0;
+      s.hop = 0;
+      s.arrival = arrival;
+      s.client = s.forward ? find_client(ingress, batch.addrs[i]) : client;
+      Client& c = clients[s.client];
+      if (s.forward && c.first_arrival == 0)
+        c.first_arrival = arrival;
+      const IngressSpec& spec = ingresses[c.ingress].spec;
+      links[(s.forward ? spec.route : spec.return_route)[0]]->arrive(slot, arrival);
+    }
+    if (n < batch_size)
+      return;
+  }
+}
+
+void Emulator::delivered(Client& client, const SlotPool::Slot& slot,
+                         uint64_t now) {
+  fairness.update(client.bytes_delivered, client.bytes_delivered + slot.len);
+  ++ client.pkts_delivered;
+  client.bytes_delivered += slot.len;
+  client.delay_sum += double(now - slot.arrival) / ns_per_ms;
+  client.last_delivery = now;
+}
+
+// Moves the packets of 'link' that are due to the next link of their
+// route, or out of the emulator, batching consecutive packets going out of
+// the same socket. Returns whether any packet went to another link.
+bool Emulator::flush(int link, uint64_t now) {
+  Direction& direction = *links[link];
+  bool forwarded = false;
+  while (direction.has_due(now)) {
+    int n = 0;
+    int fd = -1;
+    while (n < batch_size && direction.has_due(now)) {
+      int slot = direction.due_slot();
+      SlotPool::Slot& s = pool[slot];
+      Client& client = clients[s.client];
+      const Ingress& ingress = ingresses[client.ingress];
+      const vector<int>& route = s.forward ? ingress.spec.route :
+        ingress.spec.return_route;
+      if (s.hop + 1 < int(route.size())) {
+        uint64_t due = direction.due_time();
+        direction.pop_due();
+        links[route[++ s.hop]]->arrive(slot, due);
+        forwarded = true;
+        continue;
+      }
+      int slot_fd = s.forward ? client.fd : ingress.fd;
+      if (n > 0 && slot_fd != fd)
+        break;
+      if (s.forward)
+        delivered(client, s, direction.due_time());
+      direction.pop_due();
+      fd = slot_fd;
+      batch.slots[n] = slot;
+      batch.iovs[n].iov_base = s.data;
+      batch.iovs[n].iov_len = s.len;
+      memset(&batch.msgs[n].msg_hdr, 0, sizeof(msghdr));
+      batch.msgs[n].msg_hdr.msg_iov = &batch.iovs[n];
+      batch.msgs[n].msg_hdr.msg_iovlen = 1;
+      if (!s.forward) {
+        batch.addrs[n] = client.addr;
+        batch.msgs[n].msg_hdr.msg_name = &batch.addrs[n];
+        batch.msgs[n].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+      }
+      if (s.tos != 0) {
+        msghdr& hdr = batch.msgs[n].msg_hdr;
+        hdr.msg_control = batch.control[n];
+        hdr.msg_controllen = CMSG_SPACE(sizeof(int));
+        cmsghdr* c = CMSG_FIRSTHDR(&hdr);
+        c->cmsg_level = IPPROTO_IP;
+        c->cmsg_type = IP_TOS;
+        c->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(c), &s.tos, sizeof(int));
+      }
+      ++ n;
+    }
+    // Packets the kernel would not take are lost, as on a real link
+    int sent = 0;
+    while (sent < n) {
+      int res = sendmmsg(fd, batch.msgs + sent, n - sent, MSG_DONTWAIT);
+      if (res <= 0)
+        break;
+      sent += res;
+    }
+    for (int i = 0; i < n; ++i)
+      pool.release(batch.slots[i]);
+  }
+  return forwarded;
+}
+
+void Emulator::arm_timer(uint64_t when) {
+  itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  if (when != numeric_limits<uint64_t>::max()) {
+    // A zero value would disarm the timer
+    when = max<uint64_t>(when, 1);
+    spec.it_value.tv_sec = when / 1000000000;
+    spec.it_value.tv_nsec = when % 1000000000;
+  }
+  timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void Emulator::run() {
+  epoll_event events[16];
+  while (!stop_requested) {
+    uint64_t next = numeric_limits<uint64_t>::max();
+    for (const auto& link : links)
+      next = min(next, link->next_event());
+    arm_timer(next);
+    int n = epoll_wait(epoll_fd, events, 16, -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      exit(1);
+    }
+    for (int i = 0; i < n; ++i) {
+      uint32_t id = events[i].data.u32;
+      if (id == TIMER) {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+          perror("read(timerfd)");
+      }
+      else if (id < first_client)
+        receive(ingresses[id - 1].fd, id - 1, -1);
+      else {
+        int client = id - first_client;
+        receive(clients[client].fd, clients[client].ingress, client);
+      }
+    }
+
+    uint64_t now = clock_ns(CLOCK_MONOTONIC);
+    bool forwarded = true;
+    while (forwarded) {
+      forwarded = false;
+      for (int link : link_order) {
+        links[link]->advance(now);
+        forwarded |= flush(link, now);
+      }
+    }
+  }
+}
+
+void Emulator::print_stats() const {
+  for (const auto& d : links) {
+    const Direction::Stats& stats = d->get_stats();
+    printf("%-9s %10ld pkts in, %10ld delivered, %8ld dropped, %8ld marked, avg. queueing delay %.3f ms\n",
+           (d->get_name() + ":").c_str(), stats.pkts_in, stats.pkts_delivered,
+           d->get_drops(), d->get_marks(),
+           stats.pkts_delivered ? stats.queueing_delay_sum / stats.pkts_delivered : 0.0);
+  }
+  for (const Client& c : clients) {
+    double time = double(c.last_delivery - c.first_arrival) / 1e9;
+    const string& name = ingresses[c.ingress].spec.name;
+    printf("sender %s:%d%s%s: %ld pkts delivered, %.3f Mbit/s, avg. delay %.3f ms\n",
+           inet_ntoa(c.addr.sin_addr), ntohs(c.addr.sin_port),
+           name.empty() ? "" : " on ", name.c_str(), c.pkts_delivered,
+           c.pkts_delivered && time > 0 ? 8e-6 * c.bytes_delivered / time : 0.0,
+           c.pkts_delivered ? c.delay_sum / c.pkts_delivered : 0.0);
+  }
+  if (clients.size() > 1)
+    printf("Jain's fairness index of bytes delivered: %.4f\n",
+           fairness.get(clients.size()));
+}
+
+/****************************** MAIN **********************************/
+
+// Reads a mahimahi packet delivery trace: one non-decreasing time in ms
+// per line
+vector<uint64_t> read_trace(const string& filename) {
+  vector<uint64_t> trace;
+  if (filename == "")
+    return trace;
+  ifstream in(filename);
+  if (!in) {
+    fprintf(stderr, "Could not open trace %s.\n", filename.c_str());
+    exit(1);
+  }
+  uint64_t t;
+  while (in >> t) {
+    if (!trace.empty() && t < trace.back()) {
+      fprintf(stderr, "Trace %s is not in increasing order.\n", filename.c_str());
+      exit(1);
+    }
+    trace.push_back(t);
+  }
+  if (trace.empty() || trace.back() == 0) {
+    fprintf(stderr, "Trace %s must be non-empty and end after time 0.\n",
+            filename.c_str());
+    exit(1);
+  }
+  return trace;
+}
+
+// A trace with 'rate' delivery opportunities per second, spread as evenly
+// as whole milliseconds allow
+vector<uint64_t> rate_trace(double rate) {
+  uint64_t n = max<uint64_t>(1, uint64_t(rate + 0.5));
+  vector<uint64_t> trace;
+  for (uint64_t k = 1; k <= n; ++k)
+    trace.push_back((k * 1000 + n - 1) / n);
+  return trace;
+}
+
+// Parses 'ip:port'
+sockaddr_in parse_server(const string& server) {
+  size_t pos = server.find(':');
+  if (pos == string::npos) {
+    fprintf(stderr, "Expected ip:port, got '%s'.\n", server.c_str());
+    exit(1);
+  }
+  return make_addr(server.substr(0, pos), atoi(server.substr(pos + 1).c_str()));
+}
+
+int main(int argc, char* argv[]) {
+  int listen_port = 9000;
+  string serverip = "127.0.0.1";
+  int serverport = 8888;
+  string uplink_trace = "", downlink_trace = "";
+  string uplink_queue = "infinite", downlink_queue = "infinite";
+  string uplink_queue_args = "", downlink_queue_args = "";
+  double uplink_delay = 0, downlink_delay = 0;
+  string topology_file = "";
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg.substr(0, 11) == "listenport=")
+      listen_port = atoi(arg.substr(11).c_str());
+    else if (arg.substr(0, 9) == "serverip=")
+      serverip = arg.substr(9);
+    else if (arg.substr(0, 11) == "serverport=")
+      serverport = atoi(arg.substr(11).c_str());
+    else if (arg.substr(0, 9) == "topology=")
+      topology_file = arg.substr(9);
+    else if (arg.substr(0, 7) == "uplink=")
+      uplink_trace = arg.substr(7);
+    else if (arg.substr(0, 9) == "downlink=")
+      downlink_trace = arg.substr(9);
+    else if (arg.substr(0, 13) == "uplink_queue=")
+      uplink_queue = arg.substr(13);
+    else if (arg.substr(0, 15) == "downlink_queue=")
+      downlink_queue = arg.substr(15);
+    else if (arg.substr(0, 18) == "uplink_queue_args=")
+      uplink_queue_args = arg.substr(18);
+    else if (arg.substr(0, 20) == "downlink_queue_args=")
+      downlink_queue_args = arg.substr(20);
+    else if (arg.substr(0, 13) == "uplink_delay=")
+      uplink_delay = atof(arg.substr(13).c_str());
+    else if (arg.substr(0, 15) == "downlink_delay=")
+      downlink_delay = atof(arg.substr(15).c_str());
+    else if (arg.substr(0, 6) == "delay=")
+      uplink_delay = downlink_delay = atof(arg.substr(6).c_str());
+    else {
+      fprintf(stderr, "Unrecognised option '%s'.\n", arg.c_str());
+      fprintf(stderr, "Usage: link-emulator [listenport=(port)] [serverip=(ipaddr)] [serverport=(port)] [topology=(filename)] [uplink=(trace)] [downlink=(trace)] [uplink_queue=infinite|droptail|codel|fq_codel|red|pie] [uplink_queue_args=] [downlink_queue=] [downlink_queue_args=] [delay=(one-way ms)] [uplink_delay=] [downlink_delay=]\n");
+      exit(1);
+    }
+  }
+
+  vector<Emulator::LinkSpec> links;
+  vector<Emulator::IngressSpec> ingresses;
+  sockaddr_in server_addr = make_addr(serverip, serverport);
+  if (topology_file == "") {
+    links.emplace_back("uplink", read_trace(uplink_trace),
+                       make_queue_disc(uplink_queue, uplink_queue_args),
+                       uplink_delay);
+    links.emplace_back("downlink", read_trace(downlink_trace),
+                       make_queue_disc(downlink_queue, downlink_queue_args),
+                       downlink_delay);
+    if (!links[0].queue || !links[1].queue)
+      exit(1);
+    ingresses.emplace_back("", listen_port, server_addr, vector<int>{0},
+                           vector<int>{1});
+  }
+  else {
+    if (uplink_trace != "" || downlink_trace != "" ||
+        uplink_queue != "infinite" || downlink_queue != "infinite" ||
+        uplink_queue_args != "" || downlink_queue_args != "" ||
+        uplink_delay != 0 || downlink_delay != 0) {
+      fprintf(stderr, "The uplink, downlink and delay options cannot be combined with a topology.\n");
+      exit(1);
+    }
+    Topology topology;
+    if (!read_topology(topology_file, topology))
+      exit(1);
+    for (size_t i = 0; i < topology.links.size(); ++i) {
+      const TopologyLink& l = topology.links[i];
+      links.emplace_back(l.name,
+                         l.trace.empty() ? rate_trace(l.rate) : read_trace(l.trace),
+                         make_topology_queue(topology, i), l.delay);
+      if (!links.back().queue)
+        exit(1);
+    }
+    // ACKs of each flow only take the propagation delay back
+    for (size_t i = 0; i < topology.flows.size(); ++i) {
+      const TopologyFlow& flow = topology.flows[i];
+      double ack_delay = flow.extra_delay;
+      for (int link : flow.route)
+        ack_delay += topology.links[link].delay;
+      links.emplace_back(flow.name + "-acks", vector<uint64_t>(),
+                         make_queue_disc("infinite", ""), ack_delay);
+      ingresses.emplace_back(flow.name,
+                             flow.listen_port ? flow.listen_port : listen_port + int(i),
+                             flow.server.empty() ? server_addr : parse_server(flow.server),
+                             flow.route, vector<int>{int(links.size()) - 1});
+    }
+  }
+
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+
+  Emulator emulator(clock_ns(CLOCK_MONOTONIC), links, ingresses);
+  for (const Emulator::IngressSpec& ingress : ingresses)
+    fprintf(stderr, "Relaying port %d to %s:%d%s%s\n", ingress.listen_port,
+            inet_ntoa(ingress.server_addr.sin_addr),
+            ntohs(ingress.server_addr.sin_port),
+            ingress.name.empty() ? "" : " for ", ingress.name.c_str());
+  emulator.run();
+  emulator.print_stats();
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include <algorithm>
+
+#include "link-rate-estimator.hh"
+
+// Trains whose ACKs may be outstanding at once. An older train still
+// incomplete when its slot is reused is dropped.
+static const int num_train_slots = 8;
+
+LinkRateEstimator::LinkRateEstimator(int train_length, int probe_interval,
+                                     int window_len, unsigned min_samples)
+  : train_length(train_length),
+    probe_interval(std::max(probe_interval, train_length)),
+    min_samples(min_samples),
+    num_samples(0),
+    trains(num_train_slots, Train(std::max(train_length, 0))),
+    gaps(0.5, window_len)
+{}
+
+LinkRateEstimator::Train* LinkRateEstimator::train_of(int seq_num) {
+  if (!enabled() || seq_num < 0 || seq_num % probe_interval >= train_length)
+    return nullptr;
+  int index = seq_num / probe_interval;
+  Train& train = trains[index % trains.size()];
+  if (train.index != index)
+    return nullptr;
+  return &train;
+}
+
+bool LinkRateEstimator::in_train(int seq_num) const {
+  return enabled() && seq_num >= 0 && seq_num % probe_interval != 0
+    && seq_num % probe_interval < train_length;
+}
+
+void LinkRateEstimator::on_send(int seq_num, double send_time) {
+  if (!enabled() || seq_num < 0 || seq_num % probe_interval >= train_length)
+    return;
+  int index = seq_num / probe_interval;
+  Train& train = trains[index % trains.size()];
+  if (seq_num % probe_interval == 0) {
+    train.index = index;
+    train.num_acked = 0;
+    train.valid = true;
+  }
+  else if (train.index != index)
+    return;
+  train.send_times[seq_num % probe_interval] = send_time;
+}
+
+bool LinkRateEstimator::on_ack(int seq_num, double receiver_timestamp) {
+  Train* train = train_of(seq_num);
+  if (train == nullptr || !train->valid)
+    return false;
+  int pos = seq_num % probe_interval;
+  // Packets must arrive in order, so each ACK is for the next packet of
+  // the train. Anything else means loss, reordering or a duplicate.
+  if (pos != train->num_acked) {
+    train->valid = false;
+    return false;
+  }
+  train->recv_times[pos] = receiver_timestamp;
+  if (++train->num_acked < train_length)
+    return false;
+  finish_train(*train);
+  return num_samples >= min_samples;
+}
+
+void LinkRateEstimator::finish_train(Train& train) {
+  train.valid = false;
+  double send_gap = (train.send_times.back() - train.send_times.front())
+    / (train_length - 1);
+  double recv_gap = (train.recv_times.back() - train.recv_times.front())
+    / (train_length - 1);
+  // The train must have been compressed at the sender and dispersed by
+  // the network for recv_gap to reflect the link
+  if (recv_gap <= 0 || send_gap >= recv_gap / 2)
+    return;
+  // The median is over the individual gaps rather than over trains, as
+  // a single disturbed gap would skew its train's mean
+  for (int i = 1; i < train_length; i++)
+    gaps.push(train.recv_times[i] - train.recv_times[i - 1]);
+  num_samples++;
+}
+
+void LinkRateEstimator::new_flow() {
+  for (Train& train : trains) {
+    train.index = -1;
+    train.num_acked = 0;
+    train.valid = false;
+  }
+}
+
+double LinkRateEstimator::get_link_rate() const {
+  if (num_samples < min_samples)
+    return 0;
+  return 1e3 / gaps.get_percentile_value();
+}
@@ -0,0 +1,71 @@
+#ifndef LINK_RATE_ESTIMATOR_HH
+#define LINK_RATE_ESTIMATOR_HH
+
+#include <vector>
+
+#include "estimators.hh"
+
+// Estimates the bottleneck link rate by packet-train dispersion. Every
+// probe_interval'th packet starts a train of train_length packets which
+// the sender sends back to back; the bottleneck spaces them out by its
+// per-packet service time, which is read off the receiver's timestamps.
+// Those are taken before the ACKs travel back, so unlike the ACK arrival
+// times they are immune to ACK compression on the reverse path.
+//
+// A train is discarded if any of its packets is lost or reordered, or if
+// it left the sender no faster than it arrived (the pacer or window then
+// spaced it out, not the link). Cross traffic spreads packets apart and
+// receiver batching squeezes them together, so the estimate is the median
+// of the last window_len gaps between consecutive packets of accepted
+// trains.
+class LinkRateEstimator {
+  struct Train {
+    // Index of the train (first seq_num / probe_interval), -1 if unused
+    int index;
+    int num_acked;
+    bool valid;
+    std::vector<double> send_times;
+    std::vector<double> recv_times;
+
+    Train(int length)
+      : index(-1), num_acked(0), valid(false),
+        send_times(length), recv_times(length) {}
+  };
+
+  int train_length;
+  int probe_interval;
+  unsigned min_samples;
+  unsigned num_samples;
+
+  // Trains in flight, indexed by index % trains.size()
+  std::vector<Train> trains;
+  // Median gap in ms between consecutive packets of recent trains
+  Percentile gaps;
+
+  Train* train_of(int seq_num);
+  void finish_train(Train& train);
+
+ public:
+  // A train_length below 2 disables probing
+  LinkRateEstimator(int train_length, int probe_interval,
+                    int window_len = 31, unsigned min_samples = 3);
+
+  bool enabled() const { return train_length >= 2; }
+
+  // Whether seq_num belongs to a train but is not its first packet, so it
+  // should be sent immediately after its predecessor
+  bool in_train(int seq_num) const;
+
+  void on_send(int seq_num, double send_time);
+  // Returns true if the ACK completed a train that updated the estimate
+  bool on_ack(int seq_num, double receiver_timestamp);
+
+  // Forget trains in flight, e.g. when a new flow restarts sequence
+  // numbers. The estimate is kept.
+  void new_flow();
+
+  // In packets per second, 0 until min_samples trains were accepted
+  double get_link_rate() const;
+};
+
+#endif
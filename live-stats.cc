@@ -0,0 +1,204 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "live-stats.hh"
+
+static const char stats_magic[8] = {'G', 'C', 'C', 'S', 'T', 'A', 'T', 'S'};
+static const uint32_t stats_version = 1;
+
+static_assert(sizeof(FlowStats) % sizeof(uint64_t) == 0,
+              "FlowStats is copied in words");
+
+FlowStats::FlowStats()
+  : state(FREE), src_id(-1), flow_id(-1), num_cc_state(0),
+    start_time(0), duration(0),
+    packets_sent(0), packets_acked(0), losses(0),
+    cwnd(0), intersend_time(0), min_rtt(0), srtt(0), last_rtt(0),
+    link_rate(0), cc_state(), cc_state_names()
+{}
+
+LiveStats::LiveStats()
+  : shm_name(), image(nullptr), size(0), header(nullptr), slots(nullptr),
+    owner(false), alloc_lock()
+{}
+
+LiveStats::~LiveStats() {
+  if (image != nullptr)
+    munmap(image, size);
+  if (owner)
+    shm_unlink(shm_name.c_str());
+}
+
+static std::string segment_name(const std::string& name) {
+  return "/genericcc." + name;
+}
+
+LiveStats* LiveStats::create(const std::string& name, Role role,
+                             unsigned num_slots) {
+  std::unique_ptr<LiveStats> stats(new LiveStats());
+  stats->shm_name = segment_name(name);
+  stats->size = sizeof(LiveStatsHeader) + num_slots * sizeof(Slot);
+
+  // A segment left by a process that was killed is replaced
+  shm_unlink(stats->shm_name.c_str());
+  int fd = shm_open(stats->shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    perror("shm_open");
+    return nullptr;
+  }
+  stats->owner = true;
+  if (ftruncate(fd, stats->size) < 0) {
+    perror("ftruncate");
+    close(fd);
+    return nullptr;
+  }
+  stats->image = mmap(nullptr, stats->size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+  close(fd);
+  if (stats->image == MAP_FAILED) {
+    stats->image = nullptr;
+    perror("mmap");
+    return nullptr;
+  }
+
+  // The pages start zeroed, so every slot is FREE with an even sequence
+  // number. The magic goes last, so readers never see a partial header.
+  stats->header = static_cast<LiveStatsHeader*>(stats->image);
+  stats->slots = reinterpret_cast<Slot*>(stats->header + 1);
+  stats->header->version = stats_version;
+  stats->header->num_slots = num_slots;
+  stats->header->pid = getpid();
+  stats->header->role = char(role);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(stats->header->magic, stats_magic, sizeof(stats_magic));
+  return stats.release();
+}
+
+LiveStats* LiveStats::open(const std::string& name) {
+  std::unique_ptr<LiveStats> stats(new LiveStats());
+  stats->shm_name = segment_name(name);
+  int fd = shm_open(stats->shm_name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    perror(stats->shm_name.c_str());
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror("fstat");
+    close(fd);
+    return nullptr;
+  }
+  stats->size = st.st_size;
+  if (stats->size < sizeof(LiveStatsHeader)) {
+    fprintf(stderr, "%s is not a statistics segment.\n",
+            stats->shm_name.c_str());
+    close(fd);
+    return nullptr;
+  }
+  stats->image = mmap(nullptr, stats->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (stats->image == MAP_FAILED) {
+    stats->image = nullptr;
+    perror("mmap");
+    return nullptr;
+  }
+  stats->header = static_cast<LiveStatsHeader*>(stats->image);
+  stats->slots = reinterpret_cast<Slot*>(stats->header + 1);
+  const char* error = nullptr;
+  if (memcmp(stats->header->magic, stats_magic, sizeof(stats_magic)) != 0)
+    error = "is not a statistics segment (or is being created)";
+  else if (stats->header->version != stats_version)
+    error = "has an unsupported version";
+  else if (stats->size < sizeof(LiveStatsHeader)
+           + stats->header->num_slots * sizeof(Slot))
+    error = "is truncated";
+  if (error != nullptr) {
+    fprintf(stderr, "%s %s.\n", stats->shm_name.c_str(), error);
+    return nullptr;
+  }
+  return stats.release();
+}
+
+static std::unique_ptr<LiveStats> process_stats;
+
+LiveStats* LiveStats::instance() {
+  return process_stats.get();
+}
+
+void LiveStats::enable(const std::string& name, Role role) {
+  process_stats.reset(create(name, role));
+  if (process_stats == nullptr)
+    exit(1);
+}
+
+int LiveStats::open_slot() {
+  std::lock_guard<std::mutex> lock(alloc_lock);
+  int best = -1;
+  double best_end = 0;
+  FlowStats stats;
+  for (unsigned i = 0; i < num_slots(); i++) {
+    if (!read(i, stats))
+      continue;
+    if (stats.state == FlowStats::FREE) {
+      best = i;
+      break;
+    }
+    double end = stats.start_time + stats.duration / 1e3;
+    if (stats.state == FlowStats::FINISHED && (best < 0 || end < best_end)) {
+      best = i;
+      best_end = end;
+    }
+  }
+  // Claim it before another opener can pick it too; the caller publishes
+  // the flow's statistics over this
+  if (best >= 0) {
+    FlowStats claimed;
+    claimed.state = FlowStats::ACTIVE;
+    publish(best, claimed);
+  }
+  return best;
+}
+
+void LiveStats::publish(int slot, const FlowStats& stats) {
+  Slot& s = slots[slot];
+  uint64_t words[num_words];
+  memcpy(words, &stats, sizeof(stats));
+
+  // Only this thread writes the slot, so a relaxed load suffices
+  uint32_t seq = s.seq.load(std::memory_order_relaxed);
+  s.seq.store(seq + 1, std::memory_order_relaxed);
+  // Readers must not see new words with the old, even sequence number
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t i = 0; i < num_words; i++)
+    s.words[i].store(words[i], std::memory_order_relaxed);
+  s.seq.store(seq + 2, std::memory_order_release);
+}
+
+void LiveStats::close_slot(int slot, FlowStats& stats) {
+  stats.state = FlowStats::FINISHED;
+  publish(slot, stats);
+}
+
+bool LiveStats::read(int slot, FlowStats& stats) const {
+  const Slot& s = slots[slot];
+  uint64_t words[num_words];
+  // A writer killed while publishing leaves the sequence number odd
+  for (int attempt = 0; attempt < 100000; attempt++) {
+    uint32_t seq = s.seq.load(std::memory_order_acquire);
+    if (seq % 2 == 1)
+      continue;
+    for (size_t i = 0; i < num_words; i++)
+      words[i] = s.words[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s.seq.load(std::memory_order_relaxed) == seq) {
+      memcpy(&stats, words, sizeof(stats));
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,121 @@
+#ifndef LIVE_STATS_HH
+#define LIVE_STATS_HH
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Live per-flow statistics of a running sender or receiver, published in
+// a shared memory segment (/dev/shm/genericcc.<name>) that any number of
+// readers (see ccstat.cc) can sample without disturbing the flows.
+//
+// The segment is a LiveStatsHeader followed by an array of slots, each
+// holding the FlowStats of one flow behind a seqlock: the writer makes
+// the sequence number odd, stores the words of the new FlowStats and
+// makes it even again, and a reader retries until it copied the words
+// between two equal, even sequence numbers. Writers never wait for
+// readers, and a slot has one writer.
+
+// The number of controller specific values (CCC::get_state) per flow
+const int STATS_STATE_SIZE = 8;
+
+struct FlowStats {
+  enum State : uint32_t { FREE = 0, ACTIVE = 1, FINISHED = 2 };
+  uint32_t state;
+  int32_t src_id;
+  int32_t flow_id;
+  uint32_t num_cc_state;
+
+  // Unix time the flow started and ms since, at the last update
+  double start_time;
+  double duration;
+
+  // For a receiver, 'packets_acked' counts the packets it received and
+  // 'losses' the packets it missed
+  uint64_t packets_sent;
+  uint64_t packets_acked;
+  uint64_t losses;
+
+  double cwnd;
+  double intersend_time;
+  double min_rtt;
+  double srtt;
+  double last_rtt;
+  double link_rate;
+
+  // Controller specific values and their names, comma separated
+  double cc_state[STATS_STATE_SIZE];
+  char cc_state_names[128];
+
+  FlowStats();
+};
+
+struct LiveStatsHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_slots;
+  int32_t pid;
+  // 's' for a sender, 'r' for a receiver
+  char role;
+  char padding[3];
+};
+
+class LiveStats {
+ public:
+  enum Role { SENDER = 's', RECEIVER = 'r' };
+
+ private:
+  static const size_t num_words = sizeof(FlowStats) / sizeof(uint64_t);
+  struct Slot {
+    std::atomic<uint32_t> seq;
+    uint32_t padding;
+    std::atomic<uint64_t> words[num_words];
+  };
+
+  std::string shm_name;
+  void* image;
+  size_t size;
+  LiveStatsHeader* header;
+  Slot* slots;
+  bool owner;
+  // Serializes slot allocation in the writer
+  std::mutex alloc_lock;
+
+  LiveStats();
+
+ public:
+  ~LiveStats();
+  LiveStats(const LiveStats&) = delete;
+  LiveStats& operator=(const LiveStats&) = delete;
+
+  // Creates the segment of 'name', replacing any stale one. Prints an
+  // error and returns nullptr on failure.
+  static LiveStats* create(const std::string& name, Role role,
+                           unsigned num_slots = 256);
+  // Maps an existing segment read-only, for readers
+  static LiveStats* open(const std::string& name);
+
+  // The segment the flows of this process publish to, if any. Set once by
+  // main() with enable(), which exits on failure.
+  static LiveStats* instance();
+  static void enable(const std::string& name, Role role);
+
+  unsigned num_slots() const { return header->num_slots; }
+  int pid() const { return header->pid; }
+  char role() const { return header->role; }
+
+  // Writer: claims a free slot (or the finished one updated longest
+  // ago) and marks it active, -1 if all are active
+  int open_slot();
+  void publish(int slot, const FlowStats& stats);
+  // Marks the flow finished, keeping its last statistics
+  void close_slot(int slot, FlowStats& stats);
+
+  // Reader: a consistent copy of the slot. False if the writer died while
+  // updating it.
+  bool read(int slot, FlowStats& stats) const;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "live-whiskers.hh"
+
+using namespace std;
+
+template < typename MemoryType >
+bool LiveWhiskerTree< MemoryType >::file_id( const string & filename, FileId & id )
+{
+  struct stat st;
+  if ( stat( filename.c_str(), &st ) < 0 ) {
+    return false;
+  }
+  id.dev = st.st_dev;
+  id.ino = st.st_ino;
+  id.size = st.st_size;
+  id.mtime = st.st_mtim;
+  return true;
+}
+
+template < typename MemoryType >
+typename LiveWhiskerTree< MemoryType >::Version * LiveWhiskerTree< MemoryType >::load( const string & filename )
+{
+  Version * version = new Version;
+
+  if ( FlatWhiskerTree::is_flat( filename ) ) {
+    if ( !version->flat.load( filename ) ) {
+      delete version;
+      return nullptr;
+    }
+    if ( version->flat.memory_type() != MemoryType::type ) {
+      fprintf( stderr, "%s is of memory type '%s', not '%s'.\n", filename.c_str(),
+               memory_type_name( version->flat.memory_type() ), memory_type_name( MemoryType::type ) );
+      delete version;
+      return nullptr;
+    }
+    return version;
+  }
+
+  int fd = open( filename.c_str(), O_RDONLY );
+  if ( fd < 0 ) {
+    perror( "open" );
+    delete version;
+    return nullptr;
+  }
+  RemyBuffers::WhiskerTree dna;
+  bool parsed = dna.ParseFromFileDescriptor( fd );
+  close( fd );
+  if ( !parsed ) {
+    fprintf( stderr, "Could not parse %s.\n", filename.c_str() );
+    delete version;
+    return nullptr;
+  }
+  /* as the sender, trust the running type for trees that do not record
+     theirs */
+  if ( dna.has_memory_type() && dna.memory_type() != MemoryType::type ) {
+    fprintf( stderr, "%s is of memory type '%s', not '%s'.\n", filename.c_str(),
+             memory_type_name( dna.memory_type() ), memory_type_name( MemoryType::type ) );
+    delete version;
+    return nullptr;
+  }
+  version->tree = BasicWhiskerTree< MemoryType >( dna );
+  return version;
+}
+
+template < typename MemoryType >
+LiveWhiskerTree< MemoryType >::LiveWhiskerTree( const string & filename, const unsigned int poll_interval )
+  : _filename( filename ),
+    _poll_interval( poll_interval ),
+    _loaded_id(),
+    _current( nullptr ),
+    _last_poll( chrono::steady_clock::now() ),
+    _watcher()
+{
+  file_id( _filename, _loaded_id );
+  Version * initial = load( _filename );
+  if ( !initial ) {
+    exit( 1 );
+  }
+  _current.publish( initial );
+
+  _watcher.reset( new SignalWatcher( SIGHUP, [ this ] ( bool hangup ) { watch( hangup ); } ) );
+}
+
+template < typename MemoryType >
+LiveWhiskerTree< MemoryType >::~LiveWhiskerTree()
+{
+  /* stop reloading before the versions go */
+  _watcher.reset();
+}
+
+template < typename MemoryType >
+bool LiveWhiskerTree< MemoryType >::reload( void )
+{
+  FileId id;
+  if ( !file_id( _filename, id ) ) {
+    perror( "stat" );
+    return false;
+  }
+  Version * version = load( _filename );
+  if ( !version ) {
+    fprintf( stderr, "Keeping the current whisker tree.\n" );
+    /* do not retry until the file changes again */
+    _loaded_id = id;
+    return false;
+  }
+  /* waits for the controllers to finish with the old version */
+  _current.publish( version );
+  _loaded_id = id;
+  fprintf( stderr, "Reloaded %s.\n", _filename.c_str() );
+  return true;
+}
+
+template < typename MemoryType >
+void LiveWhiskerTree< MemoryType >::watch( const bool hangup )
+{
+  if ( hangup ) {
+    reload();
+    return;
+  }
+
+  auto now = chrono::steady_clock::now();
+  if ( now - _last_poll < chrono::milliseconds( _poll_interval ) ) {
+    return;
+  }
+  _last_poll = now;
+
+  FileId id;
+  /* the file may briefly be missing while it is being replaced */
+  if ( !file_id( _filename, id ) ) {
+    return;
+  }
+  if ( id.dev != _loaded_id.dev || id.ino != _loaded_id.ino || id.size != _loaded_id.size
+       || id.mtime.tv_sec != _loaded_id.mtime.tv_sec || id.mtime.tv_nsec != _loaded_id.mtime.tv_nsec ) {
+    reload();
+  }
+}
+
+template class LiveWhiskerTree< MemoryDefault >;
+template class LiveWhiskerTree< MemoryWithLossSignal >;
+template class LiveWhiskerTree< MemoryWithoutSlowRewma >;
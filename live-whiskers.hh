@@ -0,0 +1,72 @@
+#ifndef LIVE_WHISKERS_HH
+#define LIVE_WHISKERS_HH
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+#include "flat-whiskers.hh"
+#include "rcu.hh"
+#include "signal-watcher.hh"
+#include "whiskertree.hh"
+
+/* A whisker tree that follows its file, so that a running sender can be
+   given a new RemyCC without restarting its flows. A watcher thread polls
+   the file (which remy-optimizer and remy-compile replace atomically by a
+   rename) and reloads it when it changes, or at once when the process gets
+   SIGHUP. Each load builds a new immutable version, published with an
+   RcuCell: controllers keep using the version they hold until their
+   current ACK is processed, and never take a lock to look up a whisker.
+
+   The file may be in either format, but must be of MemoryType; a version
+   that fails to load or is of another type is reported and ignored. */
+template < typename MemoryType >
+class LiveWhiskerTree {
+public:
+  /* exactly one of these is loaded */
+  struct Version {
+    BasicWhiskerTree< MemoryType > tree;
+    FlatWhiskerTree flat;
+
+    Version() : tree(), flat() {}
+  };
+
+private:
+  std::string _filename;
+  unsigned int _poll_interval;
+
+  /* identifies the file last loaded */
+  struct FileId {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+  } _loaded_id;
+
+  RcuCell< Version > _current;
+  std::chrono::steady_clock::time_point _last_poll;
+  std::unique_ptr< SignalWatcher > _watcher;
+
+  static bool file_id( const std::string & filename, FileId & id );
+  static Version * load( const std::string & filename );
+  /* Loads the file now. Returns whether a new version was published. */
+  bool reload( void );
+  /* every SignalWatcher tick */
+  void watch( const bool hangup );
+
+public:
+  /* Loads 'filename', exiting on failure, and checks it every
+     'poll_interval' ms */
+  LiveWhiskerTree( const std::string & filename, const unsigned int poll_interval );
+  ~LiveWhiskerTree();
+
+  LiveWhiskerTree( const LiveWhiskerTree & ) = delete;
+  LiveWhiskerTree & operator=( const LiveWhiskerTree & ) = delete;
+
+  /* For controllers, see RcuCell */
+  int register_reader( void ) { return _current.register_reader(); }
+  RcuCell< Version > & versions( void ) { return _current; }
+};
+
+#endif
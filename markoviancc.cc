@@ -1,7 +1,9 @@
 #undef NDEBUG // We want the assert statements to work
 
 #include "markoviancc.hh"
+#include "trace.hh"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <iomanip>
@@ -10,7 +12,7 @@
 
 using namespace std;
 
-int MarkovianCC::flow_id_counter = 0;
+std::atomic<int> MarkovianCC::flow_id_counter(0);
 
 double MarkovianCC::current_timestamp( void ){
   return cur_tick;
@@ -79,6 +81,7 @@ void MarkovianCC::init() {
 
 void MarkovianCC::update_delta(bool pkt_lost __attribute((unused)), double cur_rtt) {
   double cur_time = current_timestamp();
+  double prev_delta = delta;
   if (utility_mode == AUTO_MODE) {
     if (pkt_lost) {
       is_uniform.update(rtt_window.get_unjittered_rtt());
@@ -121,6 +124,11 @@ void MarkovianCC::update_delta(bool pkt_lost __attribute((unused)), double cur_r
     }
     delta = min(delta, default_delta);
   }
+
+  if (delta != prev_delta)
+    trace(TRACE_COPA_DELTA, cur_time, -1, _the_window, 1e3 / _intersend_time,
+          cur_rtt, {delta, prev_delta, double(pkt_lost),
+                    double(operation_mode == LOSS_SENSITIVE_MODE)});
 }
 
 double MarkovianCC::randomize_intersend(double intersend) {
@@ -202,6 +210,8 @@ void MarkovianCC::update_intersend_time() {
   _the_window = max(2.0, _the_window);
   cur_intersend_time = 0.5 * rtt / _the_window;
   _intersend_time = randomize_intersend(cur_intersend_time);
+  trace(TRACE_COPA_WINDOW, cur_time, -1, _the_window, 1e3 / _intersend_time,
+        rtt, {target_window, min_rtt, delta, update_amt, double(slow_start)});
 }
 
 void MarkovianCC::onACK(int ack, 
@@ -261,6 +271,9 @@ void MarkovianCC::onACK(int ack,
     cur_intersend_time = 0.5 * rtt_window.get_unjittered_rtt() / _the_window;
     _intersend_time = randomize_intersend(cur_intersend_time);
   }
+  if (pkt_lost)
+    trace(TRACE_COPA_LOSS, cur_time, seq_num, _the_window, 1e3 / _intersend_time,
+          rtt_window.get_latest_rtt(), {double(num_pkts_lost), double(reduce)});
 
   ++ num_pkts_acked;
 }
@@ -293,6 +306,17 @@ void MarkovianCC::onPktSent(int seq_num) {
   _intersend_time = randomize_intersend(cur_intersend_time);
 }
 
+int MarkovianCC::get_state(const char** names, double* values, int max) const {
+  const char* state_names[] = {"delta", "min_rtt", "slow_start",
+                               "max_queuing_delay_estimate"};
+  const double state[] = {delta, min_rtt, double(slow_start),
+                          max_queuing_delay_estimate};
+  int n = std::min(max, 4);
+  std::copy(state_names, state_names + n, names);
+  std::copy(state, state + n, values);
+  return n;
+}
+
 void MarkovianCC::close() {
 }
 
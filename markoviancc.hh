@@ -12,6 +12,7 @@
 #include "estimators.hh"
 #include "rtt-window.hh"
 
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <iostream>
@@ -101,7 +102,7 @@ class MarkovianCC : public CCC {
   double slow_start_threshold;
   
   // Find flow id
-  static int flow_id_counter;
+  static std::atomic<int> flow_id_counter;
   int flow_id;
   
   Time cur_tick;
@@ -175,6 +176,7 @@ public:
   virtual void onPktSent(int seq_num) override;
   void onTinyPktSent() {num_pkts_acked ++;}
   virtual void close() override;
+  virtual int get_state(const char** names, double* values, int max) const override;
   
   bool send_tiny_pkt() {return false;}//num_pkts_acked < num_probe_pkts-1;}
   
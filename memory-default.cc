@@ -6,7 +6,7 @@ static const double alpha = 1.0 / 8.0;
 
 static const double slow_alpha = 1.0 / 256.0;
 
-void Memory::packets_received( const vector< Packet > & packets, const unsigned int flow_id, const double link_rate_normalizing_factor )
+void MemoryDefault::packets_received( const vector< Packet > & packets, const unsigned int flow_id, const double link_rate_normalizing_factor )
 {
   for ( const auto &x : packets ) {
     if ( x.flow_id != flow_id ) {
@@ -61,20 +61,20 @@ void Memory::packets_received( const vector< Packet > & packets, const unsigned
     _loss_rate = (( 0.1 * _lost_packets.size() ) / _all_packets_in_rtt_window.size()) * 163840;*/
 }
 
-string Memory::str( void ) const
+string MemoryDefault::str( void ) const
 {
   char tmp[ 256 ];
   snprintf( tmp, 256, "sewma=%f, rewma=%f, rttr=%f, srewma=%f", _rec_send_ewma, _rec_rec_ewma, _rtt_ratio,  _slow_rec_rec_ewma);
   return tmp;
 }
 
-const Memory & MAX_MEMORY( void )
+const MemoryDefault & MemoryDefault::max_memory( void )
 {
-  static const Memory max_memory( { 163840, 163840, 163840, 163840 } );
+  static const MemoryDefault max_memory( { 163840, 163840, 163840, 163840 } );
   return max_memory;
 }
 
-RemyBuffers::Memory Memory::DNA( void ) const
+RemyBuffers::Memory MemoryDefault::DNA( void ) const
 {
   RemyBuffers::Memory ret;
   ret.set_rec_send_ewma( _rec_send_ewma );
@@ -89,7 +89,7 @@ RemyBuffers::Memory Memory::DNA( void ) const
 #define get_val_or_default( protobuf, field, limit ) \
   ( (protobuf).has_ ## field() ? (protobuf).field() : (limit) ? 0 : 163840 )
 
-Memory::Memory( const bool is_lower_limit, const RemyBuffers::Memory & dna )
+MemoryDefault::MemoryDefault( const bool is_lower_limit, const RemyBuffers::Memory & dna )
   : _rec_send_ewma( get_val_or_default( dna, rec_send_ewma, is_lower_limit ) ),
     _rec_rec_ewma( get_val_or_default( dna, rec_rec_ewma, is_lower_limit ) ),
     _rtt_ratio( get_val_or_default( dna, rtt_ratio, is_lower_limit ) ),
@@ -106,7 +106,7 @@ Memory::Memory( const bool is_lower_limit, const RemyBuffers::Memory & dna )
 {
 }
 
-size_t hash_value( const Memory & mem )
+size_t hash_value( const MemoryDefault & mem )
 {
   size_t seed = 0;
   boost::hash_combine( seed, mem._rec_send_ewma );
@@ -16,7 +16,7 @@
 #include "configs.hh"
 
 // Keeps track of the state variable for a particular sender.
-class Memory {
+class MemoryDefault {
 public:
   typedef double DataType;
 
@@ -39,7 +39,7 @@ private:
   int _largest_ack;
 
 public:
-  Memory( const std::vector< DataType > & s_data )
+  MemoryDefault( const std::vector< DataType > & s_data )
     : _rec_send_ewma( s_data.at( 0 ) ),
       _rec_rec_ewma( s_data.at( 1 ) ),
       _rtt_ratio( s_data.at( 2 ) ),
@@ -57,7 +57,7 @@ public:
       _largest_ack( 0 )
   {}
 
-  Memory()
+  MemoryDefault()
     : _rec_send_ewma( 0 ),
       _rec_rec_ewma( 0 ),
       _rtt_ratio( 0.0 ),
@@ -82,6 +82,10 @@ public:
   }
 
   static const unsigned int datasize = 4;
+  static const RemyBuffers::MemoryType type = RemyBuffers::MEMORY_DEFAULT;
+
+  // The upper bound of the domain of a whisker tree
+  static const MemoryDefault & max_memory( void );
 
   const DataType & field( unsigned int num ) const { return num == 0 ? _rec_send_ewma : num == 1 ? _rec_rec_ewma : num == 2 ? _rtt_ratio : _slow_rec_rec_ewma ; }
   DataType & mutable_field( unsigned int num )     { return num == 0 ? _rec_send_ewma : num == 1 ? _rec_rec_ewma : num == 2 ? _rtt_ratio : _slow_rec_rec_ewma ; }
@@ -95,18 +99,17 @@ public:
   std::string str( void ) const;
 
   // compares all tracked values. Does not compare loss rate yet, as it is not yet used
-  bool operator>=( const Memory & other ) const { return (_rec_send_ewma >= other._rec_send_ewma) && (_rec_rec_ewma >= other._rec_rec_ewma) && (_rtt_ratio >= other._rtt_ratio) && (_slow_rec_rec_ewma >= other._slow_rec_rec_ewma); }
+  bool operator>=( const MemoryDefault & other ) const { return (_rec_send_ewma >= other._rec_send_ewma) && (_rec_rec_ewma >= other._rec_rec_ewma) && (_rtt_ratio >= other._rtt_ratio) && (_slow_rec_rec_ewma >= other._slow_rec_rec_ewma); }
   // compares all tracked values
-  bool operator<( const Memory & other ) const { return (_rec_send_ewma < other._rec_send_ewma) && (_rec_rec_ewma < other._rec_rec_ewma) && (_rtt_ratio < other._rtt_ratio) && (_slow_rec_rec_ewma < other._slow_rec_rec_ewma); }
+  bool operator<( const MemoryDefault & other ) const { return (_rec_send_ewma < other._rec_send_ewma) && (_rec_rec_ewma < other._rec_rec_ewma) && (_rtt_ratio < other._rtt_ratio) && (_slow_rec_rec_ewma < other._slow_rec_rec_ewma); }
   // compares all tracked values
-  bool operator==( const Memory & other ) const { return (_rec_send_ewma == other._rec_send_ewma) && (_rec_rec_ewma == _rec_rec_ewma) && (_rtt_ratio == other._rtt_ratio) && (_slow_rec_rec_ewma == other._slow_rec_rec_ewma); }
+  bool operator==( const MemoryDefault & other ) const { return (_rec_send_ewma == other._rec_send_ewma) && (_rec_rec_ewma == _rec_rec_ewma) && (_rtt_ratio == other._rtt_ratio) && (_slow_rec_rec_ewma == other._slow_rec_rec_ewma); }
 
   RemyBuffers::Memory DNA( void ) const;
-  Memory( const bool is_lower_limit, const RemyBuffers::Memory & dna );
+  MemoryDefault( const bool is_lower_limit, const RemyBuffers::Memory & dna );
 
-  friend size_t hash_value( const Memory & mem );
+  friend size_t hash_value( const MemoryDefault & mem );
 };
 
-extern const Memory & MAX_MEMORY( void );
 
 #endif
\ No newline at end of file
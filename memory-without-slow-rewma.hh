@@ -10,7 +10,7 @@
 #include "dna.pb.h"
 
 // Keeps track of the state variable for a particular sender.
-class Memory {
+class MemoryWithoutSlowRewma {
 public:
   typedef double DataType;
 
@@ -29,7 +29,7 @@ private:
   unsigned long _num_packets_lost;
 
 public:
-  Memory( const std::vector< DataType > & s_data )
+  MemoryWithoutSlowRewma( const std::vector< DataType > & s_data )
     : _rec_send_ewma( s_data.at( 0 ) ),
       _rec_rec_ewma( s_data.at( 1 ) ),
       _rtt_ratio( s_data.at( 2 ) ),
@@ -43,7 +43,7 @@ public:
       _num_packets_lost( 0 )
   {}
 
-  Memory()
+  MemoryWithoutSlowRewma()
     : _rec_send_ewma( 0 ),
       _rec_rec_ewma( 0 ),
       _rtt_ratio( 0.0 ),
@@ -59,6 +59,10 @@ public:
   void reset( void ) { _rec_send_ewma = _rec_rec_ewma = _rtt_ratio = _slow_rec_rec_ewma = _last_tick_sent = _last_tick_received = _min_rtt = 0; }
 
   static const unsigned int datasize = 3;
+  static const RemyBuffers::MemoryType type = RemyBuffers::MEMORY_WITHOUT_SLOW_REWMA;
+
+  // The upper bound of the domain of a whisker tree
+  static const MemoryWithoutSlowRewma & max_memory( void );
 
   const DataType & field( unsigned int num ) const { assert(num <= 2); return num == 0 ? _rec_send_ewma : num == 1 ? _rec_rec_ewma : _rtt_ratio ; }
   DataType & mutable_field( unsigned int num )     { assert(num <= 2); return num == 0 ? _rec_send_ewma : num == 1 ? _rec_rec_ewma : _rtt_ratio ; }
@@ -72,18 +76,17 @@ public:
   std::string str( void ) const;
 
   // compares all tracked values. Does not compare loss rate yet, as it is not yet used
-  bool operator>=( const Memory & other ) const { return (_rec_send_ewma >= other._rec_send_ewma) && (_rec_rec_ewma >= other._rec_rec_ewma) && (_rtt_ratio >= other._rtt_ratio); }
+  bool operator>=( const MemoryWithoutSlowRewma & other ) const { return (_rec_send_ewma >= other._rec_send_ewma) && (_rec_rec_ewma >= other._rec_rec_ewma) && (_rtt_ratio >= other._rtt_ratio); }
   // compares all tracked values
-  bool operator<( const Memory & other ) const { return (_rec_send_ewma < other._rec_send_ewma) && (_rec_rec_ewma < other._rec_rec_ewma) && (_rtt_ratio < other._rtt_ratio); }
+  bool operator<( const MemoryWithoutSlowRewma & other ) const { return (_rec_send_ewma < other._rec_send_ewma) && (_rec_rec_ewma < other._rec_rec_ewma) && (_rtt_ratio < other._rtt_ratio); }
   // compares all tracked values
-  bool operator==( const Memory & other ) const { return (_rec_send_ewma == other._rec_send_ewma) && (_rec_rec_ewma == _rec_rec_ewma) && (_rtt_ratio == other._rtt_ratio); }
+  bool operator==( const MemoryWithoutSlowRewma & other ) const { return (_rec_send_ewma == other._rec_send_ewma) && (_rec_rec_ewma == _rec_rec_ewma) && (_rtt_ratio == other._rtt_ratio); }
 
   RemyBuffers::Memory DNA( void ) const;
-  Memory( const bool is_lower_limit, const RemyBuffers::Memory & dna );
+  MemoryWithoutSlowRewma( const bool is_lower_limit, const RemyBuffers::Memory & dna );
 
-  friend size_t hash_value( const Memory & mem );
+  friend size_t hash_value( const MemoryWithoutSlowRewma & mem );
 };
 
-extern const Memory & MAX_MEMORY( void );
 
 #endif
\ No newline at end of file
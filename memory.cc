@@ -1,43 +1,45 @@
-#ifndef MEMORY_CC
-#define MEMORY_CC
-
-#include "configs.hh"
-
-#ifdef REMYTYPE_DEFAULT
-#define REMYTYPE_DEFINED
-#include "memory-default.cc"
-#endif
-
-
-
-#ifdef REMYTYPE_LOSS_SIGNAL
-
-#ifdef REMYTYPE_DEFINED
-#error Only one remy type should be defined 
-#endif
-
-#define REMYTYPE_DEFINED
-#include "memory-with-loss-signal.cc"
-
-#endif /* REMYTYPE_LOSS_SIGNAL */
-
-
-
-#ifdef REMYTYPE_WITHOUT_SLOW_REWMA
-
-#ifdef REMYTYPE_DEFINED
-#error Only one remy type should be defined 
-#endif
-
-#define REMYTYPE_DEFINED
-#include "memory-without-slow-rewma.cc"
-
-#endif /* REMYTYPE_WITHOUT_SLOW_REWMA */
-
-
-
-#ifndef REMYTYPE_DEFINED
-#error Please define a remy type
-#endif
-
-#endif /* MEMORY_CC*/
\ No newline at end of file
+#include "memory.hh"
+
+using namespace std;
+
+RemyBuffers::MemoryType dna_memory_type( const RemyBuffers::WhiskerTree & dna )
+{
+  if ( dna.has_memory_type() ) {
+    return dna.memory_type();
+  }
+
+  const RemyBuffers::Memory & lower = dna.domain().lower();
+  if ( lower.has_loss_rate() ) {
+    return RemyBuffers::MEMORY_WITH_LOSS_SIGNAL;
+  }
+  if ( lower.has_rtt_ratio() && !lower.has_slow_rec_rec_ewma() ) {
+    return RemyBuffers::MEMORY_WITHOUT_SLOW_REWMA;
+  }
+  return RemyBuffers::MEMORY_DEFAULT;
+}
+
+bool parse_memory_type( const string & name, RemyBuffers::MemoryType & type )
+{
+  if ( name == "default" ) {
+    type = RemyBuffers::MEMORY_DEFAULT;
+  } else if ( name == "loss_signal" ) {
+    type = RemyBuffers::MEMORY_WITH_LOSS_SIGNAL;
+  } else if ( name == "without_slow_rewma" ) {
+    type = RemyBuffers::MEMORY_WITHOUT_SLOW_REWMA;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char * memory_type_name( const RemyBuffers::MemoryType type )
+{
+  switch ( type ) {
+  case RemyBuffers::MEMORY_WITH_LOSS_SIGNAL:
+    return "loss_signal";
+  case RemyBuffers::MEMORY_WITHOUT_SLOW_REWMA:
+    return "without_slow_rewma";
+  default:
+    return "default";
+  }
+}
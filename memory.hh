@@ -1,11 +1,24 @@
 #ifndef MEMORY_HH
 #define MEMORY_HH
 
+#include <string>
+
 #include "configs.hh"
+#include "dna.pb.h"
+
+// The congestion signals a RemyCC sees. Every variant is compiled in and
+// MemoryRange, Whisker, WhiskerTree, Rat and RemyCC are templates on it
+// (BasicWhiskerTree< MemoryWithLossSignal > etc.), so one binary runs
+// trees of any type without dispatching per ACK; see dna_memory_type.
+// The REMYTYPE_* option in configs.hh picks the one called 'Memory', used
+// by the tools that handle a single type.
+#include "memory-default.hh"
+#include "memory-with-loss-signal.hh"
+#include "memory-without-slow-rewma.hh"
 
 #ifdef REMYTYPE_DEFAULT
 #define REMYTYPE_DEFINED
-#include "memory-default.hh"
+typedef MemoryDefault Memory;
 #endif
 
 
@@ -17,7 +30,7 @@
 #endif
 
 #define REMYTYPE_DEFINED
-#include "memory-with-loss-signal.hh"
+typedef MemoryWithLossSignal Memory;
 
 #endif /* REMYTYPE_LOSS_SIGNAL */
 
@@ -30,7 +43,7 @@
 #endif
 
 #define REMYTYPE_DEFINED
-#include "memory-without-slow-rewma.hh"
+typedef MemoryWithoutSlowRewma Memory;
 
 #endif /* REMYTYPE_WITHOUT_SLOW_REWMA */
 
@@ -38,4 +51,14 @@
 #error Please define a remy type
 #endif
 
-#endif /* MEMORY_HH */
\ No newline at end of file
+// The memory type of a tree: its 'memory_type' if set, else guessed from
+// the signals its root domain constrains (trees from before the field
+// always write every signal of their type)
+RemyBuffers::MemoryType dna_memory_type( const RemyBuffers::WhiskerTree & dna );
+
+// 'default', 'loss_signal' or 'without_slow_rewma'. Returns false for
+// anything else.
+bool parse_memory_type( const std::string & name, RemyBuffers::MemoryType & type );
+const char * memory_type_name( const RemyBuffers::MemoryType type );
+
+#endif /* MEMORY_HH */
@@ -5,13 +5,14 @@
 using namespace std;
 using namespace boost::accumulators;
 
-std::vector< MemoryRange > MemoryRange::bisect( void ) const
+template < typename MemoryType >
+std::vector< BasicMemoryRange< MemoryType > > BasicMemoryRange< MemoryType >::bisect( void ) const
 {
-  vector< MemoryRange > ret { *this };
+  vector< BasicMemoryRange > ret { *this };
 
   /* bisect in each axis */
-  for ( unsigned int i = 0; i < Memory::datasize; i++ ) {
-    vector< MemoryRange > doubled;
+  for ( unsigned int i = 0; i < MemoryType::datasize; i++ ) {
+    vector< BasicMemoryRange > doubled;
     for ( const auto &x : ret ) {
       auto ersatz_lower( x._lower ), ersatz_upper( x._upper );
       ersatz_lower.mutable_field( i ) = ersatz_upper.mutable_field( i ) = median( _acc[ i ] );
@@ -40,34 +41,39 @@ std::vector< MemoryRange > MemoryRange::bisect( void ) const
   return ret;
 }
 
-Memory MemoryRange::range_median( void ) const
+template < typename MemoryType >
+MemoryType BasicMemoryRange< MemoryType >::range_median( void ) const
 {
-  Memory median_data( _lower );
-  for ( unsigned int i = 0; i < Memory::datasize; i++ ) {
+  MemoryType median_data( _lower );
+  for ( unsigned int i = 0; i < MemoryType::datasize; i++ ) {
     median_data.mutable_field( i ) = (_lower.field( i ) + _upper.field( i )) / 2;
   }
   return median_data;
 }
 
-bool MemoryRange::contains( const Memory & query ) const
+template < typename MemoryType >
+bool BasicMemoryRange< MemoryType >::contains( const MemoryType & query ) const
 {
   return (query >= _lower) && (query < _upper);
 }
 
-void MemoryRange::track( const Memory & query ) const
+template < typename MemoryType >
+void BasicMemoryRange< MemoryType >::track( const MemoryType & query ) const
 {
   /* log it */
-  for ( unsigned int i = 0; i < Memory::datasize; i++ ) {
+  for ( unsigned int i = 0; i < MemoryType::datasize; i++ ) {
     _acc[ i ]( query.field( i ) );
   }
 }
 
-bool MemoryRange::operator==( const MemoryRange & other ) const
+template < typename MemoryType >
+bool BasicMemoryRange< MemoryType >::operator==( const BasicMemoryRange & other ) const
 {
   return (_lower == other._lower) && (_upper == other._upper); /* ignore median estimator for now */
 }
 
-string MemoryRange::str( void ) const
+template < typename MemoryType >
+string BasicMemoryRange< MemoryType >::str( void ) const
 {
   char tmp[ 256 ];
   snprintf( tmp, 256, "(lo=<%s>, hi=<%s>)",
@@ -76,7 +82,8 @@ string MemoryRange::str( void ) const
   return tmp;
 }
 
-RemyBuffers::MemoryRange MemoryRange::DNA( void ) const
+template < typename MemoryType >
+RemyBuffers::MemoryRange BasicMemoryRange< MemoryType >::DNA( void ) const
 {
   RemyBuffers::MemoryRange ret;
 
@@ -86,18 +93,24 @@ RemyBuffers::MemoryRange MemoryRange::DNA( void ) const
   return ret;
 }
 
-MemoryRange::MemoryRange( const RemyBuffers::MemoryRange & dna )
+template < typename MemoryType >
+BasicMemoryRange< MemoryType >::BasicMemoryRange( const RemyBuffers::MemoryRange & dna )
   : _lower( true, dna.lower() ),
     _upper( false, dna.upper() ),
-    _acc( Memory::datasize ),
+    _acc( MemoryType::datasize ),
     _count( 0 )
 {}
 
-size_t hash_value( const MemoryRange & mr )
+template < typename MemoryType >
+size_t BasicMemoryRange< MemoryType >::hash( void ) const
 {
   size_t seed = 0;
-  boost::hash_combine( seed, mr._lower );
-  boost::hash_combine( seed, mr._upper );
+  boost::hash_combine( seed, _lower );
+  boost::hash_combine( seed, _upper );
 
   return seed;
 }
+
+template class BasicMemoryRange< MemoryDefault >;
+template class BasicMemoryRange< MemoryWithLossSignal >;
+template class BasicMemoryRange< MemoryWithoutSlowRewma >;
@@ -10,39 +10,43 @@
 #include "memory.hh"
 #include "dna.pb.h"
 
-class MemoryRange {
+template < typename MemoryType >
+class BasicMemoryRange {
 private:
-  Memory _lower, _upper;  
+  MemoryType _lower, _upper;  
 
-  mutable std::vector< boost::accumulators::accumulator_set< Memory::DataType,
+  mutable std::vector< boost::accumulators::accumulator_set< typename MemoryType::DataType,
 							     boost::accumulators::stats<
 							       boost::accumulators::tag::median > > > _acc;
   mutable unsigned int _count;
 
 public:
-  MemoryRange( const Memory & s_lower, const Memory & s_upper )
-    : _lower( s_lower ), _upper( s_upper ), _acc( Memory::datasize ), _count( 0 )
+  BasicMemoryRange( const MemoryType & s_lower, const MemoryType & s_upper )
+    : _lower( s_lower ), _upper( s_upper ), _acc( MemoryType::datasize ), _count( 0 )
   {}
 
-  std::vector< MemoryRange > bisect( void ) const;
-  Memory range_median( void ) const;
+  std::vector< BasicMemoryRange > bisect( void ) const;
+  MemoryType range_median( void ) const;
 
-  bool contains( const Memory & query ) const;
+  bool contains( const MemoryType & query ) const;
 
   void use( void ) const { _count++; }
   unsigned int count( void ) const { return _count; }
   void reset_count( void ) const { _count = 0; }
 
-  void track( const Memory & query ) const;
+  void track( const MemoryType & query ) const;
 
-  bool operator==( const MemoryRange & other ) const;
+  bool operator==( const BasicMemoryRange & other ) const;
 
   std::string str( void ) const;
 
   RemyBuffers::MemoryRange DNA( void ) const;
-  MemoryRange( const RemyBuffers::MemoryRange & dna );
+  BasicMemoryRange( const RemyBuffers::MemoryRange & dna );
 
-  friend size_t hash_value( const MemoryRange & mr );
+  size_t hash( void ) const;
+  friend size_t hash_value( const BasicMemoryRange & mr ) { return mr.hash(); }
 };
 
+typedef BasicMemoryRange< Memory > MemoryRange;
+
 #endif
@@ -0,0 +1,376 @@
+// Per-flow throughput, RTT, loss and fairness of a packet capture, in one
+// pass over it, for genericCC's UDP flows (identified by the TCPHeader
+// that starts every packet) and for kernel TCP flows. Replaces tcptrace
+// and analyze_pcap.py for long captures.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "fairness.hh"
+#include "latency-histogram.hh"
+#include "pcap.hh"
+#include "tcp-header.hh"
+#include "thread-pool.hh"
+
+using namespace std;
+
+// A packet of a flow, as much as the analysis needs
+struct FlowPacket {
+  double time;
+  // genericCC: the sequence number (in both directions). TCP: seq and
+  // ack.
+  uint32_t seq;
+  uint32_t ack;
+  // On the wire
+  uint32_t length;
+  uint32_t payload_length;
+  // genericCC: 0 for data, 1 for ACKs. TCP: 0 from the first endpoint
+  // of the flow to the second, 1 back.
+  uint8_t direction;
+  uint8_t tcp_flags;
+};
+
+struct Flow {
+  bool genericcc;
+  // The endpoints; for genericCC, the sender is first
+  string endpoints[2];
+  vector<FlowPacket> packets;
+
+  // Results
+  string name;
+  double start, end;
+  uint64_t data_packets, data_bytes;
+  // genericCC: data never acknowledged. TCP: retransmitted segments.
+  uint64_t lost;
+  LatencyHistogram rtt;
+  // Data bytes per interval since the start of the capture
+  vector<uint64_t> series;
+
+  explicit Flow(bool genericcc)
+    : genericcc(genericcc), endpoints(), packets(), name(), start(0),
+      end(0), data_packets(0), data_bytes(0), lost(0), rtt(), series() {}
+};
+
+// Seconds a flow's data took, at least one interval
+static double flow_duration(const Flow& flow, double interval) {
+  return max(flow.end - flow.start, interval);
+}
+
+// Data from genericCC's sender; ACKs are of the sequence numbers of the
+// packets they acknowledge
+static void analyze_genericcc(Flow& flow, double capture_start,
+                              double interval) {
+  unordered_map<uint32_t, double> sent_time;
+  bool started = false;
+  double last_ack = -1, max_rtt = 0;
+  uint32_t min_seq = UINT32_MAX, max_seq = 0;
+  for (const auto& p : flow.packets) {
+    if (p.direction == 0) {
+      if (!started) {
+        flow.start = p.time;
+        started = true;
+      }
+      flow.end = p.time;
+      flow.data_packets++;
+      flow.data_bytes += p.length;
+      size_t bin = (p.time - capture_start) / interval;
+      if (flow.series.size() <= bin)
+        flow.series.resize(bin + 1, 0);
+      flow.series[bin] += p.length;
+      min_seq = min(min_seq, p.seq);
+      max_seq = max(max_seq, p.seq);
+      // Not measured on packets sent twice, as for TCP
+      auto it = sent_time.find(p.seq);
+      if (it == sent_time.end())
+        sent_time[p.seq] = p.time;
+      else
+        it->second = -1;
+    }
+    else {
+      last_ack = p.time;
+      auto it = sent_time.find(p.seq);
+      if (it != sent_time.end() && it->second >= 0) {
+        double rtt = p.time - it->second;
+        flow.rtt.record(rtt * 1e3);
+        max_rtt = max(max_rtt, rtt);
+        // Acknowledged
+        sent_time.erase(it);
+      }
+    }
+  }
+
+  if (last_ack >= 0) {
+    // Packets whose ACK could still have been on its way at the end of
+    // the capture are not lost
+    for (const auto& s : sent_time)
+      if (s.second >= 0 && s.second < last_ack - max_rtt)
+        flow.lost++;
+  }
+  else if (flow.data_packets > 0) {
+    // Captured at the receiver without the ACKs: the sequence numbers
+    // never seen
+    uint64_t distinct = sent_time.size();
+    flow.lost = uint64_t(max_seq - min_seq) + 1 - distinct;
+  }
+}
+
+// Data is in the direction with more payload; RTTs are measured from a
+// segment to the ACK of exactly its end, except for retransmitted ones
+// (Karn's algorithm)
+static void analyze_tcp(Flow& flow, double capture_start, double interval) {
+  uint64_t payload[2] = {0, 0};
+  for (const auto& p : flow.packets)
+    payload[p.direction] += p.payload_length;
+  uint8_t data_direction = payload[1] > payload[0];
+  if (data_direction == 1)
+    swap(flow.endpoints[0], flow.endpoints[1]);
+
+  unordered_map<uint32_t, double> sent_time;
+  bool started = false;
+  uint32_t highest_end = 0;
+  for (const auto& p : flow.packets) {
+    if (p.direction == data_direction) {
+      if (p.payload_length == 0)
+        continue;
+      if (!started) {
+        flow.start = p.time;
+        highest_end = p.seq;
+        started = true;
+      }
+      flow.end = p.time;
+      flow.data_packets++;
+      flow.data_bytes += p.length;
+      size_t bin = (p.time - capture_start) / interval;
+      if (flow.series.size() <= bin)
+        flow.series.resize(bin + 1, 0);
+      flow.series[bin] += p.length;
+
+      uint32_t seq_end = p.seq + p.payload_length;
+      // Sequence numbers wrap around
+      if (int32_t(seq_end - highest_end) <= 0) {
+        flow.lost++;
+        auto it = sent_time.find(seq_end);
+        if (it != sent_time.end())
+          it->second = -1;
+      }
+      else {
+        highest_end = seq_end;
+        sent_time[seq_end] = p.time;
+      }
+    }
+    else if (p.tcp_flags & 0x10) {
+      auto it = sent_time.find(p.ack);
+      if (it != sent_time.end()) {
+        if (it->second >= 0)
+          flow.rtt.record((p.time - it->second) * 1e3);
+        sent_time.erase(it);
+      }
+    }
+  }
+}
+
+static string endpoint(const DecodedPacket& d, bool src) {
+  string address = src ? d.src_address() : d.dst_address();
+  if (d.ip_version == 6)
+    address = "[" + address + "]";
+  return address + ":" + to_string(src ? d.src_port : d.dst_port);
+}
+
+int main(int argc, char* argv[]) {
+  vector<string> files;
+  int port = 8888;
+  double interval = 0.1;
+  string series_file;
+  int num_threads = 0;
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+    if (arg.substr(0, 5) == "file=")
+      files.push_back(arg.substr(5));
+    else if (arg.substr(0, 5) == "port=")
+      port = atoi(arg.substr(5).c_str());
+    else if (arg.substr(0, 9) == "interval=")
+      interval = atof(arg.substr(9).c_str()) / 1e3;
+    else if (arg.substr(0, 7) == "series=")
+      series_file = arg.substr(7);
+    else if (arg.substr(0, 8) == "threads=")
+      num_threads = atoi(arg.substr(8).c_str());
+    else {
+      fprintf(stderr, "Unrecognised option '%s'.\n", arg.c_str());
+      files.clear();
+      break;
+    }
+  }
+  if (files.empty() || interval <= 0) {
+    fprintf(stderr, "Usage: pcap-analyze file=(pcap or pcapng, repeatable) [port=(of the genericCC receiver, default 8888)] [interval=(ms per point of the throughput series, default 100)] [series=(file for the throughput series)] [threads=(0 for one per core)]\n");
+    exit(1);
+  }
+
+  FILE* series = nullptr;
+  if (series_file != "") {
+    series = fopen(series_file.c_str(), "w");
+    if (series == nullptr) {
+      perror(series_file.c_str());
+      exit(1);
+    }
+    fprintf(series, "file\tflow\ttime\tthroughput\n");
+  }
+  ThreadPool pool(num_threads);
+
+  for (const auto& filename : files) {
+    auto read_start = chrono::steady_clock::now();
+    unique_ptr<PcapReader> reader(PcapReader::open(filename));
+    if (reader == nullptr)
+      exit(1);
+
+    // Split the packets by flow, in one pass
+    vector<unique_ptr<Flow>> flows;
+    unordered_map<string, size_t> flow_of;
+    uint64_t num_packets = 0, num_flow_packets = 0;
+    double capture_start = -1, capture_end = 0;
+    CapturedPacket packet;
+    DecodedPacket d;
+    string key;
+    while (reader->next(packet)) {
+      num_packets++;
+      if (capture_start < 0)
+        capture_start = packet.time;
+      capture_end = packet.time;
+      if (!decode_packet(packet, d))
+        continue;
+
+      FlowPacket p = {packet.time, 0, 0, packet.length, d.payload_length, 0,
+                      d.tcp_flags};
+      bool genericcc = d.protocol == IPPROTO_UDP &&
+        (d.src_port == port || d.dst_port == port) &&
+        d.captured_payload >= sizeof(TCPHeader);
+      bool first_endpoint = true;
+      if (genericcc) {
+        TCPHeader header;
+        memcpy(&header, d.payload, sizeof(header));
+        // The handshake
+        if (header.seq_num < 0)
+          continue;
+        p.seq = header.seq_num;
+        p.direction = (d.src_port == port);
+        key.assign("u");
+        key.append(reinterpret_cast<const char*>(&header.src_id),
+                   sizeof(header.src_id));
+        key.append(reinterpret_cast<const char*>(&header.flow_id),
+                   sizeof(header.flow_id));
+      }
+      else if (d.protocol == IPPROTO_TCP) {
+        p.seq = d.seq;
+        p.ack = d.ack;
+        // The endpoint that sorts first is the first of the flow
+        size_t n = d.ip_version == 4 ? 4 : 16;
+        int c = memcmp(d.src, d.dst, n);
+        first_endpoint = c < 0 || (c == 0 && d.src_port <= d.dst_port);
+        const uint8_t* a = first_endpoint ? d.src : d.dst;
+        const uint8_t* b = first_endpoint ? d.dst : d.src;
+        uint16_t ports[2] = {first_endpoint ? d.src_port : d.dst_port,
+                             first_endpoint ? d.dst_port : d.src_port};
+        p.direction = !first_endpoint;
+        key.assign("t");
+        key.append(reinterpret_cast<const char*>(a), n);
+        key.append(reinterpret_cast<const char*>(b), n);
+        key.append(reinterpret_cast<const char*>(ports), sizeof(ports));
+      }
+      else
+        continue;
+
+      auto it = flow_of.find(key);
+      if (it == flow_of.end()) {
+        it = flow_of.insert(make_pair(key, flows.size())).first;
+        flows.emplace_back(new Flow(genericcc));
+        Flow& flow = *flows.back();
+        // Named sender first
+        bool src_first = genericcc ? (p.direction == 0) : first_endpoint;
+        flow.endpoints[0] = endpoint(d, src_first);
+        flow.endpoints[1] = endpoint(d, !src_first);
+        if (genericcc) {
+          TCPHeader header;
+          memcpy(&header, d.payload, sizeof(header));
+          flow.name = to_string(header.src_id) + "/" +
+            to_string(header.flow_id) + " ";
+        }
+      }
+      flows[it->second]->packets.push_back(p);
+      num_flow_packets++;
+    }
+    double read_time = chrono::duration<double>(chrono::steady_clock::now() -
+                                                read_start).count();
+
+    // Analyse the flows in parallel, the largest first so that a large
+    // one does not start last
+    vector<size_t> order(flows.size());
+    for (size_t i = 0; i < order.size(); i++)
+      order[i] = i;
+    sort(order.begin(), order.end(), [&flows](size_t a, size_t b) {
+      return flows[a]->packets.size() > flows[b]->packets.size();
+    });
+    pool.run(order.size(), [&](size_t i) {
+      Flow& flow = *flows[order[i]];
+      if (flow.genericcc)
+        analyze_genericcc(flow, capture_start, interval);
+      else
+        analyze_tcp(flow, capture_start, interval);
+      flow.name += flow.endpoints[0] + "-" + flow.endpoints[1];
+      // The packets are not needed any more
+      vector<FlowPacket>().swap(flow.packets);
+    });
+    double analysis_time = chrono::duration<double>(
+      chrono::steady_clock::now() - read_start).count() - read_time;
+
+    printf("# %s: %llu packets, %llu of %zu flows, over %.3f s; read in %.3f s, analysed in %.3f s\n",
+           filename.c_str(), (unsigned long long) num_packets,
+           (unsigned long long) num_flow_packets, flows.size(),
+           capture_end - capture_start, read_time, analysis_time);
+    printf("flow\ttype\tstart\tduration\tpackets\tbytes\tthroughput\tlost\tloss_rate\trtt_mean\trtt_p50\trtt_p95\trtt_p99\n");
+    JainIndex fairness;
+    int num_active = 0;
+    double total_throughput = 0;
+    for (const auto& f : flows) {
+      const Flow& flow = *f;
+      if (flow.data_packets == 0)
+        continue;
+      double duration = flow_duration(flow, interval);
+      // Mbit/s
+      double throughput = 8e-6 * flow.data_bytes / duration;
+      fairness.update(0, throughput);
+      num_active++;
+      total_throughput += throughput;
+      printf("%s\t%s\t%.6f\t%.6f\t%llu\t%llu\t%.4f\t%llu\t%.6f\t%.3f\t%.3f\t%.3f\t%.3f\n",
+             flow.name.c_str(), flow.genericcc ? "genericcc" : "tcp",
+             flow.start - capture_start, flow.end - flow.start,
+             (unsigned long long) flow.data_packets,
+             (unsigned long long) flow.data_bytes, throughput,
+             (unsigned long long) flow.lost,
+             double(flow.lost) / flow.data_packets,
+             flow.rtt.mean(), flow.rtt.percentile(50),
+             flow.rtt.percentile(95), flow.rtt.percentile(99));
+      if (series != nullptr) {
+        size_t first = (flow.start - capture_start) / interval;
+        for (size_t bin = first; bin < flow.series.size(); bin++)
+          fprintf(series, "%s\t%s\t%.6f\t%.4f\n", filename.c_str(),
+                  flow.name.c_str(), bin * interval,
+                  8e-6 * flow.series[bin] / interval);
+      }
+    }
+    printf("# %d flows, total throughput %.4f Mbit/s, Jain's fairness index %.4f\n",
+           num_active, total_throughput, fairness.get(num_active));
+  }
+
+  if (series != nullptr && fclose(series) != 0) {
+    perror(series_file.c_str());
+    exit(1);
+  }
+  return 0;
+}
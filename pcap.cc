@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pcap.hh"
+
+static const uint32_t pcap_magic = 0xa1b2c3d4;
+static const uint32_t pcap_magic_ns = 0xa1b23c4d;
+static const uint32_t pcapng_section = 0x0a0d0d0a;
+static const uint32_t pcapng_byte_order = 0x1a2b3c4d;
+
+// pcapng block types
+static const uint32_t interface_block = 1;
+static const uint32_t obsolete_packet_block = 2;
+static const uint32_t enhanced_packet_block = 6;
+
+// Link types
+static const int linktype_null = 0;
+static const int linktype_ethernet = 1;
+static const int linktype_raw = 101;
+static const int linktype_linux_sll = 113;
+static const int linktype_ipv4 = 228;
+static const int linktype_ipv6 = 229;
+static const int linktype_linux_sll2 = 276;
+
+static uint32_t bswap(uint32_t x) { return __builtin_bswap32(x); }
+
+PcapReader::PcapReader()
+  : filename(), image(nullptr), size(0), pos(0), pcapng(false),
+    swapped(false), linktype(0), resolution(1e-6), interfaces()
+{}
+
+PcapReader::~PcapReader() {
+  if (image != nullptr)
+    munmap(const_cast<uint8_t*>(image), size);
+}
+
+uint16_t PcapReader::read16(const uint8_t* p) const {
+  uint16_t x;
+  memcpy(&x, p, sizeof(x));
+  return swapped ? __builtin_bswap16(x) : x;
+}
+
+uint32_t PcapReader::read32(const uint8_t* p) const {
+  uint32_t x;
+  memcpy(&x, p, sizeof(x));
+  return swapped ? bswap(x) : x;
+}
+
+PcapReader* PcapReader::open(const std::string& filename) {
+  std::unique_ptr<PcapReader> reader(new PcapReader());
+  reader->filename = filename;
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    perror(filename.c_str());
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror("fstat");
+    close(fd);
+    return nullptr;
+  }
+  reader->size = st.st_size;
+  if (reader->size < 24) {
+    fprintf(stderr, "%s is not a capture.\n", filename.c_str());
+    close(fd);
+    return nullptr;
+  }
+  void* image = mmap(nullptr, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) {
+    perror("mmap");
+    return nullptr;
+  }
+  madvise(image, reader->size, MADV_SEQUENTIAL);
+  reader->image = static_cast<const uint8_t*>(image);
+
+  uint32_t magic;
+  memcpy(&magic, reader->image, sizeof(magic));
+  if (magic == pcapng_section) {
+    // Each section says its byte order; the first one is read by next()
+    reader->pcapng = true;
+    return reader.release();
+  }
+  if (magic == pcap_magic || magic == pcap_magic_ns)
+    reader->swapped = false;
+  else if (bswap(magic) == pcap_magic || bswap(magic) == pcap_magic_ns)
+    reader->swapped = true;
+  else {
+    fprintf(stderr, "%s is not a capture.\n", filename.c_str());
+    return nullptr;
+  }
+  uint32_t m = reader->swapped ? bswap(magic) : magic;
+  reader->resolution = (m == pcap_magic_ns) ? 1e-9 : 1e-6;
+  // The upper bits may hold FCS information
+  reader->linktype = reader->read32(reader->image + 20) & 0x0fffffff;
+  reader->pos = 24;
+  return reader.release();
+}
+
+bool PcapReader::truncated() {
+  fprintf(stderr, "%s is truncated after %zu bytes.\n", filename.c_str(),
+          pos);
+  pos = size;
+  return false;
+}
+
+bool PcapReader::next(CapturedPacket& packet) {
+  return pcapng ? next_pcapng(packet) : next_pcap(packet);
+}
+
+bool PcapReader::next_pcap(CapturedPacket& packet) {
+  if (pos == size)
+    return false;
+  if (size - pos < 16)
+    return truncated();
+  const uint8_t* header = image + pos;
+  uint32_t captured = read32(header + 8);
+  if (size - pos - 16 < captured)
+    return truncated();
+  packet.time = read32(header) + read32(header + 4) * resolution;
+  packet.data = header + 16;
+  packet.captured_length = captured;
+  packet.length = read32(header + 12);
+  packet.linktype = linktype;
+  pos += 16 + captured;
+  return true;
+}
+
+void PcapReader::read_interface(const uint8_t* body, size_t length) {
+  int type = read16(body);
+  double res = 1e-6;
+  // Options follow the link type, reserved field and snap length
+  size_t i = 8;
+  while (i + 4 <= length) {
+    uint16_t code = read16(body + i);
+    uint16_t len = read16(body + i + 2);
+    if (code == 0 || i + 4 + len > length)
+      break;
+    // if_tsresol: a power of 10, or of 2 if the top bit is set
+    if (code == 9 && len >= 1) {
+      uint8_t v = body[i + 4];
+      res = (v & 0x80) ? std::ldexp(1.0, -(v & 0x7f)) : std::pow(10.0, -v);
+    }
+    i += 4 + ((len + 3) & ~3);
+  }
+  interfaces.push_back(Interface(type, res));
+}
+
+bool PcapReader::next_pcapng(CapturedPacket& packet) {
+  while (pos < size) {
+    if (size - pos < 12)
+      return truncated();
+    const uint8_t* block = image + pos;
+    uint32_t type;
+    memcpy(&type, block, sizeof(type));
+    if (type == pcapng_section) {
+      uint32_t order;
+      memcpy(&order, block + 8, sizeof(order));
+      if (order == pcapng_byte_order)
+        swapped = false;
+      else if (bswap(order) == pcapng_byte_order)
+        swapped = true;
+      else {
+        fprintf(stderr, "%s has a section of unknown byte order.\n",
+                filename.c_str());
+        pos = size;
+        return false;
+      }
+      interfaces.clear();
+    }
+    else
+      type = read32(block);
+    uint32_t length = read32(block + 4);
+    if (length < 12 || length % 4 != 0 || length > size - pos)
+      return truncated();
+    const uint8_t* body = block + 8;
+    size_t body_length = length - 12;
+    pos += length;
+
+    if (type == interface_block && body_length >= 8) {
+      read_interface(body, body_length);
+      continue;
+    }
+
+    // The packet blocks with timestamps; simple packet blocks have none
+    uint32_t interface, captured, wire;
+    const uint8_t* data;
+    if (type == enhanced_packet_block && body_length >= 20) {
+      interface = read32(body);
+      captured = read32(body + 12);
+      wire = read32(body + 16);
+      data = body + 20;
+    }
+    else if (type == obsolete_packet_block && body_length >= 20) {
+      interface = read16(body);
+      captured = read32(body + 12);
+      wire = read32(body + 16);
+      data = body + 20;
+    }
+    else
+      continue;
+    if (interface >= interfaces.size() || captured > body_length - 20)
+      continue;
+
+    uint64_t ts = (uint64_t(read32(body + 4)) << 32) | read32(body + 8);
+    const Interface& i = interfaces[interface];
+    packet.time = ts * i.resolution;
+    packet.data = data;
+    packet.captured_length = captured;
+    packet.length = wire;
+    packet.linktype = i.linktype;
+    return true;
+  }
+  return false;
+}
+
+DecodedPacket::DecodedPacket()
+  : ip_version(0), protocol(0), src(), dst(), src_port(0), dst_port(0),
+    seq(0), ack(0), tcp_flags(0), payload(nullptr), payload_length(0),
+    captured_payload(0)
+{}
+
+static std::string address(int ip_version, const uint8_t* a) {
+  char buf[INET6_ADDRSTRLEN];
+  inet_ntop(ip_version == 4 ? AF_INET : AF_INET6, a, buf, sizeof(buf));
+  return buf;
+}
+
+std::string DecodedPacket::src_address() const {
+  return address(ip_version, src);
+}
+
+std::string DecodedPacket::dst_address() const {
+  return address(ip_version, dst);
+}
+
+// Bytes captured from p on
+static size_t left(const uint8_t* p, const uint8_t* end) { return end - p; }
+
+static uint16_t be16(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+static uint32_t be32(const uint8_t* p) {
+  return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+bool decode_packet(const CapturedPacket& packet, DecodedPacket& decoded) {
+  const uint8_t* p = packet.data;
+  const uint8_t* end = p + packet.captured_length;
+
+  // Find the IP header
+  int ethertype = -1;
+  switch (packet.linktype) {
+  case linktype_ethernet:
+    if (left(p, end) < 14)
+      return false;
+    ethertype = be16(p + 12);
+    p += 14;
+    // VLAN tags
+    while ((ethertype == 0x8100 || ethertype == 0x88a8) && left(p, end) >= 4) {
+      ethertype = be16(p + 2);
+      p += 4;
+    }
+    break;
+  case linktype_linux_sll:
+    if (left(p, end) < 16)
+      return false;
+    ethertype = be16(p + 14);
+    p += 16;
+    break;
+  case linktype_linux_sll2:
+    if (left(p, end) < 20)
+      return false;
+    ethertype = be16(p);
+    p += 20;
+    break;
+  case linktype_null:
+    if (left(p, end) < 4)
+      return false;
+    p += 4;
+    break;
+  case linktype_raw:
+  case linktype_ipv4:
+  case linktype_ipv6:
+    break;
+  default:
+    return false;
+  }
+  if (ethertype != -1 && ethertype != 0x0800 && ethertype != 0x86dd)
+    return false;
+  if (left(p, end) < 1)
+    return false;
+
+  // The IP header; 'length' is of the transport header and payload
+  decoded.ip_version = p[0] >> 4;
+  int protocol;
+  uint32_t length;
+  if (decoded.ip_version == 4) {
+    if (left(p, end) < 20)
+      return false;
+    uint32_t header_length = (p[0] & 0xf) * 4;
+    uint16_t fragment = be16(p + 6);
+    // Only the first fragment has the transport header
+    if ((fragment & 0x1fff) != 0 || header_length < 20 ||
+        be16(p + 2) < header_length || left(p, end) < header_length)
+      return false;
+    length = be16(p + 2) - header_length;
+    protocol = p[9];
+    memcpy(decoded.src, p + 12, 4);
+    memcpy(decoded.dst, p + 16, 4);
+    p += header_length;
+  }
+  else if (decoded.ip_version == 6) {
+    if (left(p, end) < 40)
+      return false;
+    length = be16(p + 4);
+    protocol = p[6];
+    memcpy(decoded.src, p + 8, 16);
+    memcpy(decoded.dst, p + 24, 16);
+    p += 40;
+    // Skip hop-by-hop, routing and destination options
+    while ((protocol == 0 || protocol == 43 || protocol == 60) &&
+           left(p, end) >= 8) {
+      uint32_t ext = (p[1] + 1) * 8;
+      if (ext > length || left(p, end) < ext)
+        return false;
+      protocol = p[0];
+      length -= ext;
+      p += ext;
+    }
+  }
+  else
+    return false;
+
+  decoded.protocol = protocol;
+  uint32_t header_length;
+  if (protocol == IPPROTO_TCP) {
+    if (left(p, end) < 20)
+      return false;
+    header_length = (p[12] >> 4) * 4;
+    if (header_length < 20 || left(p, end) < header_length)
+      return false;
+    decoded.seq = be32(p + 4);
+    decoded.ack = be32(p + 8);
+    decoded.tcp_flags = p[13];
+  }
+  else if (protocol == IPPROTO_UDP) {
+    if (left(p, end) < 8)
+      return false;
+    header_length = 8;
+  }
+  else
+    return false;
+  if (length < header_length)
+    return false;
+  decoded.src_port = be16(p);
+  decoded.dst_port = be16(p + 2);
+  decoded.payload = p + header_length;
+  decoded.payload_length = length - header_length;
+  decoded.captured_payload = std::min<size_t>(decoded.payload_length,
+                                              left(decoded.payload, end));
+  return true;
+}
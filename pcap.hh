@@ -0,0 +1,108 @@
+#ifndef PCAP_HH
+#define PCAP_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Streaming reader of pcap and pcapng captures (as written by tcpdump,
+// wireshark and mahimahi), mapping the file rather than reading it. The
+// packets point into the mapping, so they are valid as long as the
+// reader.
+
+struct CapturedPacket {
+  // Unix time, s
+  double time;
+  // From the start of the link layer header
+  const uint8_t* data;
+  uint32_t captured_length;
+  // On the wire, which may be more than was captured
+  uint32_t length;
+  int linktype;
+};
+
+class PcapReader {
+  // The link type and timestamp resolution (s) of a pcapng interface
+  struct Interface {
+    int linktype;
+    double resolution;
+    Interface(int linktype, double resolution)
+      : linktype(linktype), resolution(resolution) {}
+  };
+
+  std::string filename;
+  const uint8_t* image;
+  size_t size;
+  size_t pos;
+  bool pcapng;
+  // Whether the file (or the current pcapng section) is of the other
+  // byte order
+  bool swapped;
+
+  // Classic pcap
+  int linktype;
+  double resolution;
+
+  // pcapng, of the current section
+  std::vector<Interface> interfaces;
+
+  PcapReader();
+  uint16_t read16(const uint8_t* p) const;
+  uint32_t read32(const uint8_t* p) const;
+  bool next_pcap(CapturedPacket& packet);
+  bool next_pcapng(CapturedPacket& packet);
+  void read_interface(const uint8_t* body, size_t length);
+  bool truncated();
+
+ public:
+  ~PcapReader();
+  PcapReader(const PcapReader&) = delete;
+  PcapReader& operator=(const PcapReader&) = delete;
+
+  // Prints an error and returns nullptr if the file cannot be read or is
+  // not a capture
+  static PcapReader* open(const std::string& filename);
+
+  // False at the end of the capture. A truncated capture (eg. of a
+  // tcpdump that was killed) ends at the last whole packet, with a
+  // warning.
+  bool next(CapturedPacket& packet);
+
+  // Bytes read so far and in all
+  size_t position() const { return pos; }
+  size_t file_size() const { return size; }
+};
+
+// The IP and TCP or UDP headers of a packet
+struct DecodedPacket {
+  // 4 or 6
+  int ip_version;
+  // IPPROTO_TCP or IPPROTO_UDP
+  int protocol;
+  // IPv4 addresses use the first 4 bytes
+  uint8_t src[16];
+  uint8_t dst[16];
+  uint16_t src_port;
+  uint16_t dst_port;
+  // TCP only
+  uint32_t seq;
+  uint32_t ack;
+  uint8_t tcp_flags;
+  // The transport payload, of which only 'captured_payload' bytes may
+  // have been captured
+  const uint8_t* payload;
+  uint32_t payload_length;
+  uint32_t captured_payload;
+
+  DecodedPacket();
+  std::string src_address() const;
+  std::string dst_address() const;
+};
+
+// Decodes the IPv4 or IPv6, TCP or UDP headers of 'packet'. False for
+// anything else, for fragments after the first, and if the headers were
+// not all captured.
+bool decode_packet(const CapturedPacket& packet, DecodedPacket& decoded);
+
+#endif
@@ -0,0 +1,488 @@
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+#include "queue-disc.hh"
+
+using namespace std;
+
+/**************************** DROP TAIL *******************************/
+
+DropTail::DropTail(long limit, LimitType limit_type, long mark_threshold) :
+  QueueDisc(mark_threshold > 0),
+  queue(),
+  limit_type(limit_type),
+  limit(limit),
+  mark_threshold(mark_threshold)
+{
+  assert(limit > 0);
+}
+
+void DropTail::enqueue(const QueuedPacket& pkt, double now) {
+  long occupancy = (limit_type == PACKETS) ? num_pkts + 1 : num_bytes + pkt.size;
+  if (occupancy > limit) {
+    drop(pkt);
+    return;
+  }
+  queue.push_back(pkt);
+  queue.back().enqueue_time = now;
+  // Packets that cannot be marked are queued as they are: dropping one
+  // that stays queued would report it lost and still deliver it
+  if (ecn && occupancy > mark_threshold && pkt.ect) {
+    queue.back().ce = true;
+    ++ num_marks;
+  }
+  ++ num_pkts;
+  num_bytes += pkt.size;
+}
+
+bool DropTail::dequeue(QueuedPacket& pkt, double now __attribute((unused))) {
+  if (queue.empty())
+    return false;
+  pkt = queue.front();
+  queue.pop_front();
+  -- num_pkts;
+  num_bytes -= pkt.size;
+  return true;
+}
+
+/****************************** CODEL *********************************/
+
+CoDelState::CoDelState(double target, double interval) :
+  target(target),
+  interval(interval),
+  first_above_time(0),
+  drop_next(0),
+  count(0),
+  last_count(0),
+  dropping(false)
+{}
+
+double CoDelState::control_law(double t) const {
+  return t + interval / sqrt(count);
+}
+
+CoDel::CoDel(long limit_pkts, double target, double interval, bool ecn) :
+  QueueDisc(ecn),
+  queue(),
+  limit(limit_pkts),
+  codel(target, interval)
+{
+  assert(limit > 0);
+}
+
+void CoDel::enqueue(const QueuedPacket& pkt, double now) {
+  if (num_pkts + 1 > limit) {
+    drop(pkt);
+    return;
+  }
+  queue.push_back(pkt);
+  queue.back().enqueue_time = now;
+  ++ num_pkts;
+  num_bytes += pkt.size;
+}
+
+bool CoDel::dequeue(QueuedPacket& pkt, double now) {
+  auto pop = [this](QueuedPacket& p, long& bytes_left) {
+    if (queue.empty())
+      return false;
+    p = queue.front();
+    queue.pop_front();
+    -- num_pkts;
+    num_bytes -= p.size;
+    bytes_left = num_bytes;
+    return true;
+  };
+  auto signal = [this](QueuedPacket& p) { return mark_or_drop(p); };
+  return codel.dequeue(pkt, now, pop, signal);
+}
+
+/**************************** FQ-CODEL ********************************/
+
+FQCoDel::FlowQueue::FlowQueue(double target, double interval) :
+  queue(16),
+  bytes(0),
+  deficit(0),
+  listed(false),
+  codel(target, interval)
+{}
+
+FQCoDel::FQCoDel(long limit_pkts, int num_queues, int quantum, double target,
+                 double interval, bool ecn) :
+  QueueDisc(ecn),
+  flows(num_queues, FlowQueue(target, interval)),
+  new_flows(num_queues),
+  old_flows(num_queues),
+  limit(limit_pkts),
+  quantum(quantum)
+{
+  assert(limit > 0 && num_queues > 0 && quantum > 0);
+}
+
+size_t FQCoDel::flow_index(int flow_id) const {
+  // Multiplicative hashing so nearby ids spread over the queues
+  return (uint32_t(flow_id) * 2654435761u) % flows.size();
+}
+
+void FQCoDel::drop_from_longest() {
+  size_t longest = 0;
+  for (size_t i = 1; i < flows.size(); ++i) {
+    if (flows[i].bytes > flows[longest].bytes)
+      longest = i;
+  }
+  FlowQueue& flow = flows[longest];
+  QueuedPacket pkt = flow.queue.front();
+  flow.queue.pop_front();
+  flow.bytes -= pkt.size;
+  -- num_pkts;
+  num_bytes -= pkt.size;
+  drop(pkt);
+}
+
+void FQCoDel::enqueue(const QueuedPacket& pkt, double now) {
+  size_t index = flow_index(pkt.flow_id);
+  FlowQueue& flow = flows[index];
+  flow.queue.push_back(pkt);
+  flow.queue.back().enqueue_time = now;
+  flow.bytes += pkt.size;
+  ++ num_pkts;
+  num_bytes += pkt.size;
+  if (!flow.listed) {
+    flow.listed = true;
+    flow.deficit = quantum;
+    new_flows.push_back(index);
+  }
+  if (num_pkts > limit)
+    drop_from_longest();
+}
+
+bool FQCoDel::dequeue(QueuedPacket& pkt, double now) {
+  auto signal = [this](QueuedPacket& p) { return mark_or_drop(p); };
+  while (true) {
+    bool is_new = !new_flows.empty();
+    RingBuffer<int>& list = is_new ? new_flows : old_flows;
+    if (list.empty())
+      return false;
+    int index = list.front();
+    FlowQueue& flow = flows[index];
+
+    if (flow.deficit <= 0) {
+      flow.deficit += quantum;
+      list.pop_front();
+      old_flows.push_back(index);
+      continue;
+    }
+
+    auto pop = [this, &flow](QueuedPacket& p, long& bytes_left) {
+      if (flow.queue.empty())
+        return false;
+      p = flow.queue.front();
+      flow.queue.pop_front();
+      flow.bytes -= p.size;
+      -- num_pkts;
+      num_bytes -= p.size;
+      bytes_left = flow.bytes;
+      return true;
+    };
+    if (flow.codel.dequeue(pkt, now, pop, signal)) {
+      flow.deficit -= pkt.size;
+      return true;
+    }
+
+    // The queue is empty. A new flow goes to the back of the old ones so
+    // that it cannot starve them by coming and going.
+    list.pop_front();
+    if (is_new)
+      old_flows.push_back(index);
+    else
+      flow.listed = false;
+  }
+}
+
+/******************************* RED **********************************/
+
+RED::RED(long limit_pkts, double min_th, double max_th, double max_p,
+         double weight, bool gentle, bool ecn) :
+  QueueDisc(ecn),
+  queue(),
+  limit(limit_pkts),
+  min_th(min_th),
+  max_th(max_th),
+  max_p(max_p),
+  weight(weight),
+  gentle(gentle),
+  avg(0),
+  count(-1),
+  idle_since(0),
+  pkt_time(0),
+  last_dequeue(-1),
+  prng(1)
+{
+  assert(limit > 0 && 0 <= min_th && min_th < max_th);
+  assert(0 < max_p && max_p <= 1 && 0 < weight && weight <= 1);
+}
+
+double RED::drop_probability() const {
+  if (avg < min_th)
+    return 0;
+  if (avg < max_th)
+    return max_p * (avg - min_th) / (max_th - min_th);
+  if (gentle && avg < 2 * max_th)
+    return max_p + (1 - max_p) * (avg - max_th) / max_th;
+  return 1;
+}
+
+void RED::enqueue(const QueuedPacket& pkt, double now) {
+  if (idle_since >= 0 && pkt_time > 0)
+    avg *= pow(1 - weight, (now - idle_since) / pkt_time);
+  else
+    avg += weight * (num_pkts - avg);
+  idle_since = -1;
+
+  if (num_pkts + 1 > limit) {
+    drop(pkt);
+    count = 0;
+    return;
+  }
+
+  QueuedPacket p = pkt;
+  double prob = drop_probability();
+  if (prob >= 1) {
+    count = 0;
+    if (!mark_or_drop(p))
+      return;
+  }
+  else if (prob > 0) {
+    // Spread the early drops out evenly rather than geometrically
+    ++ count;
+    double pa = (count * prob < 1) ? prob / (1 - count * prob) : 1;
+    if (uniform_real_distribution<double>(0, 1)(prng) < pa) {
+      count = 0;
+      if (!mark_or_drop(p))
+        return;
+    }
+  }
+  else
+    count = -1;
+
+  queue.push_back(p);
+  queue.back().enqueue_time = now;
+  ++ num_pkts;
+  num_bytes += pkt.size;
+}
+
+bool RED::dequeue(QueuedPacket& pkt, double now) {
+  if (queue.empty())
+    return false;
+  // Departures while backlogged are one transmission time apart
+  if (last_dequeue >= 0) {
+    double gap = now - last_dequeue;
+    pkt_time = (pkt_time == 0) ? gap : 0.9 * pkt_time + 0.1 * gap;
+  }
+  pkt = queue.front();
+  queue.pop_front();
+  -- num_pkts;
+  num_bytes -= pkt.size;
+  last_dequeue = queue.empty() ? -1 : now;
+  if (queue.empty())
+    idle_since = now;
+  return true;
+}
+
+/******************************* PIE **********************************/
+
+PIE::PIE(long limit_pkts, double target, double tupdate, double alpha,
+         double beta, double max_burst, bool ecn) :
+  QueueDisc(ecn),
+  queue(),
+  limit(limit_pkts),
+  target(target),
+  tupdate(tupdate),
+  alpha(alpha),
+  beta(beta),
+  max_burst(max_burst),
+  drop_prob(0),
+  qdelay(0),
+  qdelay_old(0),
+  burst_allowance(max_burst),
+  next_update(tupdate),
+  prng(1)
+{
+  assert(limit > 0 && target > 0 && tupdate > 0);
+}
+
+void PIE::update_probability(double now) {
+  while (now >= next_update) {
+    next_update += tupdate;
+    if (queue.empty())
+      qdelay = 0;
+
+    // alpha and beta are per second of delay
+    double p = (alpha * (qdelay - target) + beta * (qdelay - qdelay_old)) / 1000;
+    // Small probabilities move in small steps
+    if (drop_prob < 0.000001)
+      p /= 2048;
+    else if (drop_prob < 0.00001)
+      p /= 512;
+    else if (drop_prob < 0.0001)
+      p /= 128;
+    else if (drop_prob < 0.001)
+      p /= 32;
+    else if (drop_prob < 0.01)
+      p /= 8;
+    else if (drop_prob < 0.1)
+      p /= 2;
+    drop_prob += p;
+    if (qdelay > 250)
+      drop_prob += 0.02;
+    if (qdelay == 0 && qdelay_old == 0)
+      drop_prob *= 0.98;
+    drop_prob = min(max(drop_prob, 0.), 1.);
+
+    if (burst_allowance > 0)
+      burst_allowance = max(0., burst_allowance - tupdate);
+    if (drop_prob == 0 && qdelay < target / 2 && qdelay_old < target / 2)
+      burst_allowance = max_burst;
+    qdelay_old = qdelay;
+  }
+}
+
+void PIE::enqueue(const QueuedPacket& pkt, double now) {
+  update_probability(now);
+  if (num_pkts + 1 > limit) {
+    drop(pkt);
+    return;
+  }
+
+  QueuedPacket p = pkt;
+  bool early = burst_allowance == 0 &&
+    !(qdelay_old < target / 2 && drop_prob < 0.2) &&
+    num_bytes >= 2 * mtu &&
+    uniform_real_distribution<double>(0, 1)(prng) < drop_prob;
+  if (early) {
+    if (drop_prob > mark_ecn_threshold) {
+      drop(p);
+      return;
+    }
+    if (!mark_or_drop(p))
+      return;
+  }
+
+  queue.push_back(p);
+  queue.back().enqueue_time = now;
+  ++ num_pkts;
+  num_bytes += pkt.size;
+}
+
+bool PIE::dequeue(QueuedPacket& pkt, double now) {
+  update_probability(now);
+  if (queue.empty())
+    return false;
+  pkt = queue.front();
+  queue.pop_front();
+  -- num_pkts;
+  num_bytes -= pkt.size;
+  qdelay = now - pkt.enqueue_time;
+  return true;
+}
+
+/***************************** FACTORY ********************************/
+
+unique_ptr<QueueDisc> make_queue_disc(const string& type, const string& args) {
+  map<string, double> params;
+  size_t start_pos = 0;
+  while (start_pos < args.length()) {
+    size_t end_pos = args.find(',', start_pos);
+    if (end_pos == string::npos)
+      end_pos = args.length();
+    string arg = args.substr(start_pos, end_pos - start_pos);
+    size_t eq = arg.find('=');
+    if (eq == string::npos) {
+      fprintf(stderr, "Queue argument '%s' is not of the form key=value.\n",
+              arg.c_str());
+      return nullptr;
+    }
+    params[arg.substr(0, eq)] = atof(arg.substr(eq + 1).c_str());
+    start_pos = end_pos + 1;
+  }
+
+  auto get = [&params](const string& key, double def) {
+    return params.count(key) ? params[key] : def;
+  };
+  bool ecn = get("ecn", 0) != 0;
+
+  if (type == "infinite")
+    return unique_ptr<QueueDisc>(new DropTail(LONG_MAX, DropTail::PACKETS));
+  if (type == "droptail") {
+    long mark = long(get("mark", 0));
+    if (params.count("packets") && params["packets"] > 0)
+      return unique_ptr<QueueDisc>(
+        new DropTail(long(params["packets"]), DropTail::PACKETS, mark));
+    if (params.count("bytes") && params["bytes"] > 0)
+      return unique_ptr<QueueDisc>(
+        new DropTail(long(params["bytes"]), DropTail::BYTES, mark));
+    fprintf(stderr, "droptail needs 'packets=' or 'bytes='.\n");
+    return nullptr;
+  }
+  if (type == "codel") {
+    long packets = long(get("packets", 1000));
+    double target = get("target", 5);
+    double interval = get("interval", 100);
+    if (packets <= 0 || target <= 0 || interval <= 0) {
+      fprintf(stderr, "codel needs positive 'packets', 'target' and 'interval'.\n");
+      return nullptr;
+    }
+    return unique_ptr<QueueDisc>(new CoDel(packets, target, interval, ecn));
+  }
+  if (type == "fq_codel") {
+    // Linux's defaults
+    long packets = long(get("packets", 10240));
+    int flows = int(get("flows", 1024));
+    int quantum = int(get("quantum", 1514));
+    double target = get("target", 5);
+    double interval = get("interval", 100);
+    if (packets <= 0 || flows <= 0 || quantum <= 0 || target <= 0 || interval <= 0) {
+      fprintf(stderr, "fq_codel needs positive 'packets', 'flows', 'quantum', 'target' and 'interval'.\n");
+      return nullptr;
+    }
+    return unique_ptr<QueueDisc>(
+      new FQCoDel(packets, flows, quantum, target, interval, ecn));
+  }
+  if (type == "red") {
+    long packets = long(get("packets", 1000));
+    double min_th = get("min_th", 5);
+    double max_th = get("max_th", 3 * min_th);
+    double max_p = get("max_p", 0.1);
+    double weight = get("weight", 0.002);
+    bool gentle = get("gentle", 1) != 0;
+    if (packets <= 0 || min_th < 0 || max_th <= min_th || max_p <= 0 ||
+        max_p > 1 || weight <= 0 || weight > 1) {
+      fprintf(stderr, "red needs positive 'packets', 0 <= 'min_th' < 'max_th', and 'max_p' and 'weight' in (0, 1].\n");
+      return nullptr;
+    }
+    return unique_ptr<QueueDisc>(
+      new RED(packets, min_th, max_th, max_p, weight, gentle, ecn));
+  }
+  if (type == "pie") {
+    // RFC 8033's defaults
+    long packets = long(get("packets", 1000));
+    double target = get("target", 15);
+    double tupdate = get("tupdate", 15);
+    double alpha = get("alpha", 0.125);
+    double beta = get("beta", 1.25);
+    double max_burst = get("max_burst", 150);
+    if (packets <= 0 || target <= 0 || tupdate <= 0 || alpha < 0 ||
+        beta < 0 || max_burst < 0) {
+      fprintf(stderr, "pie needs positive 'packets', 'target' and 'tupdate', and non-negative 'alpha', 'beta' and 'max_burst'.\n");
+      return nullptr;
+    }
+    return unique_ptr<QueueDisc>(
+      new PIE(packets, target, tupdate, alpha, beta, max_burst, ecn));
+  }
+  fprintf(stderr, "Unrecognised queue type '%s'.\n", type.c_str());
+  return nullptr;
+}
@@ -0,0 +1,329 @@
+#ifndef QUEUE_DISC_HH
+#define QUEUE_DISC_HH
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ring-buffer.hh"
+
+// A packet as seen by a bottleneck buffer. Shared by the simulator and the
+// link emulator, so it only carries what queueing disciplines need plus a
+// few fields the owner uses to find its way back to the real packet.
+struct QueuedPacket {
+  // Time at which the packet entered the queue (ms). Set by enqueue.
+  double enqueue_time;
+  // Time at which the sender sent the packet (ms)
+  double sent_time;
+  // Bytes on the wire
+  int size;
+  int flow_id;
+  int seq_num;
+  // Not interpreted by the queue. The simulator stores the on-period of
+  // the sender here, the emulator the buffer slot holding the payload.
+  int tag;
+  // ECN capable transport. Queues with ECN on mark such packets (set 'ce')
+  // instead of dropping them early.
+  bool ect;
+  // Congestion experienced
+  bool ce;
+};
+
+// Interface for the buffer in front of a link. All drops, whether of
+// the arriving packet or of packets already queued (as AQMs do), are
+// reported through the drop callback so the owner can account for them
+// (and, for the emulator, reclaim the payload).
+class QueueDisc {
+ public:
+  typedef std::function<void(const QueuedPacket&)> DropCallback;
+
+ protected:
+  int num_pkts;
+  long num_bytes;
+  long num_drops;
+  long num_marks;
+  // Whether to mark ECN capable packets instead of dropping them early
+  bool ecn;
+  DropCallback on_drop;
+
+  void drop(const QueuedPacket& pkt) {
+    ++ num_drops;
+    if (on_drop)
+      on_drop(pkt);
+  }
+
+  // Signals congestion with 'pkt': marks it if it is ECN capable and ECN
+  // is on, and drops it otherwise. Returns whether the packet survived.
+  bool mark_or_drop(QueuedPacket& pkt) {
+    if (ecn && pkt.ect) {
+      pkt.ce = true;
+      ++ num_marks;
+      return true;
+    }
+    drop(pkt);
+    return false;
+  }
+
+ public:
+  explicit QueueDisc(bool ecn = false) :
+    num_pkts(0), num_bytes(0), num_drops(0), num_marks(0), ecn(ecn), on_drop()
+  {}
+  virtual ~QueueDisc() {}
+
+  // Adds a packet that arrived at time 'now' (ms), or drops it.
+  virtual void enqueue(const QueuedPacket& pkt, double now) = 0;
+  // Removes the next packet to transmit at time 'now'. Returns false if
+  // there is none.
+  virtual bool dequeue(QueuedPacket& pkt, double now) = 0;
+
+  void set_drop_callback(DropCallback callback) { on_drop = callback; }
+
+  bool empty() const { return num_pkts == 0; }
+  int size_pkts() const { return num_pkts; }
+  long size_bytes() const { return num_bytes; }
+  long drops() const { return num_drops; }
+  long marks() const { return num_marks; }
+};
+
+// Tail-drop FIFO with a limit in packets or in bytes. If 'mark_threshold'
+// is positive, ECN capable packets that arrive when the queue holds more
+// than that (in the same unit as the limit) are marked, as DCTCP expects;
+// other packets are only dropped when the queue is full.
+class DropTail : public QueueDisc {
+ public:
+  enum LimitType {PACKETS, BYTES};
+
+ private:
+  RingBuffer<QueuedPacket> queue;
+  LimitType limit_type;
+  long limit;
+  long mark_threshold;
+
+ public:
+  DropTail(long limit, LimitType limit_type = PACKETS, long mark_threshold = 0);
+
+  void enqueue(const QueuedPacket& pkt, double now) override;
+  bool dequeue(QueuedPacket& pkt, double now) override;
+};
+
+// The CoDel control law (RFC 8289) for one FIFO, shared by CoDel and
+// FQ-CoDel. It does not own the packets: dequeue() takes the head of the
+// queue with 'pop(pkt, bytes_left)', which returns false if the queue is
+// empty, and calls 'signal(pkt)' for every packet it wants to drop. Signal
+// returns true if it marked the packet instead, which is then delivered.
+class CoDelState {
+  // Below this many bytes in the queue we never drop (one MTU)
+  static constexpr int max_packet = 1500;
+
+  double target;
+  double interval;
+
+  double first_above_time;
+  double drop_next;
+  int count;
+  int last_count;
+  bool dropping;
+
+  // Pops the head packet into 'pkt'. Returns false if empty. Sets
+  // 'ok_to_drop' if the sojourn time has been above target long enough.
+  template <class Pop>
+  bool do_dequeue(QueuedPacket& pkt, double now, Pop& pop, bool& ok_to_drop);
+  double control_law(double t) const;
+
+ public:
+  CoDelState(double target, double interval);
+
+  template <class Pop, class Signal>
+  bool dequeue(QueuedPacket& pkt, double now, Pop pop, Signal signal);
+};
+
+template <class Pop>
+bool CoDelState::do_dequeue(QueuedPacket& pkt, double now, Pop& pop,
+                            bool& ok_to_drop) {
+  ok_to_drop = false;
+  long bytes_left;
+  if (!pop(pkt, bytes_left)) {
+    first_above_time = 0;
+    return false;
+  }
+  double sojourn_time = now - pkt.enqueue_time;
+  if (sojourn_time < target || bytes_left <= max_packet)
+    first_above_time = 0;
+  else if (first_above_time == 0)
+    first_above_time = now + interval;
+  else if (now >= first_above_time)
+    ok_to_drop = true;
+  return true;
+}
+
+template <class Pop, class Signal>
+bool CoDelState::dequeue(QueuedPacket& pkt, double now, Pop pop, Signal signal) {
+  bool ok_to_drop;
+  if (!do_dequeue(pkt, now, pop, ok_to_drop)) {
+    dropping = false;
+    return false;
+  }
+
+  if (dropping) {
+    if (!ok_to_drop)
+      dropping = false;
+    while (dropping && now >= drop_next) {
+      ++ count;
+      if (signal(pkt)) {
+        drop_next = control_law(drop_next);
+        return true;
+      }
+      if (!do_dequeue(pkt, now, pop, ok_to_drop)) {
+        dropping = false;
+        return false;
+      }
+      if (!ok_to_drop)
+        dropping = false;
+      else
+        drop_next = control_law(drop_next);
+    }
+  }
+  else if (ok_to_drop) {
+    bool have_pkt = signal(pkt) || do_dequeue(pkt, now, pop, ok_to_drop);
+    dropping = true;
+    // If we were dropping recently, start from the drop rate we had
+    // reached rather than from scratch
+    int delta = count - last_count;
+    if (delta > 1 && now - drop_next < 16 * interval)
+      count = delta;
+    else
+      count = 1;
+    drop_next = control_law(now);
+    last_count = count;
+    if (!have_pkt)
+      return false;
+  }
+  return true;
+}
+
+// CoDel (RFC 8289). Drops at dequeue once the sojourn time of packets has
+// stayed above 'target' for at least 'interval' (both in ms).
+class CoDel : public QueueDisc {
+  RingBuffer<QueuedPacket> queue;
+  long limit;
+  CoDelState codel;
+
+ public:
+  CoDel(long limit_pkts, double target, double interval, bool ecn = false);
+
+  void enqueue(const QueuedPacket& pkt, double now) override;
+  bool dequeue(QueuedPacket& pkt, double now) override;
+};
+
+// FQ-CoDel (RFC 8290). Packets are hashed by flow into 'num_queues'
+// queues, each under its own CoDel, which are served by deficit round
+// robin with a 'quantum' of bytes, giving priority to queues that were
+// empty. When the total limit is hit, the longest queue loses its head.
+class FQCoDel : public QueueDisc {
+  struct FlowQueue {
+    RingBuffer<QueuedPacket> queue;
+    long bytes;
+    int deficit;
+    // Whether the queue is in new_flows or old_flows
+    bool listed;
+    CoDelState codel;
+
+    FlowQueue(double target, double interval);
+  };
+
+  std::vector<FlowQueue> flows;
+  // Indices into 'flows'
+  RingBuffer<int> new_flows;
+  RingBuffer<int> old_flows;
+  long limit;
+  int quantum;
+
+  size_t flow_index(int flow_id) const;
+  void drop_from_longest();
+
+ public:
+  FQCoDel(long limit_pkts, int num_queues, int quantum, double target,
+          double interval, bool ecn = false);
+
+  void enqueue(const QueuedPacket& pkt, double now) override;
+  bool dequeue(QueuedPacket& pkt, double now) override;
+};
+
+// RED (Floyd and Jacobson) on the average queue length in packets, with
+// the 'gentle' ramp from max_p at max_th to 1 at 2 * max_th. While the
+// queue is idle the average decays as if packets of the size last seen
+// had kept departing.
+class RED : public QueueDisc {
+  RingBuffer<QueuedPacket> queue;
+  long limit;
+  double min_th;
+  double max_th;
+  double max_p;
+  double weight;
+  bool gentle;
+
+  double avg;
+  // Packets accepted since the last early drop, or -1 when below min_th
+  int count;
+  // Time the queue went idle, or -1 if it is not idle
+  double idle_since;
+  // Average time between back-to-back departures (ms), 0 if unknown
+  double pkt_time;
+  // Time of the last departure if it left packets behind, else -1
+  double last_dequeue;
+  std::minstd_rand prng;
+
+  double drop_probability() const;
+
+ public:
+  RED(long limit_pkts, double min_th, double max_th, double max_p,
+      double weight, bool gentle, bool ecn = false);
+
+  void enqueue(const QueuedPacket& pkt, double now) override;
+  bool dequeue(QueuedPacket& pkt, double now) override;
+};
+
+// PIE (RFC 8033). Every 'tupdate' ms a drop probability is adjusted from
+// the queueing delay (the sojourn time of departing packets) and its
+// trend, aiming at 'target' ms. Arriving packets are dropped, or marked
+// while the probability is at most 10%, with that probability. Bursts of
+// up to 'max_burst' ms are let through after the queue has been quiet.
+class PIE : public QueueDisc {
+  static constexpr int mtu = 1500;
+  static constexpr double mark_ecn_threshold = 0.1;
+
+  RingBuffer<QueuedPacket> queue;
+  long limit;
+  double target;
+  double tupdate;
+  double alpha;
+  double beta;
+  double max_burst;
+
+  double drop_prob;
+  double qdelay;
+  double qdelay_old;
+  double burst_allowance;
+  double next_update;
+  std::minstd_rand prng;
+
+  void update_probability(double now);
+
+ public:
+  PIE(long limit_pkts, double target, double tupdate, double alpha,
+      double beta, double max_burst, bool ecn = false);
+
+  void enqueue(const QueuedPacket& pkt, double now) override;
+  bool dequeue(QueuedPacket& pkt, double now) override;
+};
+
+// Makes a queue from a mahimahi style type ('infinite', 'droptail',
+// 'codel', 'fq_codel', 'red' or 'pie') and comma separated arguments, eg.
+// 'packets=100', 'bytes=30000' or 'target=5,interval=100,ecn=1'. Prints an
+// error and returns null if they do not make sense.
+std::unique_ptr<QueueDisc> make_queue_disc(const std::string& type,
+                                           const std::string& args);
+
+#endif
@@ -5,8 +5,10 @@
 
 using namespace std;
 
-Rat::Rat( WhiskerTree & s_whiskers, const bool s_track )
-  :  _whiskers( s_whiskers ),
+template < typename MemoryType >
+BasicRat< MemoryType >::BasicRat( WhiskerTree & s_whiskers, const bool s_track )
+  :  _whiskers( &s_whiskers ),
+     _flat( nullptr ),
      _memory(),
      _packets_sent( 0 ),
      _packets_received( 0 ),
@@ -15,11 +17,52 @@ Rat::Rat( WhiskerTree & s_whiskers, const bool s_track )
      _the_window( 0 ),
      _intersend_time( 0 ),
      _flow_id( 0 ),
-     _largest_ack( -1 )
+     _largest_ack( -1 ),
+     _profile( nullptr ),
+     _profile_counters( nullptr )
 {
 }
 
-void Rat::packets_received( const vector< Packet > & packets, const double link_rate_normalizing_factor ) {
+template < typename MemoryType >
+BasicRat< MemoryType >::BasicRat( const FlatWhiskerTree & s_flat )
+  :  _whiskers( nullptr ),
+     _flat( &s_flat ),
+     _memory(),
+     _packets_sent( 0 ),
+     _packets_received( 0 ),
+     _track( false ),
+     _last_send_time( 0 ),
+     _the_window( 0 ),
+     _intersend_time( 0 ),
+     _flow_id( 0 ),
+     _largest_ack( -1 ),
+     _profile( nullptr ),
+     _profile_counters( nullptr )
+{
+}
+
+template < typename MemoryType >
+void BasicRat< MemoryType >::use_whisker( void )
+{
+  if ( _flat ) {
+    const FlatWhisker & current_whisker( _flat->use_whisker( _memory ) );
+    if ( _profile ) {
+      _profile->record( *_profile_counters, &current_whisker, _memory );
+    }
+    _the_window = current_whisker.window( _the_window );
+    _intersend_time = current_whisker.intersend;
+  } else {
+    const BasicWhisker< MemoryType > & current_whisker( _whiskers->use_whisker( _memory, _track ) );
+    if ( _profile ) {
+      _profile->record( *_profile_counters, &current_whisker, _memory );
+    }
+    _the_window = current_whisker.window( _the_window );
+    _intersend_time = current_whisker.intersend();
+  }
+}
+
+template < typename MemoryType >
+void BasicRat< MemoryType >::packets_received( const vector< Packet > & packets, const double link_rate_normalizing_factor ) {
   _packets_received += packets.size();
   
   int flow_id = -1;
@@ -32,13 +75,11 @@ void Rat::packets_received( const vector< Packet > & packets, const double link_
 
   _memory.packets_received( packets, flow_id/*_flow_id*/, link_rate_normalizing_factor );
 
-  const Whisker & current_whisker( _whiskers.use_whisker( _memory, _track ) );
-
-  _the_window = current_whisker.window( _the_window );
-  _intersend_time = current_whisker.intersend();
+  use_whisker();
 }
 
-void Rat::reset( const double & )
+template < typename MemoryType >
+void BasicRat< MemoryType >::reset( const double & )
 {
   _memory.reset();
   _last_send_time = 0;
@@ -49,7 +90,8 @@ void Rat::reset( const double & )
   assert( _flow_id != 0 );
 }
 
-double Rat::next_event_time( const double & tickno ) const
+template < typename MemoryType >
+double BasicRat< MemoryType >::next_event_time( const double & tickno ) const
 {
   if ( _packets_sent < _largest_ack + 1 + _the_window ) {
     if ( _last_send_time + _intersend_time <= tickno ) {
@@ -64,15 +106,14 @@ double Rat::next_event_time( const double & tickno ) const
 }
 
 // returns whether or not a packet should be sent. If yes, updates internal state accordingly
-bool Rat::send( const double & curtime )
+template < typename MemoryType >
+bool BasicRat< MemoryType >::send( const double & curtime )
 {
   assert( _packets_sent >= _largest_ack + 1 );
 
   if ( _the_window == 0 ) {
     /* initial window and intersend time */
-    const Whisker & current_whisker( _whiskers.use_whisker( _memory, _track ) );
-    _the_window = current_whisker.window( _the_window );
-    _intersend_time = current_whisker.intersend();
+    use_whisker();
     // assert(_the_window != 0 ); //edit - venkat - just to ensure that a sender doesn't stay 0 forever because right now, I believe that memory will never be called if no packets are sent. But something tells me that my understanding is incorrect
   }
 
@@ -88,4 +129,8 @@ bool Rat::send( const double & curtime )
   }
 
   return false;
-}
\ No newline at end of file
+}
+
+template class BasicRat< MemoryDefault >;
+template class BasicRat< MemoryWithLossSignal >;
+template class BasicRat< MemoryWithoutSlowRewma >;
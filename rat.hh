@@ -7,13 +7,21 @@
 
 #include "packet.hh"
 #include "whiskertree.hh"
+#include "flat-whiskers.hh"
 #include "memory.hh"
+#include "whisker-profile.hh"
 
-class Rat
+template < typename MemoryType >
+class BasicRat
 {
+public:
+  typedef BasicWhiskerTree< MemoryType > WhiskerTree;
+
 private:
-  const WhiskerTree & _whiskers;
-  Memory _memory;
+  /* exactly one of these is set */
+  const WhiskerTree * _whiskers;
+  const FlatWhiskerTree * _flat;
+  MemoryType _memory;
 
   int _packets_sent, _packets_received;
 
@@ -28,17 +36,35 @@ private:
   // This represents the largest sequence number from among the packets recieved (via packets_recieved) from SenderGang. So this is not the ACK in the traditional sense but is 
   int _largest_ack;
 
+  /* if set, every lookup is recorded in _profile */
+  const WhiskerProfile * _profile;
+  WhiskerProfile::Counters * _profile_counters;
+
+  void use_whisker( void );
+
 public:
-  Rat( WhiskerTree & s_whiskers, const bool s_track=false );
+  BasicRat( WhiskerTree & s_whiskers, const bool s_track=false );
+  /* 's_flat' must be of MemoryType */
+  BasicRat( const FlatWhiskerTree & s_flat );
+  BasicRat( const BasicRat & ) = default;
 
   void packets_received( const std::vector< Packet > & packets, const double link_rate_normalizing_factor );
   void reset( const double & tickno ); /* start new flow */
 
   bool send( const double & curtime );
 
-  const WhiskerTree & whiskers( void ) const { return _whiskers; }
+  const WhiskerTree & whiskers( void ) const { assert( _whiskers ); return *_whiskers; }
 
-  Rat & operator=( const Rat & ) { assert( false ); return *this; }
+  /* Looks up whiskers in another tree from now on, e.g. in the current
+     version of a LiveWhiskerTree */
+  void set_whiskers( const WhiskerTree & s_whiskers ) { _whiskers = &s_whiskers; _flat = nullptr; }
+  void set_whiskers( const FlatWhiskerTree & s_flat ) { _whiskers = nullptr; _flat = &s_flat; }
+
+  /* Records lookups in 'profile', which must be of the tree this uses and
+     outlive it. Copies share the counters, so must not run concurrently. */
+  void set_profile( WhiskerProfile & profile ) { _profile = &profile; _profile_counters = &profile.register_counters(); }
+
+  BasicRat & operator=( const BasicRat & ) { assert( false ); return *this; }
 
   double next_event_time( const double & tickno ) const;
 
@@ -48,4 +74,6 @@ public:
   double cur_intersend_time() const {return _intersend_time; }
 };
 
+typedef BasicRat< Memory > Rat;
+
 #endif
\ No newline at end of file
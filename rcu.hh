@@ -0,0 +1,109 @@
+#ifndef RCU_HH
+#define RCU_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// Publishes an immutable T to lock-free readers, read-copy-update style.
+// A writer replaces the whole T and frees the old one only once every
+// reader that may have seen it has left its read-side critical section,
+// which it detects with epochs: a reader records the epoch it enters in,
+// and a writer advances the epoch after publishing and waits for the
+// readers of older epochs.
+//
+// Readers register once for a slot of their own, and a slot must only be
+// used by one thread at a time. Entering and leaving a critical section
+// is a handful of uncontended atomic operations; a writer may spin until
+// the readers it waits for move on.
+template <class T>
+class RcuCell {
+ public:
+  static const int max_readers = 64;
+
+ private:
+  struct Slot {
+    // Epoch of the critical section the reader is in, 0 if none
+    std::atomic<uint64_t> epoch;
+    // Keep slots on separate cache lines
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+
+    Slot() : epoch(0), padding() {}
+  };
+
+  std::atomic<const T*> current;
+  std::atomic<uint64_t> epoch;
+  std::atomic<int> num_readers;
+  Slot slots[max_readers];
+  // Serializes writers
+  std::mutex writer;
+
+ public:
+  // Takes ownership of 'initial'
+  explicit RcuCell(const T* initial)
+    : current(initial), epoch(1), num_readers(0), slots(), writer() {}
+  ~RcuCell() { delete current.load(); }
+
+  RcuCell(const RcuCell&) = delete;
+  RcuCell& operator=(const RcuCell&) = delete;
+
+  // Returns a new reader slot, or -1 if there are max_readers already
+  int register_reader() {
+    int slot = num_readers++;
+    return slot < max_readers ? slot : -1;
+  }
+
+  // The returned T stays valid until read_unlock(slot)
+  const T* read_lock(int slot) {
+    assert(slot >= 0 && slot < max_readers);
+    // Sequentially consistent, so that a writer that does not see this
+    // store has already published, and the load below sees its T
+    slots[slot].epoch.store(epoch.load());
+    return current.load();
+  }
+
+  void read_unlock(int slot) {
+    slots[slot].epoch.store(0, std::memory_order_release);
+  }
+
+  // Replaces the T by 'next' (taking ownership) and frees the old one
+  // once no reader uses it
+  void publish(const T* next) {
+    std::lock_guard<std::mutex> lock(writer);
+    const T* old = current.exchange(next);
+    uint64_t new_epoch = ++epoch;
+    int n = std::min(num_readers.load(), max_readers);
+    for (int i = 0; i < n; i++) {
+      while (true) {
+        uint64_t e = slots[i].epoch.load();
+        if (e == 0 || e >= new_epoch)
+          break;
+        std::this_thread::yield();
+      }
+    }
+    delete old;
+  }
+
+  // Holds a read-side critical section for its lifetime
+  class ReadGuard {
+    RcuCell* cell;
+    int slot;
+    const T* value;
+
+   public:
+    ReadGuard(RcuCell& cell, int slot)
+      : cell(&cell), slot(slot), value(cell.read_lock(slot)) {}
+    ~ReadGuard() { cell->read_unlock(slot); }
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+    const T& operator*() const { return *value; }
+    const T* operator->() const { return value; }
+  };
+};
+
+#endif
@@ -1,7 +1,10 @@
 #include <cassert>
 #include <chrono>
+#include <csignal>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <mutex>
 #include <string.h>
 #include <thread>
@@ -10,6 +13,8 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 
+#include "latency-histogram.hh"
+#include "live-stats.hh"
 #include "tcp-header.hh"
 #include "udp-socket.hh"
 
@@ -63,25 +68,142 @@ void punch_NAT(string serverip, UDPSocket &sender_socket) {
 	}
 }
 
+// The flow a sender is currently sending
+struct ReceiverFlow {
+	// in the live statistics, -1 if not published
+	int slot;
+	int expected_seq;
+	// ms, on the clock of echo_packets
+	double first_time;
+	double last_time;
+	// The one way delay includes the offset between the clocks of the
+	// sender and receiver, so only its excess over the minimum is known
+	double min_one_way_delay;
+	FlowStats stats;
+	LatencyHistogram queuing_delay;
+	LatencyHistogram inter_arrival;
+
+	ReceiverFlow(const TCPHeader& header, double cur_time)
+		: slot(-1), expected_seq(0), first_time(cur_time),
+		  last_time(cur_time),
+		  min_one_way_delay(cur_time - header.sender_timestamp),
+		  stats(), queuing_delay(), inter_arrival()
+	{
+		stats.state = FlowStats::ACTIVE;
+		stats.src_id = header.src_id;
+		stats.flow_id = header.flow_id;
+		stats.start_time = chrono::duration_cast<chrono::duration<double>>(
+			chrono::system_clock::now().time_since_epoch()).count();
+		if (LiveStats::instance() != nullptr)
+			slot = LiveStats::instance()->open_slot();
+	}
+};
+
+// The flows of all senders, keyed by src_id, and the latencies of the
+// flows that have ended
+struct ReceiverFlows {
+	map<int, ReceiverFlow> active;
+	LatencyHistogram queuing_delay;
+	LatencyHistogram inter_arrival;
+	int num_ended;
+
+	ReceiverFlows()
+		: active(), queuing_delay(), inter_arrival(), num_ended(0) {}
+};
+
+// Flows with no packets for this long (ms) have ended
+const double flow_idle_timeout = 1000;
+
+void end_flow(ReceiverFlows& flows, ReceiverFlow& flow) {
+	cout << "Flow " << flow.stats.flow_id << " of sender "
+		 << flow.stats.src_id << ": " << flow.stats.packets_acked
+		 << " packets, " << flow.stats.losses << " lost\n\tQueuing delay (ms): "
+		 << flow.queuing_delay.summary() << "\n\tInter-arrival time (ms): "
+		 << flow.inter_arrival.summary() << endl;
+	flows.queuing_delay.merge(flow.queuing_delay);
+	flows.inter_arrival.merge(flow.inter_arrival);
+	flows.num_ended++;
+	if (flow.slot >= 0)
+		LiveStats::instance()->close_slot(flow.slot, flow.stats);
+}
+
+// Counts 'header' in the statistics of its flow. A sender sends one flow
+// at a time, so a new flow of a sender ends its previous one.
+void count_packet(ReceiverFlows& flows, const TCPHeader& header,
+				  double cur_time) {
+	// the handshake
+	if (header.seq_num < 0)
+		return;
+
+	auto it = flows.active.find(header.src_id);
+	if (it != flows.active.end() &&
+		it->second.stats.flow_id != header.flow_id) {
+		end_flow(flows, it->second);
+		flows.active.erase(it);
+		it = flows.active.end();
+	}
+	if (it == flows.active.end())
+		it = flows.active.insert(make_pair(header.src_id,
+			ReceiverFlow(header, cur_time))).first;
+
+	ReceiverFlow& flow = it->second;
+	double one_way_delay = cur_time - header.sender_timestamp;
+	flow.min_one_way_delay = min(flow.min_one_way_delay, one_way_delay);
+	flow.queuing_delay.record(one_way_delay - flow.min_one_way_delay);
+	if (flow.stats.packets_acked > 0)
+		flow.inter_arrival.record(cur_time - flow.last_time);
+	flow.last_time = cur_time;
+
+	flow.stats.packets_acked++;
+	if (header.seq_num > flow.expected_seq)
+		flow.stats.losses += header.seq_num - flow.expected_seq;
+	flow.expected_seq = max(flow.expected_seq, header.seq_num + 1);
+	flow.stats.duration = cur_time - flow.first_time;
+	if (flow.slot >= 0)
+		LiveStats::instance()->publish(flow.slot, flow.stats);
+}
+
+// Ends the flows idle since 'idle_since' (ms)
+void end_idle_flows(ReceiverFlows& flows, double idle_since) {
+	for (auto it = flows.active.begin(); it != flows.active.end(); ) {
+		if (it->second.last_time <= idle_since) {
+			end_flow(flows, it->second);
+			it = flows.active.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+volatile sig_atomic_t stop_requested = 0;
+
+void request_stop(int) {
+	stop_requested = 1;
+}
+
 // For each packet received, acks back the pseudo TCP header with the 
-// current  timestamp
+// current  timestamp. Returns on SIGINT or SIGTERM.
 void echo_packets(UDPSocket &sender_socket) {
 	char buff[BUFFSIZE];
 	sockaddr_in sender_addr;
+	ReceiverFlows flows;
 
 	chrono::high_resolution_clock::time_point start_time_point = \
 		chrono::high_resolution_clock::now();
 
 	// int expected_seq = -1;
 
-	while (1) {
-		int received __attribute((unused)) = -1;
-		while (received == -1) {
-			//socket_lock.lock();
-				received = sender_socket.receivedata(buff, BUFFSIZE, -1, \
-					sender_addr);
-			//socket_lock.unlock();
-			assert( received != -1 );
+	while (!stop_requested) {
+		// Wake up now and then to end idle flows
+		int received __attribute((unused)) = sender_socket.receivedata(buff,
+			BUFFSIZE, flow_idle_timeout, sender_addr);
+		assert( received != -1 );
+		double cur_time = chrono::duration_cast<chrono::duration<double>>(
+			chrono::high_resolution_clock::now() - start_time_point
+		).count()*1000; //in milliseconds
+		if (received == 0) {
+			end_idle_flows(flows, cur_time - flow_idle_timeout);
+			continue;
 		}
 
 		TCPHeader *header = (TCPHeader*)buff;
@@ -89,21 +211,37 @@ void echo_packets(UDPSocket &sender_socket) {
 		// 	std::cout<<"Potential loss. Got "<< header->seq_num << " expected " << expected_seq << std::endl;
 		// }
 		// expected_seq = header->seq_num + 1;
-		header->receiver_timestamp = \
-			chrono::duration_cast<chrono::duration<double>>(
-				chrono::high_resolution_clock::now() - start_time_point
-			).count()*1000; //in milliseconds
+		header->receiver_timestamp = cur_time;
 
 		//socket_lock.lock();
 			sender_socket.senddata(buff, sizeof(TCPHeader), &sender_addr);
 		//socket_lock.unlock();
+
+		count_packet(flows, *header, cur_time);
 	}
+
+	end_idle_flows(flows, numeric_limits<double>::max());
+	if (flows.num_ended > 0)
+		cout << "All " << flows.num_ended << " flows\n\tQueuing delay (ms): "
+			 << flows.queuing_delay.summary()
+			 << "\n\tInter-arrival time (ms): "
+			 << flows.inter_arrival.summary() << endl;
 }
 
 int main(int argc, char* argv[]) {
 	int port = 8888;
-	if (argc == 2)
-		port = atoi(argv[1]);
+	for (int i = 1; i < argc; i++) {
+		string arg(argv[i]);
+		// live statistics, see live-stats.hh
+		if (arg.substr(0, 6) == "stats=")
+			LiveStats::enable(arg.substr(6), LiveStats::RECEIVER);
+		else
+			port = atoi(argv[i]);
+	}
+
+	// Report the flows in progress before exiting
+	signal(SIGINT, request_stop);
+	signal(SIGTERM, request_stop);
 
 	UDPSocket sender_socket;
 	sender_socket.bindsocket(port);
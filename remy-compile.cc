@@ -0,0 +1,55 @@
+// Compiles a RemyCC (a RemyBuffers::WhiskerTree) into the flat image that
+// senders map in place, see flat-whiskers.hh.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+#include "flat-whiskers.hh"
+
+using namespace std;
+
+int main( int argc, char *argv[] ) {
+	string ratname = "", outname = "";
+
+	for ( int i = 1; i < argc; i++ ) {
+		std::string arg( argv[ i ] );
+		if ( arg.substr( 0, 3 ) == "if=" )
+			ratname = arg.substr( 3 );
+		else if ( arg.substr( 0, 3 ) == "of=" )
+			outname = arg.substr( 3 );
+		else {
+			fprintf( stderr, "Unrecognised option '%s'.\n", arg.c_str() );
+			exit( 1 );
+		}
+	}
+
+	if ( ratname == "" || outname == "" ) {
+		fprintf( stderr, "Usage: remy-compile if=(ratname) of=(output filename)\n" );
+		exit( 1 );
+	}
+
+	int fd = open( ratname.c_str(), O_RDONLY );
+	if ( fd < 0 ) {
+		perror( "open" );
+		exit( 1 );
+	}
+	RemyBuffers::WhiskerTree tree;
+	if ( !tree.ParseFromFileDescriptor( fd ) ) {
+		fprintf( stderr, "Could not parse %s.\n", ratname.c_str() );
+		exit( 1 );
+	}
+	close( fd );
+
+	if ( !FlatWhiskerTree::compile( tree, outname ) )
+		exit( 1 );
+
+	// Check that the result loads
+	FlatWhiskerTree flat;
+	if ( !flat.load( outname ) )
+		exit( 1 );
+	fprintf( stderr, "Wrote %u nodes to %s.\n", flat.num_nodes(), outname.c_str() );
+	return 0;
+}
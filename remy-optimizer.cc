@@ -0,0 +1,394 @@
+// Trains a RemyCC whisker tree on simulated networks, the way Remy does:
+// the most used whisker of the tree is replaced by the best of its
+// next_generation() alternatives until none of them improves the score,
+// every whisker is improved once per generation, and at the end of each
+// generation the most used whisker is bisected at the median of the
+// memory values it saw. The score is Remy's objective, the mean over all
+// senders of log(throughput) - delta * log(delay), with throughput as a
+// fraction of the link rate and delay as a multiple of the RTT of an empty
+// network.
+//
+// The networks are a grid of dumbbells given by repeating 'linkrate',
+// 'rtt' and 'num_senders' (as for ccsweep), each run with 'runs' seeds.
+// Every candidate whisker is scored on every network by an independent
+// simulation with its own copy of the tree, and the candidates x networks
+// simulations of a step are spread over all hardware threads (or
+// threads=). Only the pass that counts whisker usage is sequential, since
+// the median trackers of a tree cannot be merged, and it is one
+// simulation per network among the hundreds of a step.
+//
+// The search space of each action is the 'optimizer' settings of the 'if='
+// tree, or Whisker::get_optimizer() for what it does not set, and is
+// written back with the tree. Whiskers whose actions lie outside it are
+// left as they are.
+//
+// The tree is written to 'of' in the RemyBuffers::WhiskerTree format
+// after every improvement, so an interrupted run keeps its progress and
+// the result can be used with 'if=' by the sender, ccsim or ccsweep.
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+#include "dumbbell.hh"
+#include "remycc.hh"
+#include "simulator.hh"
+#include "thread-pool.hh"
+
+using namespace std;
+
+// see configs.hh for details
+double TRAINING_LINK_RATE = 4000000.0/1500.0;
+bool LINK_LOGGING = false;
+std::string LINK_LOGGING_FILENAME;
+
+// Throughputs are clamped to this fraction of the link rate, so that a
+// starved sender costs a lot but not an infinite amount
+const double min_throughput = 1e-4;
+
+struct Score {
+  double utility_sum;
+  int num_senders;
+
+  Score() : utility_sum(0), num_senders(0) {}
+  Score& operator+=(const Score& other) {
+    utility_sum += other.utility_sum;
+    num_senders += other.num_senders;
+    return *this;
+  }
+  double get() const { return num_senders ? utility_sum / num_senders : -INFINITY; }
+};
+
+// Runs 'config' with every sender using 'tree' itself (see RemyCC), and
+// returns the senders' utility
+Score evaluate(WhiskerTree& tree, const DumbbellConfig& config, double delta,
+               bool track) {
+  Simulator sim;
+  int link = sim.add_link(config.link_rate, config.delay,
+                          make_dumbbell_queue(config));
+  for (int i = 0; i < config.num_senders; ++i)
+    sim.add_sender<RemyCC>(dumbbell_sender_config(config, link, i), tree, track);
+  sim.run(config.duration);
+
+  Score score;
+  for (int i = 0; i < sim.get_num_senders(); ++i) {
+    const SimSender& sender = sim.get_sender(i);
+    if (sender.get_active_time(sim.now()) <= 0)
+      continue;
+    double tput = max(min_throughput,
+                      sender.get_throughput(sim.now()) / config.link_rate);
+    double delay = 1;
+    if (sender.get_stats().pkts_acked > 0)
+      delay = sender.get_avg_rtt() / sim.base_rtt(sender.get_config());
+    score.utility_sum += log(tput) - delta * log(delay);
+    ++ score.num_senders;
+  }
+  return score;
+}
+
+class Optimizer {
+  vector<DumbbellConfig> networks;
+  double delta;
+  Whisker::OptimizationSettings settings;
+  ThreadPool pool;
+  string outname;
+  long num_sims;
+
+  void write_dna(const WhiskerTree& tree) const;
+  double improve_whisker(WhiskerTree& tree, const Whisker& whisker,
+                         double score, unsigned generation);
+
+ public:
+  Optimizer(const vector<DumbbellConfig>& networks, double delta,
+            const Whisker::OptimizationSettings& settings, int num_threads,
+            const string& outname)
+    : networks(networks), delta(delta), settings(settings), pool(num_threads),
+      outname(outname), num_sims(0)
+  {}
+
+  // Scores 'tree' on every network and counts whisker usage (and memory
+  // medians) in it
+  double track_usage(WhiskerTree& tree);
+  void run(WhiskerTree& tree, unsigned num_generations);
+};
+
+void Optimizer::write_dna(const WhiskerTree& tree) const {
+  RemyBuffers::WhiskerTree dna = tree.DNA();
+  RemyBuffers::ConfigRange* range = dna.mutable_config();
+  double min_rate = INFINITY, max_rate = 0, min_rtt = INFINITY, max_rtt = 0;
+  int min_senders = INT_MAX, max_senders = 0;
+  for (const DumbbellConfig& c : networks) {
+    min_rate = min(min_rate, c.link_rate / 1000);
+    max_rate = max(max_rate, c.link_rate / 1000);
+    min_rtt = min(min_rtt, 2 * c.delay);
+    max_rtt = max(max_rtt, 2 * c.delay);
+    min_senders = min(min_senders, c.num_senders);
+    max_senders = max(max_senders, c.num_senders);
+  }
+  range->mutable_link_packets_per_ms()->set_low(min_rate);
+  range->mutable_link_packets_per_ms()->set_high(max_rate);
+  range->mutable_rtt()->set_low(min_rtt);
+  range->mutable_rtt()->set_high(max_rtt);
+  range->mutable_num_senders()->set_low(min_senders);
+  range->mutable_num_senders()->set_high(max_senders);
+  dna.mutable_optimizer()->CopyFrom(settings.DNA());
+
+  // Write to a temporary file first so that a reader never sees half a tree
+  string tmpname = outname + ".tmp";
+  int fd = open(tmpname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("open");
+    exit(1);
+  }
+  if (!dna.SerializeToFileDescriptor(fd)) {
+    fprintf(stderr, "Could not write %s.\n", tmpname.c_str());
+    exit(1);
+  }
+  close(fd);
+  if (rename(tmpname.c_str(), outname.c_str()) < 0) {
+    perror("rename");
+    exit(1);
+  }
+}
+
+double Optimizer::track_usage(WhiskerTree& tree) {
+  tree.reset_counts();
+  Score score;
+  for (const DumbbellConfig& network : networks)
+    score += evaluate(tree, network, delta, true);
+  num_sims += networks.size();
+  return score.get();
+}
+
+// Tries the alternatives of 'whisker' (whose tree scores 'score'), moving
+// to the best one as long as it helps, as in Remy's RatBreeder. Puts the
+// best whisker found in 'tree' and returns its score.
+double Optimizer::improve_whisker(WhiskerTree& tree, const Whisker& whisker,
+                                  double score, unsigned generation) {
+  unordered_map<Whisker, double, boost::hash<Whisker> > evaluated;
+  Whisker best(whisker);
+  double best_score = score;
+  if (!best.eligible(settings)) {
+    fprintf(stderr, "  Its actions are outside the search space; skipping it\n");
+    best.demote(generation + 1);
+    tree.replace(best);
+    return best_score;
+  }
+  evaluated.emplace(best, best_score);
+
+  while (true) {
+    vector<Whisker> candidates;
+    for (const Whisker& alt : best.next_generation(settings))
+      if (evaluated.count(alt) == 0) {
+        evaluated.emplace(alt, -INFINITY);
+        candidates.push_back(alt);
+      }
+    if (candidates.empty())
+      break;
+
+    vector<WhiskerTree> trees(candidates.size(), tree);
+    for (size_t i = 0; i < candidates.size(); ++i)
+      trees[i].replace(candidates[i]);
+
+    // One task per (candidate, network). Each task simulates on its own
+    // copy of the tree, since whisker usage counts are updated in place.
+    size_t num_networks = networks.size();
+    vector<Score> scores(candidates.size() * num_networks);
+    auto start = chrono::steady_clock::now();
+    pool.run(scores.size(), [&](size_t task) {
+      WhiskerTree copy(trees[task / num_networks]);
+      scores[task] = evaluate(copy, networks[task % num_networks], delta, false);
+    });
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    num_sims += scores.size();
+
+    int best_candidate = -1;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      Score total;
+      for (size_t n = 0; n < num_networks; ++n)
+        total += scores[i * num_networks + n];
+      evaluated[candidates[i]] = total.get();
+      if (total.get() > best_score) {
+        best_score = total.get();
+        best_candidate = i;
+      }
+    }
+    fprintf(stderr, "  %lu candidates x %lu networks in %.2f s (%.1f sims/s), best %.5f\n",
+            candidates.size(), num_networks, secs, scores.size() / secs,
+            best_score);
+    if (best_candidate < 0)
+      break;
+    best = candidates[best_candidate];
+  }
+
+  // Done with this whisker for this generation
+  best.demote(generation + 1);
+  tree.replace(best);
+  return best_score;
+}
+
+void Optimizer::run(WhiskerTree& tree, unsigned num_generations) {
+  auto start = chrono::steady_clock::now();
+  unsigned generation = 0;
+  while (generation < num_generations) {
+    double score = track_usage(tree);
+    const Whisker* whisker = tree.most_used(generation);
+    if (whisker != nullptr) {
+      fprintf(stderr, "Generation %u, score %.5f: improving %s\n", generation,
+              score, whisker->str(tree.total_whisker_queries()).c_str());
+      Whisker to_improve(*whisker);
+      improve_whisker(tree, to_improve, score, generation);
+      write_dna(tree);
+      continue;
+    }
+
+    // Every whisker was improved in this generation: split the most used
+    // one and start the next
+    whisker = tree.most_used(UINT_MAX);
+    if (whisker != nullptr) {
+      WhiskerTree bisected(*whisker, true);
+      if (bisected.num_children() > 1) {
+        Whisker to_split(*whisker);
+        tree.replace(to_split, bisected);
+        fprintf(stderr, "Split %s into %u\n", to_split.domain().str().c_str(),
+                bisected.num_children());
+      }
+    }
+    write_dna(tree);
+    ++ generation;
+    fprintf(stderr, "Finished generation %u: score %.5f, %ld simulations in %.0f s\n",
+            generation, score, num_sims,
+            chrono::duration<double>(chrono::steady_clock::now() - start).count());
+  }
+}
+
+int main(int argc, char* argv[]) {
+  vector<double> link_rates, rtts;
+  vector<int> num_senders;
+  DumbbellConfig base;
+  string ratname = "", outname = "", buffer = "1bdp";
+  double delta = 1;
+  int runs = 1, num_threads = 0;
+  unsigned num_generations = 5;
+
+  base.cctypes = {"remy"};
+  base.duration = 10000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg.substr(0, 9) == "linkrate=")
+      link_rates.push_back(atof(arg.substr(9).c_str()));
+    else if (arg.substr(0, 4) == "rtt=")
+      rtts.push_back(atof(arg.substr(4).c_str()));
+    else if (arg.substr(0, 12) == "num_senders=")
+      num_senders.push_back(atoi(arg.substr(12).c_str()));
+    else if (arg.substr(0, 7) == "buffer=")
+      buffer = arg.substr(7);
+    else if (arg.substr(0, 3) == "if=")
+      ratname = arg.substr(3);
+    else if (arg.substr(0, 3) == "of=")
+      outname = arg.substr(3);
+    else if (arg.substr(0, 6) == "delta=")
+      delta = atof(arg.substr(6).c_str());
+    else if (arg.substr(0, 9) == "duration=")
+      base.duration = atof(arg.substr(9).c_str());
+    else if (arg.substr(0, 11) == "onduration=")
+      base.onduration = atof(arg.substr(11).c_str());
+    else if (arg.substr(0, 12) == "offduration=")
+      base.offduration = atof(arg.substr(12).c_str());
+    else if (arg.substr(0, 15) == "traffic_params=")
+      base.traffic_params = arg.substr(15);
+    else if (arg.substr(0, 12) == "generations=")
+      num_generations = atoi(arg.substr(12).c_str());
+    else if (arg.substr(0, 5) == "runs=")
+      runs = atoi(arg.substr(5).c_str());
+    else if (arg.substr(0, 8) == "threads=")
+      num_threads = atoi(arg.substr(8).c_str());
+    else {
+      fprintf(stderr, "Unrecognised option '%s'.\n", arg.c_str());
+      fprintf(stderr, "Usage: remy-optimizer of=(output ratname) [if=(initial ratname)] [linkrate=(packets/sec)]... [rtt=(ms)]... [num_senders=]... [buffer=(packets)|(x)bdp] [delta=] [duration=(ms)] [onduration=] [offduration=] [traffic_params=] [runs=] [generations=] [threads=]\n");
+      exit(1);
+    }
+  }
+
+  if (outname == "") {
+    fprintf(stderr, "Please specify the output file using of=<filename>\n");
+    exit(1);
+  }
+  if (link_rates.empty()) link_rates.push_back(base.link_rate);
+  if (rtts.empty()) rtts.push_back(2 * base.delay);
+  if (num_senders.empty()) num_senders.push_back(2);
+  if (runs < 1) {
+    fprintf(stderr, "runs must be at least 1.\n");
+    exit(1);
+  }
+
+  vector<DumbbellConfig> networks;
+  for (double link_rate : link_rates)
+    for (double rtt : rtts)
+      for (int n : num_senders)
+        for (int run = 0; run < runs; ++run) {
+          DumbbellConfig config(base);
+          config.link_rate = link_rate;
+          config.delay = rtt / 2;
+          config.num_senders = n;
+          config.seed = base.seed + run * 1000;
+          if (buffer.size() > 3 && buffer.substr(buffer.size() - 3) == "bdp")
+            config.buffer = max(1, int(atof(buffer.c_str()) * link_rate * rtt / 1000));
+          else
+            config.buffer = atoi(buffer.c_str());
+          if (link_rate <= 0 || rtt <= 0 || n < 1 ||
+              make_dumbbell_queue(config) == nullptr) {
+            fprintf(stderr, "Need positive link rates, RTTs, numbers of senders and buffers.\n");
+            exit(1);
+          }
+          networks.push_back(config);
+        }
+
+  WhiskerTree whiskers;
+  Whisker::OptimizationSettings settings = Whisker::get_optimizer();
+  if (ratname != "") {
+    int fd = open(ratname.c_str(), O_RDONLY);
+    if (fd < 0) {
+      perror("open");
+      exit(1);
+    }
+    RemyBuffers::WhiskerTree tree;
+    if (!tree.ParseFromFileDescriptor(fd)) {
+      fprintf(stderr, "Could not parse %s.\n", ratname.c_str());
+      exit(1);
+    }
+    close(fd);
+    if (dna_memory_type(tree) != Memory::type) {
+      fprintf(stderr, "%s is of memory type %s, but remy-optimizer was built "
+              "for %s (see configs.hh).\n", ratname.c_str(),
+              memory_type_name(dna_memory_type(tree)),
+              memory_type_name(Memory::type));
+      exit(1);
+    }
+    whiskers = WhiskerTree(tree);
+    if (tree.has_optimizer())
+      settings.set_from_DNA(tree.optimizer());
+  }
+
+  // RemyCC prints diagnostics on init()
+  cout.setstate(ios::badbit);
+  Optimizer optimizer(networks, delta, settings, num_threads, outname);
+  fprintf(stderr, "Training on %lu networks with %d threads\n",
+          networks.size(), ThreadPool(num_threads).get_num_threads());
+  optimizer.run(whiskers, num_generations);
+  fprintf(stderr, "Final score %.5f; wrote %s\n", optimizer.track_usage(whiskers),
+          outname.c_str());
+  return 0;
+}
@@ -1,10 +1,12 @@
 #include "remycc.hh"
 
-double RemyCC::current_timestamp( void ){
+template < typename MemoryType >
+double BasicRemyCC< MemoryType >::current_timestamp( void ){
 	return cur_tick;
 }
 
-void RemyCC::init( void ){
+template < typename MemoryType >
+void BasicRemyCC< MemoryType >::init( void ){
 	flow_id = 0;
 	start_time_point = std::chrono::high_resolution_clock::now();
 	rat.reset( current_timestamp() );
@@ -12,7 +14,8 @@ void RemyCC::init( void ){
 	_intersend_time = 0;
 }
 
-void RemyCC::onACK(int ack, double receiver_timestamp, double sender_timestamp __attribute((unused))){
+template < typename MemoryType >
+void BasicRemyCC< MemoryType >::onACK(int ack, double receiver_timestamp, double sender_timestamp __attribute((unused))){
 	int seq_num = ack - 1;
 	//assert( unacknowledged_packets.count( seq_num ) > 0);
 	if ( unacknowledged_packets.count( seq_num ) > 1 ) { std::cerr<<"Dupack: "<<seq_num<<std::endl; return; }
@@ -31,26 +34,50 @@ void RemyCC::onACK(int ack, double receiver_timestamp, double sender_timestamp _
 	if ( measured_link_rate > 0 ){
 		// normalize w.r.t NUM_PACKETS_PER_LINK_RATE_MEASUREMENT because this 
 		// function is called only once for each group of NUM_PACKETS_PER_LINK_RATE_MEASUREMENT
-		rat.packets_received( temp_packets, 1 * TRAINING_LINK_RATE / measured_link_rate );
+		packets_received( temp_packets, 1 * TRAINING_LINK_RATE / measured_link_rate );
 		_the_window = rat.cur_window_size() * measured_link_rate / TRAINING_LINK_RATE;
 		_intersend_time = rat.cur_intersend_time() * TRAINING_LINK_RATE / measured_link_rate;
 	}
 	else {
-		rat.packets_received( temp_packets, 1.0 );
+		packets_received( temp_packets, 1.0 );
 		_the_window = rat.cur_window_size();
 		_intersend_time = rat.cur_intersend_time();
 	}
 #else
-	rat.packets_received( temp_packets, 1.0 );
+	packets_received( temp_packets, 1.0 );
 	_the_window = rat.cur_window_size();
 	_intersend_time = rat.cur_intersend_time();
 #endif
 }
 
-void RemyCC::onLinkRateMeasurement( double s_measured_link_rate ){
+template < typename MemoryType >
+void BasicRemyCC< MemoryType >::packets_received( const std::vector< Packet > & packets, const double link_rate_normalizing_factor ){
+	if ( !live ) {
+		rat.packets_received( packets, link_rate_normalizing_factor );
+		return;
+	}
+	// The version cannot be freed until the guard goes, even if a newer
+	// one is published meanwhile
+	typename RcuCell< typename LiveWhiskerTree< MemoryType >::Version >::ReadGuard version( live->versions(), live_slot );
+	if ( version->flat.loaded() )
+		rat.set_whiskers( version->flat );
+	else
+		rat.set_whiskers( version->tree );
+	rat.packets_received( packets, link_rate_normalizing_factor );
+	// Do not keep a pointer into the version past the guard
+	rat.set_whiskers( tree );
+}
+
+template < typename MemoryType >
+void BasicRemyCC< MemoryType >::onLinkRateMeasurement( double s_measured_link_rate ){
 	measured_link_rate = s_measured_link_rate;
 }
 
-void RemyCC::onPktSent(int seq_num){
+template < typename MemoryType >
+void BasicRemyCC< MemoryType >::onPktSent(int seq_num){
 	unacknowledged_packets[seq_num] = current_timestamp();
 }
+
+template class BasicRemyCC< MemoryDefault >;
+template class BasicRemyCC< MemoryWithLossSignal >;
+template class BasicRemyCC< MemoryWithoutSlowRewma >;
@@ -1,6 +1,7 @@
 #ifndef REMYCC_HH
 #define REMYCC_HH
 
+#include <cassert>
 #include <chrono>
 #include <unordered_map>
 #include <vector>
@@ -10,12 +11,21 @@
 #include "configs.hh"
 #include "rat.hh"
 #include "whiskertree.hh"
+#include "flat-whiskers.hh"
+#include "live-whiskers.hh"
 #include "packet.hh"
 
-class RemyCC: public CCC {
+template < typename MemoryType >
+class BasicRemyCC: public CCC {
+public:
+	typedef BasicWhiskerTree< MemoryType > WhiskerTree;
+
 private:
 	WhiskerTree tree;
-	Rat rat;
+	BasicRat< MemoryType > rat;
+	// If set, every ACK is looked up in its current version
+	LiveWhiskerTree< MemoryType > * live;
+	int live_slot;
 
 	std::chrono::high_resolution_clock::time_point start_time_point;
 	std::unordered_map<int, double> unacknowledged_packets;
@@ -26,6 +36,8 @@ private:
 
 	double measured_link_rate;
 
+	void packets_received( const std::vector< Packet > & packets, const double link_rate_normalizing_factor );
+
 protected:
 
 public:
@@ -37,13 +49,60 @@ public:
 	virtual void onLinkRateMeasurement( double s_measured_link_rate ) override;
 	void set_timestamp(double s_cur_tick) {cur_tick = s_cur_tick;}
 
-	RemyCC( WhiskerTree & s_tree ) 
-	  : 	tree( s_tree ), rat( tree ), start_time_point(), unacknowledged_packets(), flow_id( 0 ), cur_tick( 0 ), measured_link_rate( -1 ) 
+	// The tree looked up in. Not for compiled or live trees: a live one
+	// may be freed as soon as the ACK that looked it up is processed.
+	const WhiskerTree & whiskers( void ) const { assert( !live ); return rat.whiskers(); }
+	// See BasicRat::set_profile
+	void set_profile( WhiskerProfile & profile ) { rat.set_profile( profile ); }
+
+	BasicRemyCC( WhiskerTree & s_tree ) 
+	  : 	tree( s_tree ), rat( tree ), live( nullptr ), live_slot( -1 ), start_time_point(), unacknowledged_packets(), flow_id( 0 ), cur_tick( 0 ), measured_link_rate( -1 ) 
+	{
+		_the_window = 2;
+		_intersend_time = 0;
+		_timeout = 1000;
+	}
+
+	// For training: uses 's_shared_tree' itself rather than a copy, so
+	// that all the senders of a simulation count whisker usage in one
+	// tree, and with 's_track' also records the memory values each whisker
+	// sees (for bisecting it). The tree must outlive the controller.
+	BasicRemyCC( WhiskerTree & s_shared_tree, const bool s_track )
+	  : 	tree(), rat( s_shared_tree, s_track ), live( nullptr ), live_slot( -1 ), start_time_point(), unacknowledged_packets(), flow_id( 0 ), cur_tick( 0 ), measured_link_rate( -1 )
+	{
+		_the_window = 2;
+		_intersend_time = 0;
+		_timeout = 1000;
+	}
+
+	// Queries a compiled tree (see flat-whiskers.hh) of MemoryType in
+	// place. The tree must outlive the controller.
+	BasicRemyCC( const FlatWhiskerTree & s_flat )
+	  : 	tree(), rat( s_flat ), live( nullptr ), live_slot( -1 ), start_time_point(), unacknowledged_packets(), flow_id( 0 ), cur_tick( 0 ), measured_link_rate( -1 )
+	{
+		_the_window = 2;
+		_intersend_time = 0;
+		_timeout = 1000;
+	}
+
+	// Follows 's_live', so that its tree can be replaced while flows are
+	// running. It must outlive the controller.
+	BasicRemyCC( LiveWhiskerTree< MemoryType > & s_live )
+	  : 	tree(), rat( tree ), live( &s_live ), live_slot( s_live.register_reader() ), start_time_point(), unacknowledged_packets(), flow_id( 0 ), cur_tick( 0 ), measured_link_rate( -1 )
 	{
+		if ( live_slot < 0 ) {
+			std::cerr << "Too many controllers share a live whisker tree" << std::endl;
+			exit( 1 );
+		}
 		_the_window = 2;
 		_intersend_time = 0;
 		_timeout = 1000;
 	}
+
+	BasicRemyCC( const BasicRemyCC & ) = delete;
+	BasicRemyCC & operator=( const BasicRemyCC & ) = delete;
 };
 
+typedef BasicRemyCC< Memory > RemyCC;
+
 #endif
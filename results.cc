@@ -0,0 +1,205 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+
+#include "results.hh"
+
+static std::unique_ptr<ResultLog> process_results;
+
+ResultRecord::ResultRecord(const char* type) : text() {
+  text = "{";
+  add("type", type);
+}
+
+void ResultRecord::key(const char* name) {
+  if (text.size() > 1)
+    text += ",";
+  text += "\"";
+  text += name;
+  text += "\":";
+}
+
+ResultRecord& ResultRecord::add(const char* name, double value) {
+  key(name);
+  // JSON has no infinities or NaN
+  if (!std::isfinite(value)) {
+    text += "null";
+    return *this;
+  }
+  // Counts and ids exactly, the rest (eg. Unix times) to 15 digits
+  char buf[32];
+  if (value == std::trunc(value) && std::fabs(value) < 1e15)
+    snprintf(buf, sizeof(buf), "%.0f", value);
+  else
+    snprintf(buf, sizeof(buf), "%.15g", value);
+  text += buf;
+  return *this;
+}
+
+ResultRecord& ResultRecord::add(const char* name, const std::string& value) {
+  key(name);
+  text += "\"";
+  for (unsigned char c : value) {
+    if (c == '"' || c == '\\') {
+      text += '\\';
+      text += c;
+    }
+    else if (c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      text += buf;
+    }
+    else
+      text += c;
+  }
+  text += "\"";
+  return *this;
+}
+
+ResultLog::~ResultLog() {
+  if (fclose(file) != 0)
+    perror("fclose");
+}
+
+void ResultLog::enable(const std::string& filename, int argc, char* argv[]) {
+  FILE* file = fopen(filename.c_str(), "w");
+  if (file == nullptr) {
+    perror(filename.c_str());
+    exit(1);
+  }
+  process_results.reset(new ResultLog(file));
+
+  ResultRecord run("run");
+  run.add("start_time", std::chrono::duration_cast<std::chrono::duration<double>>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+  run.add("pid", getpid());
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    size_t eq = arg.find('=');
+    if (eq != std::string::npos && eq > 0 && arg.substr(0, eq) != "type")
+      run.add(arg.substr(0, eq).c_str(), arg.substr(eq + 1));
+  }
+  process_results->write(run);
+}
+
+ResultLog* ResultLog::instance() {
+  return process_results.get();
+}
+
+void ResultLog::write(const ResultRecord& record) {
+  std::string line = record.line();
+  std::lock_guard<std::mutex> guard(lock);
+  if (fwrite(line.data(), 1, line.size(), file) != line.size() ||
+      fflush(file) != 0)
+    perror("results");
+}
+
+static const char* skip_space(const char* p, const char* end) {
+  while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+    p++;
+  return p;
+}
+
+// A string from the opening quote at p; returns the position after the
+// closing quote, or nullptr
+static const char* parse_string(const char* p, const char* end,
+                                std::string& out) {
+  out.clear();
+  if (p == end || *p != '"')
+    return nullptr;
+  for (p++; p != end; p++) {
+    if (*p == '"')
+      return p + 1;
+    if (*p != '\\') {
+      out += *p;
+      continue;
+    }
+    if (++p == end)
+      return nullptr;
+    switch (*p) {
+    case 'b': out += '\b'; break;
+    case 'f': out += '\f'; break;
+    case 'n': out += '\n'; break;
+    case 'r': out += '\r'; break;
+    case 't': out += '\t'; break;
+    case 'u': {
+      if (end - p < 5)
+        return nullptr;
+      unsigned c = strtoul(std::string(p + 1, 4).c_str(), nullptr, 16);
+      // As UTF-8, without surrogate pairs
+      if (c < 0x80)
+        out += char(c);
+      else if (c < 0x800) {
+        out += char(0xc0 | (c >> 6));
+        out += char(0x80 | (c & 0x3f));
+      }
+      else {
+        out += char(0xe0 | (c >> 12));
+        out += char(0x80 | ((c >> 6) & 0x3f));
+        out += char(0x80 | (c & 0x3f));
+      }
+      p += 4;
+      break;
+    }
+    default: out += *p;
+    }
+  }
+  return nullptr;
+}
+
+static bool parse_fields(const char* begin, const char* end,
+                         ResultFields& fields, size_t& n) {
+  const char* p = skip_space(begin, end);
+  if (p == end || *p != '{')
+    return false;
+  p = skip_space(p + 1, end);
+  if (p != end && *p == '}')
+    return skip_space(p + 1, end) == end;
+  while (true) {
+    if (n == fields.size())
+      fields.emplace_back();
+    p = parse_string(p, end, fields[n++].first);
+    if (p == nullptr)
+      return false;
+    p = skip_space(p, end);
+    if (p == end || *p != ':')
+      return false;
+    p = skip_space(p + 1, end);
+    std::string& value = fields[n - 1].second;
+    if (p != end && *p == '"') {
+      p = parse_string(p, end, value);
+      if (p == nullptr)
+        return false;
+    }
+    else {
+      // A number, true, false or null
+      const char* q = p;
+      while (q != end && *q != ',' && *q != '}' && *q != ' ')
+        q++;
+      if (q == p)
+        return false;
+      value.assign(p, q);
+      p = q;
+    }
+    p = skip_space(p, end);
+    if (p == end)
+      return false;
+    if (*p == '}')
+      return skip_space(p + 1, end) == end;
+    if (*p != ',')
+      return false;
+    p = skip_space(p + 1, end);
+  }
+}
+
+bool parse_result(const char* begin, const char* end, ResultFields& fields) {
+  // The strings of 'fields' are reused, as most lines have the same
+  // fields
+  size_t n = 0;
+  bool ok = parse_fields(begin, end, fields, n);
+  fields.resize(n);
+  return ok;
+}
@@ -0,0 +1,58 @@
+#ifndef RESULTS_HH
+#define RESULTS_HH
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Results of a run as newline-delimited JSON, for ccresults to aggregate
+// instead of parsing the text the sender prints. The first record of a
+// file is of type "run" and has the sender's options as strings; then
+// there is a record of type "flow" per flow, written as it ends. Records
+// are flat objects of numbers and strings.
+
+// Builds one record
+class ResultRecord {
+  std::string text;
+
+  void key(const char* name);
+
+ public:
+  explicit ResultRecord(const char* type);
+  ResultRecord& add(const char* name, double value);
+  ResultRecord& add(const char* name, const std::string& value);
+  // The record, ending in a newline
+  std::string line() const { return text + "}\n"; }
+};
+
+class ResultLog {
+  FILE* file;
+  std::mutex lock;
+
+  explicit ResultLog(FILE* file) : file(file), lock() {}
+
+ public:
+  ~ResultLog();
+  ResultLog(const ResultLog&) = delete;
+  ResultLog& operator=(const ResultLog&) = delete;
+
+  // Writes the run record, with the 'key=value' arguments as fields, to a
+  // new 'filename'. Exits on failure.
+  static void enable(const std::string& filename, int argc, char* argv[]);
+  // nullptr unless enabled
+  static ResultLog* instance();
+
+  // Written whole and flushed, so that a run that is killed leaves a
+  // file of whole records
+  void write(const ResultRecord& record);
+};
+
+// The fields of a record, with strings unescaped and numbers as they
+// were written. Parses the objects ResultRecord writes; false for
+// anything else (eg. a line cut short).
+typedef std::vector<std::pair<std::string, std::string>> ResultFields;
+bool parse_result(const char* begin, const char* end, ResultFields& fields);
+
+#endif
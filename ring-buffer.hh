@@ -0,0 +1,168 @@
+#ifndef RING_BUFFER_HH
+#define RING_BUFFER_HH
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include <type_traits>
+
+// A double-ended queue backed by one contiguous, cache-line-aligned array,
+// used as the storage of the sliding-window estimators. Unlike std::deque
+// or std::list it does not allocate as elements come and go: the capacity
+// is fixed at construction (rounded up to a power of two so indexing is a
+// mask). If a window ever outgrows it, push_back doubles the capacity
+// instead of dropping data so the estimators keep their exact semantics,
+// but in steady state nothing is allocated.
+//
+// Index 0 is the oldest element (front) and size()-1 the newest (back).
+// Only trivially destructible types are supported, since elements are
+// never destroyed individually.
+template <class T>
+class RingBuffer {
+  static_assert(std::is_trivially_destructible<T>::value,
+                "RingBuffer only holds trivially destructible types");
+  static constexpr size_t cache_line_size = 64;
+
+  T* buf;
+  size_t mask;
+  size_t head;
+  size_t count;
+
+  static T* allocate(size_t capacity) {
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, cache_line_size, capacity * sizeof(T)) != 0)
+      throw std::bad_alloc();
+    return static_cast<T*>(ptr);
+  }
+
+  static size_t round_up(size_t capacity) {
+    size_t res = 1;
+    while (res < capacity)
+      res *= 2;
+    return res;
+  }
+
+  void grow() {
+    T* new_buf = allocate(2 * (mask + 1));
+    for (size_t i = 0; i < count; ++i)
+      new (&new_buf[i]) T((*this)[i]);
+    free(buf);
+    buf = new_buf;
+    mask = 2 * (mask + 1) - 1;
+    head = 0;
+  }
+
+ public:
+  class const_iterator {
+    const RingBuffer* ring;
+    size_t index;
+
+   public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    const_iterator(const RingBuffer* ring, size_t index)
+      : ring(ring), index(index) {}
+
+    reference operator*() const { return (*ring)[index]; }
+    pointer operator->() const { return &(*ring)[index]; }
+    const_iterator& operator++() { ++ index; return *this; }
+    const_iterator& operator--() { -- index; return *this; }
+    const_iterator operator++(int) { const_iterator res(*this); ++ index; return res; }
+    const_iterator operator--(int) { const_iterator res(*this); -- index; return res; }
+    bool operator==(const const_iterator& other) const { return index == other.index; }
+    bool operator!=(const const_iterator& other) const { return index != other.index; }
+  };
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  explicit RingBuffer(size_t capacity = 64)
+    : buf(allocate(round_up(capacity))),
+      mask(round_up(capacity) - 1),
+      head(0),
+      count(0)
+  {}
+
+  RingBuffer(const RingBuffer& other)
+    : buf(allocate(other.mask + 1)),
+      mask(other.mask),
+      head(0),
+      count(other.count)
+  {
+    for (size_t i = 0; i < count; ++i)
+      new (&buf[i]) T(other[i]);
+  }
+
+  RingBuffer& operator=(const RingBuffer& other) {
+    if (this == &other)
+      return *this;
+    RingBuffer tmp(other);
+    std::swap(buf, tmp.buf);
+    std::swap(mask, tmp.mask);
+    std::swap(head, tmp.head);
+    std::swap(count, tmp.count);
+    return *this;
+  }
+
+  ~RingBuffer() { free(buf); }
+
+  void push_back(const T& val) {
+    if (count == mask + 1)
+      grow();
+    new (&buf[(head + count) & mask]) T(val);
+    ++ count;
+  }
+
+  void pop_front() {
+    assert(count > 0);
+    head = (head + 1) & mask;
+    -- count;
+  }
+
+  void pop_back() {
+    assert(count > 0);
+    -- count;
+  }
+
+  const T& operator[](size_t i) const { return buf[(head + i) & mask]; }
+  T& operator[](size_t i) { return buf[(head + i) & mask]; }
+  const T& front() const { assert(count > 0); return buf[head]; }
+  T& front() { assert(count > 0); return buf[head]; }
+  const T& back() const { assert(count > 0); return (*this)[count - 1]; }
+  T& back() { assert(count > 0); return (*this)[count - 1]; }
+
+  size_t size() const { return count; }
+  size_t capacity() const { return mask + 1; }
+  bool empty() const { return count == 0; }
+  void clear() { head = count = 0; }
+
+  // Calls f(ptr, n) on the (at most two) contiguous runs of memory that
+  // hold elements [first, last), in order. Lets hot loops over a window
+  // run over plain arrays the compiler can vectorize.
+  template <class F>
+  void for_each_segment(size_t first, size_t last, F f) const {
+    assert(first <= last && last <= count);
+    if (first == last)
+      return;
+    size_t start = (head + first) & mask;
+    size_t n = last - first;
+    size_t till_wrap = mask + 1 - start;
+    if (n <= till_wrap)
+      f(&buf[start], n);
+    else {
+      f(&buf[start], till_wrap);
+      f(&buf[0], n - till_wrap);
+    }
+  }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, count); }
+  const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+  const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+};
+
+#endif // RING_BUFFER_HH
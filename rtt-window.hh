@@ -1,6 +1,10 @@
-#include <deque>
+#ifndef RTT_WINDOW_HH
+#define RTT_WINDOW_HH
+
 #include <tuple>
 
+#include "ring-buffer.hh"
+
 // Private class: Find extreme value in window
 class ExtremeWindow {
   // Whether to find minimum or maximum
@@ -11,7 +15,7 @@ class ExtremeWindow {
   // enough measurements to answer specific query (eg. min. RTT in given
   // window). Thus storing only the monotonically increasing (or decreasing of
   // find_min=false)subset of RTTs is enough.
-  std::deque<std::pair<double, double>> vals;
+  RingBuffer<std::pair<double, double>> vals;
   // Computed extreme value
   double extreme;
 
@@ -48,3 +52,5 @@ class RTTWindow {
   double get_latest_rtt() const;
   bool is_copa() const;
 };
+
+#endif
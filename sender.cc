@@ -1,5 +1,6 @@
 #include <chrono>
 #include <fcntl.h>
+#include <memory>
 
 #include "congctrls.hh"
 #include "remycc.hh"
@@ -10,16 +11,64 @@
 #include "slow_conv.hh"
 #include "fast_conv.hh"
 #include "slow_conv_manual.hh"
+#include "trace.hh"
 
 // see configs.hh for details
 double TRAINING_LINK_RATE = 4000000.0/1500.0;
 bool LINK_LOGGING = false;
 std::string LINK_LOGGING_FILENAME;
 
+// Runs RemyCC on 'flat' if it is loaded, else on 'dna', or if
+// 'reload_interval' is set on the tree in 'filename' as it changes (see
+// live-whiskers.hh). If 'profile' is set, dumps a whisker usage profile
+// there (see whisker-profile.hh). The memory type is a template parameter,
+// so that only this choice is made at runtime.
+template < typename MemoryType >
+void run_remy( const RemyBuffers::WhiskerTree & dna, const FlatWhiskerTree & flat, const string & filename, unsigned int reload_interval, const string & profile, string serverip, int serverport, int sourceport, int train_length, int probe_interval, double report_interval, int onduration, int offduration, string traffic_params ) {
+	typedef BasicRemyCC< MemoryType > CC;
+	std::unique_ptr< LiveWhiskerTree< MemoryType > > live;
+	typename CC::WhiskerTree whiskers;
+	std::unique_ptr< CC > congctrl;
+	if ( reload_interval > 0 ) {
+		live.reset( new LiveWhiskerTree< MemoryType >( filename, reload_interval ) );
+		congctrl.reset( new CC( *live ) );
+	}
+	else if ( flat.loaded() )
+		congctrl.reset( new CC( flat ) );
+	else {
+		whiskers = typename CC::WhiskerTree( dna );
+		congctrl.reset( new CC( whiskers ) );
+	}
+
+	std::unique_ptr< WhiskerProfile > whisker_profile;
+	std::unique_ptr< WhiskerProfileDumper > dumper;
+	if ( profile != "" ) {
+		// A profile is of the tree the controller looks up in
+		whisker_profile.reset( flat.loaded() ? new WhiskerProfile( flat ) : new WhiskerProfile( congctrl->whiskers() ) );
+		congctrl->set_profile( *whisker_profile );
+		dumper.reset( new WhiskerProfileDumper( *whisker_profile, profile ) );
+	}
+	CTCP< CC > connection( *congctrl, serverip, serverport, sourceport, train_length, probe_interval, report_interval );
+	TrafficGenerator< CTCP< CC > > traffic_generator( connection, onduration, offduration, traffic_params );
+	traffic_generator.spawn_senders( 1 );
+}
+
 int main( int argc, char *argv[] ) {
-	Memory temp;
-	WhiskerTree whiskers;
+	RemyBuffers::WhiskerTree whiskers;
+	FlatWhiskerTree flat_whiskers;
+	std::string ratname;
+	// ms between checks of the rat for changes, 0 to never reload it
+	unsigned int reload_interval = 0;
+	// where to dump the whisker usage profile, if anywhere
+	std::string profile = "";
+	// where to write a binary trace of controller events, if anywhere
+	std::string trace_file = "";
+	// where to write the results of the flows as JSON, if anywhere
+	std::string results_file = "";
 	bool ratFound = false;
+	// The memory type given by 'memory=', else that of the tree
+	RemyBuffers::MemoryType memory_type = RemyBuffers::MEMORY_DEFAULT;
+	bool memory_type_given = false;
 
 	string serverip = "";
 	int serverport=8888;
@@ -29,8 +78,13 @@ int main( int argc, char *argv[] ) {
 	// for MarkovianCC
 	string delta_conf = "";
 	string logfilepath = "";
-	// length of packet train for estimating bottleneck bandwidth
+	// length of packet trains for estimating bottleneck bandwidth (1, the
+	// default, sends none), and packets from the start of one to the next
+	// (see link-rate-estimator.hh)
 	int train_length = 1;
+	int probe_interval = 16;
+	// ms between reports of the flows' progress, 0 for none
+	double report_interval = 0;
 
 	enum CCType { REMYCC, TCPCC, KERNELCC, PCC, NASHCC, MARKOVIANCC, SLOW_CONV, FAST_CONV, SLOW_CONV_MANUAL} cctype = REMYCC;
 	int slow_conv_manual_inter_history = 1;
@@ -44,19 +98,25 @@ int main( int argc, char *argv[] ) {
 			}
 
 			std::string filename( arg.substr( 3 ) );
+			ratname = filename;
+			// Compiled trees are mapped in place rather than parsed
+			if ( FlatWhiskerTree::is_flat( filename ) ) {
+				if ( !flat_whiskers.load( filename ) )
+					exit( 1 );
+				ratFound = true;
+				continue;
+			}
+
 			int fd = open( filename.c_str(), O_RDONLY );
 			if ( fd < 0 ) {
 				perror( "open" );
 				exit( 1 );
 			}
 
-			RemyBuffers::WhiskerTree tree;
-			if ( !tree.ParseFromFileDescriptor( fd ) ) {
+			if ( !whiskers.ParseFromFileDescriptor( fd ) ) {
 				fprintf( stderr, "Could not parse %s.\n", filename.c_str() );
 				exit( 1 );
 			}
-	
-			whiskers = WhiskerTree( tree );
 			ratFound = true;
 
 			if ( close( fd ) < 0 ) {
@@ -64,6 +124,23 @@ int main( int argc, char *argv[] ) {
 				exit( 1 );
 			}
 		}
+		else if ( arg.substr( 0, 7 ) == "memory=" ) {
+			if ( !parse_memory_type( arg.substr( 7 ), memory_type ) ) {
+				fprintf( stderr, "Unrecognised memory type '%s'.\n", arg.substr( 7 ).c_str() );
+				exit( 1 );
+			}
+			memory_type_given = true;
+		}
+		else if ( arg.substr( 0, 16 ) == "reload_interval=" )
+			reload_interval = atoi( arg.substr( 16 ).c_str() );
+		else if ( arg.substr( 0, 6 ) == "stats=" )
+			LiveStats::enable( arg.substr( 6 ), LiveStats::SENDER );
+		else if ( arg.substr( 0, 8 ) == "profile=" )
+			profile = arg.substr( 8 );
+		else if ( arg.substr( 0, 6 ) == "trace=" )
+			trace_file = arg.substr( 6 );
+		else if ( arg.substr( 0, 8 ) == "results=" )
+			results_file = arg.substr( 8 );
 		else if( arg.substr( 0, 9 ) == "serverip=" )
 			serverip = arg.substr( 9 );
 		else if( arg.substr( 0, 11 ) == "serverport=" )
@@ -88,6 +165,10 @@ int main( int argc, char *argv[] ) {
 			logfilepath = arg.substr( 12 );
 		else if (arg.substr( 0, 13 ) == "train_length=")
 			train_length = atoi(arg.substr( 13 ).c_str());
+		else if (arg.substr( 0, 15 ) == "probe_interval=")
+			probe_interval = atoi(arg.substr( 15 ).c_str());
+		else if (arg.substr( 0, 16 ) == "report_interval=")
+			report_interval = atof(arg.substr( 16 ).c_str());
 		else if( arg.substr( 0, 7 ) == "cctype=" ) {
 			std::string cctype_str = arg.substr( 7 );
 			if( cctype_str == "remy" )
@@ -123,26 +204,57 @@ int main( int argc, char *argv[] ) {
 	}
 
 	if ( serverip == "" ) {
-		fprintf( stderr, "Usage: sender serverip=(ipaddr) [if=(ratname)] [offduration=(time in ms)] [onduration=(time in ms)] [cctype=remy|kernel|tcp|markovian] [delta_conf=(for MarkovianCC)] [traffic_params=[exponential|deterministic],[byte_switched],[num_cycles=]] [linkrate=(packets/sec)] [linklog=filename] [serverport=(port)]\n");
+		fprintf( stderr, "Usage: sender serverip=(ipaddr) [if=(ratname)] [offduration=(time in ms)] [onduration=(time in ms)] [cctype=remy|kernel|tcp|markovian] [delta_conf=(for MarkovianCC)] [traffic_params=[exponential|deterministic],[byte_switched],[num_cycles=]] [linkrate=(packets/sec)] [linklog=filename] [serverport=(port)] [memory=default|loss_signal|without_slow_rewma] [train_length=(packets per probe, 1 disables)] [probe_interval=(packets)] [report_interval=(ms between reports of each flow's progress)] [reload_interval=(ms between checks of the rat for changes)] [profile=(whisker usage profile, written on SIGUSR1 and exit)] [stats=(name of the live statistics segment)] [trace=(binary trace of controller events, see trace-decode)] [results=(results of each flow as JSON lines, see ccresults)]\n");
 		exit(1);
 	}
 
+	std::unique_ptr< Tracer > tracer;
+	if ( trace_file != "" )
+		tracer.reset( new Tracer( trace_file ) );
+	if ( results_file != "" )
+		ResultLog::enable( results_file, argc, argv );
+
 	if( not ratFound and cctype == CCType::REMYCC ) {
 		fprintf( stderr, "Please specify remy specification file using if=<filename>\n" );
 		exit(1);
 	}
 
 	if( cctype == CCType::REMYCC) {
-		fprintf( stdout, "Using RemyCC.\n" );
-		RemyCC congctrl( whiskers );
-		CTCP< RemyCC > connection( congctrl, serverip, serverport, sourceport, train_length );
-		TrafficGenerator<CTCP<RemyCC>> traffic_generator( connection, onduration, offduration, traffic_params );
-		traffic_generator.spawn_senders( 1 );
+		if ( profile != "" && reload_interval > 0 ) {
+			fprintf( stderr, "A whisker profile is of one tree, so 'profile=' cannot be used with 'reload_interval='.\n" );
+			exit( 1 );
+		}
+		if ( flat_whiskers.loaded() ) {
+			if ( memory_type_given && memory_type != flat_whiskers.memory_type() ) {
+				fprintf( stderr, "The compiled tree is of memory type '%s'.\n", memory_type_name( flat_whiskers.memory_type() ) );
+				exit( 1 );
+			}
+			memory_type = flat_whiskers.memory_type();
+		}
+		else if ( !memory_type_given )
+			memory_type = dna_memory_type( whiskers );
+		// 'memory=' is for trees that do not record their type
+		else if ( whiskers.has_memory_type() && whiskers.memory_type() != memory_type ) {
+			fprintf( stderr, "The tree is of memory type '%s'.\n", memory_type_name( whiskers.memory_type() ) );
+			exit( 1 );
+		}
+		fprintf( stdout, "Using RemyCC (memory type '%s').\n", memory_type_name( memory_type ) );
+
+		switch ( memory_type ) {
+		case RemyBuffers::MEMORY_WITH_LOSS_SIGNAL:
+			run_remy< MemoryWithLossSignal >( whiskers, flat_whiskers, ratname, reload_interval, profile, serverip, serverport, sourceport, train_length, probe_interval, report_interval, onduration, offduration, traffic_params );
+			break;
+		case RemyBuffers::MEMORY_WITHOUT_SLOW_REWMA:
+			run_remy< MemoryWithoutSlowRewma >( whiskers, flat_whiskers, ratname, reload_interval, profile, serverip, serverport, sourceport, train_length, probe_interval, report_interval, onduration, offduration, traffic_params );
+			break;
+		default:
+			run_remy< MemoryDefault >( whiskers, flat_whiskers, ratname, reload_interval, profile, serverip, serverport, sourceport, train_length, probe_interval, report_interval, onduration, offduration, traffic_params );
+		}
 	}
 	else if( cctype == CCType::TCPCC ) {
 		fprintf( stdout, "Using UDT's TCP CC.\n" );
 		DefaultCC congctrl;
-		CTCP< DefaultCC > connection( congctrl, serverip, serverport, sourceport, train_length );
+		CTCP< DefaultCC > connection( congctrl, serverip, serverport, sourceport, train_length, probe_interval, report_interval );
 		TrafficGenerator< CTCP< DefaultCC > > traffic_generator( connection, onduration, offduration, traffic_params );
 		traffic_generator.spawn_senders( 1 );
 	}
@@ -169,14 +281,14 @@ int main( int argc, char *argv[] ) {
 		MarkovianCC congctrl(1.0);
 		assert(delta_conf != "");
 		congctrl.interpret_config_str(delta_conf);
-		CTCP< MarkovianCC > connection( congctrl, serverip, serverport, sourceport, train_length );
+		CTCP< MarkovianCC > connection( congctrl, serverip, serverport, sourceport, train_length, probe_interval, report_interval );
 		TrafficGenerator< CTCP< MarkovianCC > > traffic_generator( connection, onduration, offduration, traffic_params );
 		traffic_generator.spawn_senders( 1 );
 	}
 	else if (cctype == CCType::SLOW_CONV) {
 		fprintf(stdout, "Using SlowConv.\n");
 		SlowConv congctrl(logfilepath);
-		CTCP< SlowConv > connection( congctrl, serverip, serverport, sourceport, train_length );
+		CTCP< SlowConv > connection( congctrl, serverip, serverport, sourceport, train_length, probe_interval, report_interval );
 		TrafficGenerator< CTCP< SlowConv > > traffic_generator( connection, onduration, offduration, traffic_params );
 		traffic_generator.spawn_senders( 1 );
 	}
@@ -184,7 +296,7 @@ int main( int argc, char *argv[] ) {
 		fprintf(stdout, "Using SlowConvManual.\n");
 		SlowConvManual congctrl(logfilepath, slow_conv_manual_inter_history);
 		CTCP<SlowConvManual> connection(congctrl, serverip, serverport,
-										sourceport, train_length);
+										sourceport, train_length, probe_interval, report_interval);
 		TrafficGenerator<CTCP<SlowConvManual>> traffic_generator(
 			connection, onduration, offduration, traffic_params);
 		traffic_generator.spawn_senders(1);
@@ -192,7 +304,7 @@ int main( int argc, char *argv[] ) {
 	else if (cctype == CCType::FAST_CONV) {
 		fprintf(stdout, "Using FastConv.\n");
 		FastConv congctrl(logfilepath);
-		CTCP< FastConv > connection( congctrl, serverip, serverport, sourceport, train_length );
+		CTCP< FastConv > connection( congctrl, serverip, serverport, sourceport, train_length, probe_interval, report_interval );
 		TrafficGenerator< CTCP< FastConv > > traffic_generator( connection, onduration, offduration, traffic_params );
 		traffic_generator.spawn_senders( 1 );
 	}
@@ -0,0 +1,46 @@
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "signal-watcher.hh"
+
+// Signals received so far, by number
+static std::atomic<unsigned int> signal_counts[NSIG];
+
+static void count_signal(int signum) {
+  signal_counts[signum]++;
+}
+
+SignalWatcher::SignalWatcher(int signum,
+                             const std::function<void(bool)>& on_tick,
+                             unsigned int tick)
+  : signum(signum), tick(tick), on_tick(on_tick), stop(false), thread()
+{
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = count_signal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  if (sigaction(signum, &action, nullptr) < 0) {
+    perror("sigaction");
+    exit(1);
+  }
+  thread = std::thread(&SignalWatcher::run, this);
+}
+
+SignalWatcher::~SignalWatcher() {
+  stop = true;
+  thread.join();
+}
+
+void SignalWatcher::run() {
+  unsigned int seen = signal_counts[signum];
+  while (!stop) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(tick));
+    unsigned int count = signal_counts[signum];
+    on_tick(count != seen);
+    seen = count;
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef SIGNAL_WATCHER_HH
+#define SIGNAL_WATCHER_HH
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+// A thread that wakes up every 'tick' ms and calls 'on_tick' with whether
+// the process got 'signum' since the last call, until it is destroyed.
+// The signal handler only counts the signal, so 'on_tick' may do
+// anything. Watchers of the same signal each see every signal.
+class SignalWatcher {
+  int signum;
+  unsigned int tick;
+  std::function<void(bool)> on_tick;
+  std::atomic<bool> stop;
+  std::thread thread;
+
+  void run();
+
+ public:
+  static const unsigned int default_tick = 50;
+
+  SignalWatcher(int signum, const std::function<void(bool)>& on_tick,
+                unsigned int tick = default_tick);
+  ~SignalWatcher();
+
+  SignalWatcher(const SignalWatcher&) = delete;
+  SignalWatcher& operator=(const SignalWatcher&) = delete;
+};
+
+#endif
@@ -0,0 +1,499 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "simulator.hh"
+
+using namespace std;
+
+/****************************** LINK **********************************/
+
+Link::Link(double rate, double delay, unique_ptr<QueueDisc> queue) :
+  rate(rate),
+  delay(delay),
+  queue(move(queue)),
+  busy(false),
+  in_tx(),
+  in_flight(),
+  pkts_delivered(0),
+  queue_integral(0),
+  last_queue_change(0),
+  max_queue(0)
+{
+  assert(rate > 0);
+  assert(delay >= 0);
+}
+
+void Link::account_queue(double now) {
+  queue_integral += queue->size_pkts() * (now - last_queue_change);
+  last_queue_change = now;
+}
+
+double Link::avg_queue(double now) const {
+  if (now <= 0)
+    return 0;
+  double integral = queue_integral + queue->size_pkts() * (now - last_queue_change);
+  return integral / now;
+}
+
+/***************************** SENDER *********************************/
+
+SimSender::SimSender(Simulator& sim, int id, const SenderConfig& config) :
+  sim(sim),
+  id(id),
+  config(config),
+  deterministic(false),
+  byte_switched(false),
+  num_cycles((unsigned int)-1),
+  prng(config.seed),
+  on(1 / config.onduration, prng),
+  off(1 / config.offduration, prng),
+  state(OFF),
+  cycle(-1),
+  next_on_time(0),
+  on_amount(0),
+  flow_start(0),
+  next_wakeup(numeric_limits<double>::max()),
+  link_rate_estimator(config.train_length, config.probe_interval),
+  seq_num(0),
+  largest_ack(-1),
+  last_send_time(0),
+  last_ack_time(0),
+  num_acked(0),
+  ecn_recover(-1),
+  stats({0, 0, 0, 0, 0, 0}),
+  active_time(0)
+{
+  assert(!config.route.empty());
+  assert(config.train_length >= 1);
+
+  // Same format as TrafficGenerator
+  const string& params = config.traffic_params;
+  size_t start_pos = 0;
+  while (start_pos < params.length()) {
+    size_t end_pos = params.find(',', start_pos);
+    if (end_pos == string::npos)
+      end_pos = params.length();
+
+    string arg = params.substr(start_pos, end_pos - start_pos);
+    if (arg == "exponential")
+      deterministic = false;
+    else if (arg == "deterministic")
+      deterministic = true;
+    else if (arg == "byte_switched")
+      byte_switched = true;
+    else if (arg.substr(0, 11) == "num_cycles=")
+      num_cycles = (unsigned int) atoi(arg.substr(11).c_str());
+    else
+      cerr << "Unrecognised parameter: " << arg << endl;
+
+    start_pos = end_pos + 1;
+  }
+}
+
+void SimSender::start(double now) {
+  begin_cycle(now);
+}
+
+// Chooses the durations of the next off and on periods. As in
+// TrafficGenerator, each cycle starts with the off period.
+void SimSender::begin_cycle(double now) {
+  if (unsigned(cycle + 1) >= num_cycles) {
+    state = DONE;
+    return;
+  }
+  double off_duration = off.sample();
+  double on_duration = on.sample();
+  if (deterministic) {
+    off_duration = config.offduration;
+    on_duration = config.onduration;
+  }
+  state = OFF;
+  next_on_time = now + unsigned(off_duration);
+  on_amount = on_duration;
+  wakeup_at(next_on_time);
+}
+
+void SimSender::start_flow(double now) {
+  state = ON;
+  ++ cycle;
+  flow_start = now;
+  seq_num = 0;
+  largest_ack = -1;
+  ecn_recover = -1;
+  last_send_time = 0;
+  last_ack_time = 0;
+  num_acked = 0;
+  sim.flow_started(id);
+
+  // Stands in for the RTT CTCP measures in its handshake
+  cc_set_min_rtt(sim.base_rtt(config));
+  cc_set_timestamp(0);
+  cc_init();
+  link_rate_estimator.new_flow();
+  if (link_rate_estimator.get_link_rate() > 0)
+    cc_on_link_rate(link_rate_estimator.get_link_rate());
+}
+
+void SimSender::stop_flow(double now) {
+  cc_set_timestamp(now - flow_start);
+  cc_close();
+  active_time += now - flow_start;
+  ++ stats.flows_completed;
+  sim.flow_stopped(id);
+  begin_cycle(now);
+}
+
+// The comparisons against these must use exactly the times the wakeups
+// were scheduled for, or rounding could leave us waking up in a loop.
+// Packets of a probe train go at once, without waiting for the pacer.
+double SimSender::next_send_time() {
+  if (link_rate_estimator.in_train(seq_num))
+    return -numeric_limits<double>::infinity();
+  return flow_start + last_send_time + cc_intersend_time();
+}
+
+double SimSender::timeout_time() const {
+  return flow_start + last_ack_time + ack_timeout;
+}
+
+void SimSender::try_send(double now) {
+  double cur_time = now - flow_start;
+  cc_set_timestamp(cur_time);
+  while (seq_num < largest_ack + 1 + cc_window() && next_send_time() <= now) {
+    QueuedPacket pkt;
+    pkt.enqueue_time = now;
+    pkt.sent_time = cur_time;
+    pkt.size = sim_packet_size;
+    pkt.flow_id = id;
+    pkt.seq_num = seq_num;
+    pkt.tag = cycle;
+    pkt.ect = config.ecn;
+    pkt.ce = false;
+    sim.send(id, pkt);
+    ++ stats.pkts_sent;
+
+    // The ones after a train wait for the time it took, as in CTCP
+    if (link_rate_estimator.in_train(seq_num))
+      last_send_time += cc_intersend_time();
+    else
+      last_send_time = cur_time;
+    link_rate_estimator.on_send(seq_num, cur_time);
+    cc_on_pkt_sent(seq_num);
+    ++ seq_num;
+  }
+}
+
+// Makes sure we wake up for the next thing that can happen without an
+// ACK: the pacing timer expiring, the on period ending or the ACK timeout.
+void SimSender::plan_wakeup(double now) {
+  assert(state == ON);
+  double next = timeout_time();
+  if (!byte_switched)
+    next = min(next, flow_start + on_amount);
+  if (seq_num < largest_ack + 1 + cc_window()) {
+    double send_time = next_send_time();
+    if (std::isfinite(send_time))
+      next = min(next, max(send_time, now));
+  }
+  wakeup_at(next);
+}
+
+void SimSender::wakeup_at(double time) {
+  if (time < next_wakeup) {
+    next_wakeup = time;
+    sim.schedule_wakeup(id, time);
+  }
+}
+
+void SimSender::on_wakeup(double now) {
+  // Only the latest wakeup counts; earlier requests that were superseded
+  // still fire and are ignored here
+  if (now != next_wakeup)
+    return;
+  next_wakeup = numeric_limits<double>::max();
+
+  if (state == DONE)
+    return;
+  if (state == OFF) {
+    if (now < next_on_time) {
+      wakeup_at(next_on_time);
+      return;
+    }
+    start_flow(now);
+  }
+  else if (!byte_switched && now >= flow_start + on_amount) {
+    stop_flow(now);
+    return;
+  }
+  else if (now >= timeout_time()) {
+    double cur_time = now - flow_start;
+    cc_set_timestamp(cur_time);
+    cc_init();
+    largest_ack = seq_num - 1;
+    last_send_time = cur_time;
+    last_ack_time = cur_time;
+  }
+  try_send(now);
+  plan_wakeup(now);
+}
+
+void SimSender::on_ack(const QueuedPacket& pkt, double receiver_timestamp,
+                       double now) {
+  // ACK for an earlier on period
+  if (state != ON || pkt.tag != cycle)
+    return;
+
+  double cur_time = now - flow_start;
+  int ack = pkt.seq_num + 1;
+  cc_set_timestamp(cur_time);
+  last_ack_time = cur_time;
+  ++ stats.pkts_acked;
+  stats.rtt_sum += cur_time - pkt.sent_time;
+  sim.count_delivery(id);
+
+  if (link_rate_estimator.on_ack(pkt.seq_num, receiver_timestamp))
+    cc_on_link_rate(link_rate_estimator.get_link_rate());
+  cc_on_ack(ack, receiver_timestamp, pkt.sent_time);
+  if (pkt.ce) {
+    ++ stats.pkts_marked;
+    if (pkt.seq_num > ecn_recover) {
+      cc_on_ecn_mark();
+      ecn_recover = seq_num - 1;
+    }
+  }
+  largest_ack = max(largest_ack, ack);
+  ++ num_acked;
+
+  if (byte_switched && num_acked * sim_data_size >= on_amount) {
+    stop_flow(now);
+    return;
+  }
+  try_send(now);
+  plan_wakeup(now);
+}
+
+double SimSender::get_active_time(double now) const {
+  if (state == ON)
+    return active_time + now - flow_start;
+  return active_time;
+}
+
+double SimSender::get_throughput(double now) const {
+  double time = get_active_time(now);
+  if (time <= 0)
+    return 0;
+  return 1000.0 * stats.pkts_acked / time;
+}
+
+double SimSender::get_avg_rtt() const {
+  if (stats.pkts_acked == 0)
+    return 0;
+  return stats.rtt_sum / stats.pkts_acked;
+}
+
+/**************************** SIMULATOR *******************************/
+
+Simulator::Simulator() :
+  events(),
+  num_events(0),
+  cur_time(0),
+  started(false),
+  links(),
+  senders(),
+  acks(),
+  fairness(),
+  interval_delivered(),
+  interval_epoch(),
+  counted_epoch(),
+  epoch(0),
+  num_on(0),
+  interval_flows(0)
+{}
+
+void Simulator::register_sender(SimSender* sender) {
+  senders.emplace_back(sender);
+  acks.emplace_back(16);
+  interval_delivered.push_back(0);
+  interval_epoch.push_back(epoch);
+  counted_epoch.push_back(uint64_t(-1));
+}
+
+int Simulator::add_link(double rate, double delay, unique_ptr<QueueDisc> queue) {
+  int id = links.size();
+  queue->set_drop_callback([this](const QueuedPacket& pkt) {
+    senders[pkt.flow_id]->on_drop();
+  });
+  links.emplace_back(new Link(rate, delay, move(queue)));
+  return id;
+}
+
+double Simulator::base_rtt(const SenderConfig& config) const {
+  double rtt = config.ack_delay;
+  for (size_t i = 0; i < config.route.size(); ++i) {
+    const Link& link = *links[config.route[i]];
+    rtt += link.tx_time(sim_packet_size);
+    if (i + 1 < config.route.size())
+      rtt += link.delay;
+  }
+  return rtt;
+}
+
+void Simulator::schedule(Event::Type type, double time, int target) {
+  Event e;
+  e.type = type;
+  e.time = time;
+  e.order = num_events++;
+  e.target = target;
+  events.push(e);
+}
+
+void Simulator::send(int sender_id, const QueuedPacket& pkt) {
+  arrive(senders[sender_id]->get_config().route[0], pkt);
+}
+
+void Simulator::schedule_wakeup(int sender_id, double time) {
+  schedule(Event::WAKEUP, time, sender_id);
+}
+
+void Simulator::flow_started(int sender_id) {
+  ++ num_on;
+  if (counted_epoch[sender_id] != epoch) {
+    counted_epoch[sender_id] = epoch;
+    ++ interval_flows;
+  }
+}
+
+// A sender that was on in this interval was counted, either when it
+// started or (if it was already on) when the interval began
+void Simulator::flow_stopped(int sender_id) {
+  -- num_on;
+  counted_epoch[sender_id] = epoch;
+}
+
+void Simulator::count_delivery(int sender_id) {
+  long& delivered = interval_delivered[sender_id];
+  if (interval_epoch[sender_id] != epoch) {
+    interval_epoch[sender_id] = epoch;
+    delivered = 0;
+  }
+  fairness.update(delivered, delivered + 1);
+  ++ delivered;
+}
+
+double Simulator::sample_fairness() {
+  double res = fairness.get(interval_flows);
+  fairness.reset();
+  ++ epoch;
+  interval_flows = num_on;
+  return res;
+}
+
+void Simulator::arrive(int link_id, const QueuedPacket& pkt) {
+  Link& link = *links[link_id];
+  link.account_queue(cur_time);
+  link.queue->enqueue(pkt, cur_time);
+  link.max_queue = max(link.max_queue, link.queue->size_pkts());
+  if (!link.busy)
+    start_tx(link_id);
+}
+
+void Simulator::start_tx(int link_id) {
+  Link& link = *links[link_id];
+  QueuedPacket pkt;
+  link.account_queue(cur_time);
+  if (!link.queue->dequeue(pkt, cur_time)) {
+    link.busy = false;
+    return;
+  }
+  link.busy = true;
+  link.in_tx = pkt;
+  schedule(Event::TX_DONE, cur_time + link.tx_time(pkt.size), link_id);
+}
+
+void Simulator::tx_done(int link_id) {
+  Link& link = *links[link_id];
+  const QueuedPacket& pkt = link.in_tx;
+  ++ link.pkts_delivered;
+
+  const SenderConfig& config = senders[pkt.flow_id]->get_config();
+  if (link_id == config.route.back()) {
+    // The receiver ACKs immediately, stamping the time of arrival
+    RingBuffer<PendingAck>& pending = acks[pkt.flow_id];
+    PendingAck ack = {cur_time + config.ack_delay, cur_time + link.delay, pkt};
+    if (pending.empty())
+      schedule(Event::ACK, ack.time, pkt.flow_id);
+    pending.push_back(ack);
+  }
+  else {
+    if (link.in_flight.empty())
+      schedule(Event::PROPAGATED, cur_time + link.delay, link_id);
+    link.in_flight.push_back(make_pair(cur_time + link.delay, pkt));
+  }
+
+  start_tx(link_id);
+}
+
+void Simulator::propagated(int link_id) {
+  Link& link = *links[link_id];
+  QueuedPacket pkt = link.in_flight.front().second;
+  link.in_flight.pop_front();
+  if (!link.in_flight.empty())
+    schedule(Event::PROPAGATED, link.in_flight.front().first, link_id);
+
+  const vector<int>& route = senders[pkt.flow_id]->get_config().route;
+  auto hop = find(route.begin(), route.end(), link_id);
+  assert(hop != route.end() && hop + 1 != route.end());
+  arrive(*(hop + 1), pkt);
+}
+
+void Simulator::deliver_ack(int sender_id) {
+  RingBuffer<PendingAck>& pending = acks[sender_id];
+  PendingAck ack = pending.front();
+  pending.pop_front();
+  if (!pending.empty())
+    schedule(Event::ACK, pending.front().time, sender_id);
+  senders[sender_id]->on_ack(ack.pkt, ack.receiver_timestamp, cur_time);
+}
+
+void Simulator::run(double until) {
+  if (!started) {
+    started = true;
+    for (auto& sender : senders)
+      sender->start(cur_time);
+  }
+
+  while (!events.empty() && events.top().time <= until) {
+    Event e = events.top();
+    events.pop();
+    cur_time = e.time;
+    switch (e.type) {
+    case Event::WAKEUP:
+      senders[e.target]->on_wakeup(cur_time);
+      break;
+    case Event::TX_DONE:
+      tx_done(e.target);
+      break;
+    case Event::PROPAGATED:
+      propagated(e.target);
+      break;
+    case Event::ACK:
+      deliver_ack(e.target);
+      break;
+    }
+  }
+  cur_time = until;
+}
+
+double jain_index(const vector<double>& vals) {
+  double sum = 0, sum_sq = 0;
+  for (double x : vals) {
+    sum += x;
+    sum_sq += x * x;
+  }
+  if (sum_sq == 0)
+    return 1;
+  return sum * sum / (vals.size() * sum_sq);
+}
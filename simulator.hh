@@ -0,0 +1,323 @@
+#ifndef SIMULATOR_HH
+#define SIMULATOR_HH
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "exponential.hh"
+#include "fairness.hh"
+#include "link-rate-estimator.hh"
+#include "queue-disc.hh"
+#include "random.hh"
+#include "ring-buffer.hh"
+#include "tcp-header.hh"
+
+// A discrete-event simulator that runs the congestion controllers in
+// virtual time, without sockets. Senders behave like CTCP::send_data
+// driven by a TrafficGenerator, packets cross a sequence of links (each a
+// queue in front of a fixed-rate transmitter followed by a propagation
+// delay) and are ACKed by the receiver as soon as they arrive. ACKs take a
+// fixed delay to get back to the sender.
+//
+// Links and senders keep the packets they have in flight in their own
+// FIFOs: the propagation delay of a link and the ACK delay of a sender are
+// fixed, so packets come out in the order they went in and only the first
+// of each FIFO needs an entry in the global event queue. The event queue
+// thus holds O(links + senders) entries rather than one per packet, which
+// keeps runs with thousands of flows cheap.
+//
+// Time is in milliseconds throughout, as in the rest of genericCC. Events
+// at the same time are processed in the order they were scheduled, so runs
+// are fully deterministic.
+
+// Same packet size as CTCP
+const int sim_packet_size = 1472;
+const int sim_data_size = sim_packet_size - sizeof(TCPHeader);
+
+class Simulator;
+
+class Link {
+ public:
+  // In packets/s of sim_packet_size bytes
+  double rate;
+  // One-way propagation delay (ms)
+  double delay;
+  std::unique_ptr<QueueDisc> queue;
+  bool busy;
+  // The packet on the wire, if busy
+  QueuedPacket in_tx;
+  // Packets that left the wire, with the time they reach the next hop
+  RingBuffer< std::pair<double, QueuedPacket> > in_flight;
+
+  // Statistics
+  long pkts_delivered;
+  // Integral of the queue length (in packets) over time
+  double queue_integral;
+  double last_queue_change;
+  int max_queue;
+
+  Link(double rate, double delay, std::unique_ptr<QueueDisc> queue);
+
+  // Time to put a packet of 'size' bytes on the wire (ms)
+  double tx_time(int size) const { return 1000.0 * size / (rate * sim_packet_size); }
+  // Accounts for the queue length up to 'now'. Call before it changes.
+  void account_queue(double now);
+  double avg_queue(double now) const;
+};
+
+struct SenderConfig {
+  // Links traversed by data packets, in order
+  std::vector<int> route;
+  // Time for an ACK to get back to the sender after the data packet
+  // leaves the last link of the route (ms). Includes the propagation delay
+  // of the last link.
+  double ack_delay;
+  // As in CTCP: every probe_interval packets, a train of train_length
+  // packets is sent back to back to estimate the link rate (1 sends none)
+  int train_length;
+  int probe_interval;
+  // As in TrafficGenerator: the mean on duration (ms, or bytes if
+  // traffic_params has 'byte_switched') and off duration (ms)
+  double onduration;
+  double offduration;
+  std::string traffic_params;
+  unsigned seed;
+  // Send ECN capable packets, and tell the controller about marks
+  bool ecn;
+
+  // A single flow that stays on forever
+  SenderConfig()
+    : route(), ack_delay(0), train_length(1), probe_interval(16),
+      onduration(std::numeric_limits<double>::max()), offduration(0),
+      traffic_params("deterministic,num_cycles=1"), seed(1), ecn(false)
+  {}
+};
+
+// Sends packets on behalf of one congestion controller. The controller is
+// supplied by CCSender<T> through the cc_* hooks.
+class SimSender {
+ public:
+  struct Stats {
+    long pkts_sent;
+    long pkts_acked;
+    long pkts_dropped;
+    // ACKs that echoed an ECN mark
+    long pkts_marked;
+    double rtt_sum;
+    int flows_completed;
+  };
+
+ private:
+  enum State {OFF, ON, DONE};
+  // If no ACK arrives for this long, restart the controller and forget
+  // all outstanding packets (as CTCP used to). Without this a sender
+  // whose whole window was lost would stall forever.
+  static constexpr double ack_timeout = 2000;
+
+  Simulator& sim;
+  int id;
+  SenderConfig config;
+  bool deterministic;
+  bool byte_switched;
+  unsigned num_cycles;
+  PRNG prng;
+  Exponential on;
+  Exponential off;
+
+  State state;
+  // Number of the current on period, used to ignore late ACKs
+  int cycle;
+  double next_on_time;
+  double on_amount;
+  double flow_start;
+  double next_wakeup;
+
+  // As in CTCP::send_data. Times are relative to flow_start.
+  LinkRateEstimator link_rate_estimator;
+  int seq_num;
+  int largest_ack;
+  double last_send_time;
+  double last_ack_time;
+  long num_acked;
+  // Marks for packets up to this one were already reported to the
+  // controller, so that it reacts once per window, as TCP does
+  int ecn_recover;
+
+  Stats stats;
+  double active_time;
+
+  void begin_cycle(double now);
+  void start_flow(double now);
+  void stop_flow(double now);
+  double next_send_time();
+  double timeout_time() const;
+  void try_send(double now);
+  void plan_wakeup(double now);
+  void wakeup_at(double time);
+
+ protected:
+  virtual void cc_set_timestamp(double time) = 0;
+  virtual void cc_set_min_rtt(double min_rtt) = 0;
+  virtual void cc_init() = 0;
+  virtual void cc_close() = 0;
+  virtual void cc_on_pkt_sent(int seq_num) = 0;
+  virtual void cc_on_ack(int ack, double receiver_timestamp, double sent_time) = 0;
+  virtual void cc_on_ecn_mark() = 0;
+  virtual void cc_on_link_rate(double link_rate) = 0;
+  virtual double cc_window() = 0;
+  virtual double cc_intersend_time() = 0;
+
+ public:
+  SimSender(Simulator& sim, int id, const SenderConfig& config);
+  virtual ~SimSender() {}
+  SimSender(const SimSender&) = delete;
+  SimSender& operator=(const SimSender&) = delete;
+
+  // Called by the simulator
+  void start(double now);
+  void on_wakeup(double now);
+  void on_ack(const QueuedPacket& pkt, double receiver_timestamp, double now);
+  void on_drop() { ++ stats.pkts_dropped; }
+
+  const SenderConfig& get_config() const { return config; }
+  const Stats& get_stats() const { return stats; }
+  // Total time spent in on periods up to 'now' (ms)
+  double get_active_time(double now) const;
+  // ACKed packets/s over the on periods
+  double get_throughput(double now) const;
+  // Mean RTT of ACKed packets (ms)
+  double get_avg_rtt() const;
+};
+
+template <class T>
+class CCSender : public SimSender {
+  T congctrl;
+
+ protected:
+  void cc_set_timestamp(double time) override { congctrl.set_timestamp(time); }
+  void cc_set_min_rtt(double min_rtt) override { congctrl.set_min_rtt(min_rtt); }
+  void cc_init() override { congctrl.init(); }
+  void cc_close() override { congctrl.close(); }
+  void cc_on_pkt_sent(int seq_num) override { congctrl.onPktSent(seq_num); }
+  void cc_on_ack(int ack, double receiver_timestamp, double sent_time) override {
+    congctrl.onACK(ack, receiver_timestamp, sent_time);
+  }
+  void cc_on_ecn_mark() override { congctrl.onECNMark(); }
+  void cc_on_link_rate(double link_rate) override { congctrl.onLinkRateMeasurement(link_rate); }
+  double cc_window() override { return congctrl.get_the_window(); }
+  double cc_intersend_time() override { return congctrl.get_intersend_time(); }
+
+ public:
+  template <class... Args>
+  CCSender(Simulator& sim, int id, const SenderConfig& config, Args&&... args)
+    : SimSender(sim, id, config),
+      congctrl(std::forward<Args>(args)...)
+  {}
+
+  T& get_congctrl() { return congctrl; }
+};
+
+class Simulator {
+  struct Event {
+    // PROPAGATED and ACK are for the first packet of the link's in_flight
+    // and the sender's ACK FIFO respectively
+    enum Type {WAKEUP, TX_DONE, PROPAGATED, ACK} type;
+    double time;
+    // Breaks ties between events at the same time
+    uint64_t order;
+    // Sender for WAKEUP and ACK, link for TX_DONE and PROPAGATED
+    int target;
+  };
+  struct LaterEvent {
+    bool operator()(const Event& a, const Event& b) const {
+      return a.time > b.time || (a.time == b.time && a.order > b.order);
+    }
+  };
+
+  // ACKs on their way back to a sender
+  struct PendingAck {
+    double time;
+    double receiver_timestamp;
+    QueuedPacket pkt;
+  };
+
+  std::priority_queue<Event, std::vector<Event>, LaterEvent> events;
+  uint64_t num_events;
+  double cur_time;
+  bool started;
+  std::vector< std::unique_ptr<Link> > links;
+  std::vector< std::unique_ptr<SimSender> > senders;
+  std::vector< RingBuffer<PendingAck> > acks;
+
+  // For sample_fairness: packets delivered per sender in the current
+  // interval (valid if the sender's epoch is the current one), and the
+  // interval in which each sender was last counted as on
+  JainIndex fairness;
+  std::vector<long> interval_delivered;
+  std::vector<uint64_t> interval_epoch;
+  std::vector<uint64_t> counted_epoch;
+  uint64_t epoch;
+  int num_on;
+  int interval_flows;
+
+  void schedule(Event::Type type, double time, int target);
+  void register_sender(SimSender* sender);
+  void arrive(int link_id, const QueuedPacket& pkt);
+  void start_tx(int link_id);
+  void tx_done(int link_id);
+  void propagated(int link_id);
+  void deliver_ack(int sender_id);
+
+ public:
+  Simulator();
+  Simulator(const Simulator&) = delete;
+  Simulator& operator=(const Simulator&) = delete;
+
+  // Returns the id of the new link
+  int add_link(double rate, double delay, std::unique_ptr<QueueDisc> queue);
+
+  // Adds a sender running controller T, constructed from 'args'
+  template <class T, class... Args>
+  CCSender<T>& add_sender(const SenderConfig& config, Args&&... args) {
+    CCSender<T>* sender = new CCSender<T>(*this, senders.size(), config,
+                                          std::forward<Args>(args)...);
+    register_sender(sender);
+    return *sender;
+  }
+
+  // Runs until virtual time 'until' (ms). May be called repeatedly.
+  void run(double until);
+
+  // Used by the senders
+  void send(int sender_id, const QueuedPacket& pkt);
+  void schedule_wakeup(int sender_id, double time);
+  void flow_started(int sender_id);
+  void flow_stopped(int sender_id);
+  void count_delivery(int sender_id);
+  // Propagation and transmission delay of a packet over the route plus
+  // the ACK delay, ie. the RTT on an empty network (ms)
+  double base_rtt(const SenderConfig& config) const;
+
+  // Jain's index of the packets delivered per sender since the previous
+  // call (or the start), over the senders that were on at some point in
+  // that interval, so that a starved sender counts as a zero. Starts a
+  // new interval. Maintained online: O(1) per ACK and per call.
+  double sample_fairness();
+
+  double now() const { return cur_time; }
+  uint64_t get_num_events() const { return num_events; }
+  const Link& get_link(int id) const { return *links[id]; }
+  int get_num_links() const { return links.size(); }
+  const SimSender& get_sender(int id) const { return *senders[id]; }
+  int get_num_senders() const { return senders.size(); }
+};
+
+// Jain's fairness index of 'vals'
+double jain_index(const std::vector<double>& vals);
+
+#endif
@@ -1,4 +1,6 @@
 #include "slow_conv.hh"
+#include "trace.hh"
+#include <cmath>
 #include <sstream>
 #include <chrono>
 
@@ -618,10 +620,25 @@ void SlowConv::update_rate_cwnd(Time now) {
 			time_since_last_rate_update;
 		sent_at_last_rate_update = cum_segs_sent;
 		update_send_history_on_rate_update(now);
-		log_state(now);
-		log_beliefs(now);
-		log_history(now);
-		log_send_history(now);
+		trace(TRACE_SLOWCONV_STATE, now, -1, cwnd, sending_rate, NAN,
+			  {double(state), prev_measured_sending_rate,
+			   double(cum_segs_sent), double(cum_segs_delivered),
+			   double(cum_segs_lost), double(expected_cum_sent)});
+		trace(TRACE_SLOWCONV_BELIEFS, now, -1, cwnd, sending_rate,
+			  beliefs.min_rtt,
+			  {beliefs.min_qdel, beliefs.min_c, beliefs.max_c,
+			   beliefs.min_c_lambda, double(beliefs.bq_belief1),
+			   double(beliefs.bq_belief2),
+			   beliefs.prev_consistent_min_c_lambda});
+		// The text logs are slow to format; skip them if not written
+		if (log_enabled(LogLevel::INFO)) {
+			log_state(now);
+			log_beliefs(now);
+		}
+		if (log_enabled(LogLevel::DEBUG)) {
+			log_history(now);
+			log_send_history(now);
+		}
 	}
 }
 
@@ -686,13 +703,14 @@ void SlowConv::update_rate_cwnd_fast_conv(Time now __attribute((unused))) {
 	_the_window = cwnd;
 }
 
-void SlowConv::log(LogLevel l, std::string msg) {
+bool SlowConv::log_enabled(LogLevel l) const {
 	// Don't show DEBUG logs
 	// Ideally should have used a logging library here...
-	if (l > LogLevel::INFO) {
-		return;
-	}
-	if (logfile.is_open()) {
+	return l <= LogLevel::INFO && logfile.is_open();
+}
+
+void SlowConv::log(LogLevel l, std::string msg) {
+	if (log_enabled(l)) {
 		// std::cout << "Logging";
 		logfile << LOG_TYPE_TO_STR[l] << " " << msg << std::endl;
 	} else {
@@ -710,6 +728,24 @@ void SlowConv::log_state(Time now) {
 	log(LogLevel::INFO, ss.str());
 }
 
+int SlowConv::get_state(const char** names, double* values, int max) const {
+	const char* state_names[] = {"min_rtt", "min_qdel", "min_c", "max_c",
+								 "min_c_lambda", "bq_belief1", "bq_belief2",
+								 "genericcc_rate_measurement"};
+	const double state[] = {beliefs.min_rtt,
+							beliefs.min_qdel,
+							beliefs.min_c,
+							beliefs.max_c,
+							beliefs.min_c_lambda,
+							double(beliefs.bq_belief1),
+							double(beliefs.bq_belief2),
+							genericcc_rate_measurement};
+	int n = std::min(max, 8);
+	std::copy(state_names, state_names + n, names);
+	std::copy(state, state + n, values);
+	return n;
+}
+
 void SlowConv::log_beliefs(Time now) {
 	std::stringstream ss;
 	ss << "time " << now << " min_rtt " << beliefs.min_rtt << " min_qdel "
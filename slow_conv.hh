@@ -231,6 +231,8 @@ class SlowConv: public CCC {
 	void update_rate_cwnd_fast_conv(Time __attribute((unused)));
 	virtual void update_rate_cwnd_slow_conv(Time __attribute((unused)));
 	virtual void update_state(Time __attribute((unused)), const SegmentData &);
+	// Whether log() writes messages of this level
+	bool log_enabled(LogLevel) const;
 	void log(LogLevel, std::string);
 	void log_state(Time);
 	void log_beliefs(Time);
@@ -286,6 +288,8 @@ class SlowConv: public CCC {
 					   Time sender_timestamp __attribute((unused))) override;
 	virtual void onPktSent(SeqNum seq_num) override;
 	virtual void onTimeout() override { std::cerr << "Ack timed out!\n"; }
+	// The beliefs, as log_beliefs
+	virtual int get_state(const char** names, double* values, int max) const override;
 	virtual void onLinkRateMeasurement(double s_measured_link_rate) override {
 		genericcc_rate_measurement = s_measured_link_rate;
 	}
@@ -0,0 +1,32 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "thread-pool.hh"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int num_threads) :
+  num_threads(num_threads)
+{
+  if (this->num_threads <= 0)
+    this->num_threads = max(1u, thread::hardware_concurrency());
+}
+
+void ThreadPool::run(size_t num_tasks, const function<void(size_t)>& task) {
+  atomic<size_t> next_task(0);
+  auto worker = [&]() {
+    size_t i;
+    while ((i = next_task.fetch_add(1, memory_order_relaxed)) < num_tasks)
+      task(i);
+  };
+
+  size_t num_workers = min<size_t>(num_threads, num_tasks);
+  vector<thread> threads;
+  for (size_t i = 1; i < num_workers; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (thread& t : threads)
+    t.join();
+}
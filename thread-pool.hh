@@ -0,0 +1,25 @@
+#ifndef THREAD_POOL_HH
+#define THREAD_POOL_HH
+
+#include <cstddef>
+#include <functional>
+
+// Runs batches of independent tasks on a fixed number of threads. Tasks are
+// handed out one at a time from a shared counter, so long and short tasks
+// balance out without any up-front partitioning.
+class ThreadPool {
+  int num_threads;
+
+public:
+  // If num_threads <= 0, uses one thread per hardware thread
+  ThreadPool(int num_threads);
+
+  // Calls task(i) for every i in [0, num_tasks) and returns once all calls
+  // have finished. 'task' must be safe to call from several threads at
+  // once. The calling thread takes part in the work.
+  void run(size_t num_tasks, const std::function<void(size_t)>& task);
+
+  int get_num_threads() const { return num_threads; }
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "topology.hh"
+
+using namespace std;
+
+TopologyLink::TopologyLink() :
+  name(),
+  rate(0),
+  trace(),
+  delay(0),
+  buffer(-1),
+  queue("droptail"),
+  queue_args()
+{}
+
+TopologyFlow::TopologyFlow() :
+  name(),
+  route(),
+  count(1),
+  cctype("markovian"),
+  delta_conf("do_ss:auto:0.5"),
+  extra_delay(0),
+  onduration(-1),
+  offduration(0),
+  traffic_params("deterministic,num_cycles=1"),
+  ecn(false),
+  listen_port(0),
+  server()
+{}
+
+// Splits 'key=value' into its parts. 'value' is empty if there is no '='.
+static void split_option(const string& option, string& key, string& value) {
+  size_t pos = option.find('=');
+  key = option.substr(0, pos);
+  value = pos == string::npos ? "" : option.substr(pos + 1);
+}
+
+bool read_topology(const string& filename, Topology& topology) {
+  ifstream in(filename);
+  if (!in) {
+    fprintf(stderr, "Could not open topology %s.\n", filename.c_str());
+    return false;
+  }
+
+  topology = Topology();
+  map<string, int> link_ids;
+  string line;
+  int line_num = 0;
+  while (getline(in, line)) {
+    ++ line_num;
+    line = line.substr(0, line.find('#'));
+    stringstream ss(line);
+    string kind, name;
+    if (!(ss >> kind))
+      continue;
+    if ((kind != "link" && kind != "flow") || !(ss >> name) ||
+        name.find('=') != string::npos) {
+      fprintf(stderr, "%s:%d: expected 'link <name> ...' or 'flow <name> ...'.\n",
+              filename.c_str(), line_num);
+      return false;
+    }
+
+    TopologyLink link;
+    TopologyFlow flow;
+    link.name = flow.name = name;
+    double start = 0, stop = -1;
+    bool on_off = false;
+    string option, key, value;
+    while (ss >> option) {
+      split_option(option, key, value);
+      bool known = true;
+      if (kind == "link") {
+        if (key == "rate")
+          link.rate = atof(value.c_str());
+        else if (key == "trace")
+          link.trace = value;
+        else if (key == "delay")
+          link.delay = atof(value.c_str());
+        else if (key == "buffer")
+          link.buffer = atoi(value.c_str());
+        else if (key == "queue")
+          link.queue = value;
+        else if (key == "queue_args")
+          link.queue_args = value;
+        else
+          known = false;
+      }
+      else {
+        if (key == "route") {
+          stringstream route(value);
+          string hop;
+          while (getline(route, hop, ',')) {
+            if (link_ids.count(hop) == 0) {
+              fprintf(stderr, "%s:%d: unknown link '%s' (links must be defined before the flows using them).\n",
+                      filename.c_str(), line_num, hop.c_str());
+              return false;
+            }
+            int id = link_ids[hop];
+            if (find(flow.route.begin(), flow.route.end(), id) != flow.route.end()) {
+              fprintf(stderr, "%s:%d: route crosses link '%s' twice.\n",
+                      filename.c_str(), line_num, hop.c_str());
+              return false;
+            }
+            flow.route.push_back(id);
+          }
+        }
+        else if (key == "count")
+          flow.count = atoi(value.c_str());
+        else if (key == "cctype")
+          flow.cctype = value;
+        else if (key == "delta_conf")
+          flow.delta_conf = value;
+        else if (key == "extra_delay")
+          flow.extra_delay = atof(value.c_str());
+        else if (key == "start")
+          start = atof(value.c_str());
+        else if (key == "stop")
+          stop = atof(value.c_str());
+        else if (key == "onduration") {
+          flow.onduration = atof(value.c_str());
+          on_off = true;
+        }
+        else if (key == "offduration") {
+          flow.offduration = atof(value.c_str());
+          on_off = true;
+        }
+        else if (key == "traffic_params") {
+          flow.traffic_params = value;
+          on_off = true;
+        }
+        else if (key == "ecn")
+          flow.ecn = atoi(value.c_str()) != 0;
+        else if (key == "listenport")
+          flow.listen_port = atoi(value.c_str());
+        else if (key == "server")
+          flow.server = value;
+        else
+          known = false;
+      }
+      if (!known) {
+        fprintf(stderr, "%s:%d: unrecognised %s option '%s'.\n",
+                filename.c_str(), line_num, kind.c_str(), option.c_str());
+        return false;
+      }
+    }
+
+    if (kind == "link") {
+      if (link_ids.count(name)) {
+        fprintf(stderr, "%s:%d: link '%s' is defined twice.\n",
+                filename.c_str(), line_num, name.c_str());
+        return false;
+      }
+      if ((link.rate <= 0) == link.trace.empty() || link.delay < 0) {
+        fprintf(stderr, "%s:%d: a link needs either a positive 'rate' or a 'trace', and a non-negative 'delay'.\n",
+                filename.c_str(), line_num);
+        return false;
+      }
+      link_ids[name] = topology.links.size();
+      topology.links.push_back(link);
+    }
+    else {
+      if (flow.route.empty() || flow.count < 1 || flow.extra_delay < 0) {
+        fprintf(stderr, "%s:%d: a flow needs a 'route', a positive 'count' and a non-negative 'extra_delay'.\n",
+                filename.c_str(), line_num);
+        return false;
+      }
+      if (!on_off) {
+        if (start < 0 || (stop >= 0 && stop <= start)) {
+          fprintf(stderr, "%s:%d: need 0 <= start < stop.\n", filename.c_str(),
+                  line_num);
+          return false;
+        }
+        flow.offduration = start;
+        flow.onduration = stop < 0 ? -1 : stop - start;
+      }
+      topology.flows.push_back(flow);
+    }
+  }
+
+  if (topology.flows.empty()) {
+    fprintf(stderr, "Topology %s has no flows.\n", filename.c_str());
+    return false;
+  }
+
+  // Default buffers: one BDP of the longest path through the link
+  for (size_t i = 0; i < topology.links.size(); ++i) {
+    TopologyLink& link = topology.links[i];
+    if (link.buffer >= 0 || link.rate <= 0)
+      continue;
+    double max_rtt = 0;
+    for (const TopologyFlow& flow : topology.flows)
+      if (find(flow.route.begin(), flow.route.end(), int(i)) != flow.route.end())
+        max_rtt = max(max_rtt, propagation_rtt(topology, flow));
+    link.buffer = max(1, int(link.rate * max_rtt / 1000));
+  }
+  return true;
+}
+
+double propagation_rtt(const Topology& topology, const TopologyFlow& flow) {
+  double rtt = flow.extra_delay;
+  for (int link : flow.route)
+    rtt += 2 * topology.links[link].delay;
+  return rtt;
+}
+
+unique_ptr<QueueDisc> make_topology_queue(const Topology& topology, int link) {
+  const TopologyLink& l = topology.links[link];
+  string args = l.queue_args;
+  if (l.buffer >= 0 && l.queue != "infinite" &&
+      args.find("packets=") == string::npos && args.find("bytes=") == string::npos)
+    args = "packets=" + to_string(max(1, l.buffer)) + (args.empty() ? "" : ",") + args;
+  unique_ptr<QueueDisc> queue = make_queue_disc(l.queue, args);
+  if (queue == nullptr)
+    fprintf(stderr, "Invalid queue for link '%s'.\n", l.name.c_str());
+  return queue;
+}
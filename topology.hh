@@ -0,0 +1,108 @@
+#ifndef TOPOLOGY_HH
+#define TOPOLOGY_HH
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "queue-disc.hh"
+
+// Describes a network of links in series and the flows that cross them,
+// for the simulator (run_topology in dumbbell.hh) and the link emulator.
+// A topology file has one link or flow per line; '#' starts a comment:
+//
+//   # Parking lot: a flow over both links and cross traffic on each
+//   link l1 rate=1000 delay=10
+//   link l2 rate=1000 delay=10 queue=codel
+//   flow long route=l1,l2 cctype=markovian
+//   flow cross1 route=l1 cctype=tcp count=4
+//   flow cross2 route=l2 start=20000 stop=60000
+//
+// Link options:
+//   rate=       packets/s (of 1472 bytes in the simulator, or one mahimahi
+//               delivery opportunity each in the emulator)
+//   trace=      a mahimahi packet delivery trace instead of 'rate'
+//               (emulator only)
+//   delay=      one-way propagation delay (ms, default 0)
+//   buffer=     packets (default: one bandwidth-delay product of the
+//               longest RTT of the flows through the link; for a trace,
+//               the queue's own default, and droptail has none)
+//   queue=, queue_args=
+//               as for make_queue_disc (default droptail)
+//
+// Flow options:
+//   route=      the links crossed, in order (required). Flows can enter
+//               and leave anywhere along the path.
+//   count=      number of identical flows (default 1)
+//   cctype=, delta_conf=
+//               controller, as for ccsim (default markovian with
+//               do_ss:auto:0.5)
+//   extra_delay= added to the RTT (ms). ACKs otherwise come back over the
+//               reverse of the route with the same propagation delays.
+//   start=, stop=
+//               when the flow is on (ms, default the whole run)
+//   onduration=, offduration=, traffic_params=
+//               on-off traffic as for the sender, instead of start/stop
+//   ecn=        send ECN capable packets (0 or 1)
+//   listenport=, server=
+//               where the emulator accepts the flow's packets (default
+//               9000 + the flow's index) and the receiver it relays them
+//               to (ip:port, default the emulator's serverip:serverport)
+// Options a tool does not use are ignored by it.
+
+struct TopologyLink {
+  std::string name;
+  // Packets/s, or 0 if given by 'trace'
+  double rate;
+  std::string trace;
+  double delay;
+  // Packets. Negative until resolved by read_topology.
+  int buffer;
+  std::string queue;
+  std::string queue_args;
+
+  TopologyLink();
+};
+
+struct TopologyFlow {
+  std::string name;
+  // Indices into Topology::links
+  std::vector<int> route;
+  int count;
+  std::string cctype;
+  std::string delta_conf;
+  double extra_delay;
+  // As for SenderConfig. A negative onduration means until the end of the
+  // run.
+  double onduration;
+  double offduration;
+  std::string traffic_params;
+  bool ecn;
+  // 0 if not given
+  int listen_port;
+  // Empty if not given
+  std::string server;
+
+  TopologyFlow();
+};
+
+struct Topology {
+  std::vector<TopologyLink> links;
+  std::vector<TopologyFlow> flows;
+
+  Topology() : links(), flows() {}
+};
+
+// Parses 'filename' into 'topology'. Prints an error and returns false if
+// it cannot be read or is invalid.
+bool read_topology(const std::string& filename, Topology& topology);
+
+// RTT of 'flow' on an empty network, not counting transmission (ms)
+double propagation_rtt(const Topology& topology, const TopologyFlow& flow);
+
+// The queue of link 'link'. Prints an error and returns null if the queue
+// or its arguments are invalid.
+std::unique_ptr<QueueDisc> make_topology_queue(const Topology& topology,
+                                               int link);
+
+#endif
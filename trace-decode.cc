@@ -0,0 +1,218 @@
+// Converts a binary trace (see trace.hh) to CSV, or to a file per column
+// of raw doubles (for numpy.fromfile and the like).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "trace.hh"
+
+using namespace std;
+
+// A column of the output: a field of the record, or a field some events
+// name
+struct Column {
+  string name;
+  // Which field of TraceRecord::fields each event keeps it in, or -1
+  int field_of[NUM_TRACE_EVENTS];
+
+  explicit Column(const string& name) : name(name), field_of() {
+    fill(field_of, field_of + NUM_TRACE_EVENTS, -1);
+  }
+};
+
+static double value_of(const TraceRecord& r, int column,
+                       const vector<Column>& extra) {
+  switch (column) {
+  case 0: return r.thread;
+  case 1: return r.wall_time / 1e6;
+  case 2: return r.time;
+  case 3: return r.event;
+  case 4: return r.seq;
+  case 5: return r.cwnd;
+  case 6: return r.rate;
+  case 7: return r.rtt;
+  }
+  int field = extra[column - 8].field_of[r.event];
+  return field < 0 ? NAN : r.fields[field];
+}
+
+int main(int argc, char* argv[]) {
+  string filename, format = "csv", out, event_name;
+  bool sorted = true;
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+    if (arg.substr(0, 5) == "file=")
+      filename = arg.substr(5);
+    else if (arg.substr(0, 7) == "format=")
+      format = arg.substr(7);
+    else if (arg.substr(0, 4) == "out=")
+      out = arg.substr(4);
+    else if (arg.substr(0, 6) == "event=")
+      event_name = arg.substr(6);
+    else if (arg.substr(0, 5) == "sort=")
+      sorted = atoi(arg.substr(5).c_str()) != 0;
+    else {
+      fprintf(stderr, "Unrecognised option '%s'.\n", arg.c_str());
+      filename = "";
+      break;
+    }
+  }
+  if (filename == "" || (format != "csv" && format != "columns") ||
+      (format == "columns" && out == "")) {
+    fprintf(stderr, "Usage: trace-decode file=(trace) [format=csv|columns] [out=(file for csv, default stdout; prefix for columns)] [event=(name, default all)] [sort=(0 to keep the order of the file)]\n");
+    exit(1);
+  }
+
+  int only_event = -1;
+  if (event_name != "") {
+    for (int e = 0; e < NUM_TRACE_EVENTS; e++)
+      if (event_name == trace_events[e].name)
+        only_event = e;
+    if (only_event < 0) {
+      fprintf(stderr, "Unknown event '%s'.\n", event_name.c_str());
+      exit(1);
+    }
+  }
+
+  FILE* in = fopen(filename.c_str(), "rb");
+  if (in == nullptr) {
+    perror(filename.c_str());
+    exit(1);
+  }
+  TraceFileHeader header;
+  if (fread(&header, sizeof(header), 1, in) != 1 ||
+      memcmp(header.magic, trace_magic, sizeof(trace_magic)) != 0) {
+    fprintf(stderr, "%s is not a trace.\n", filename.c_str());
+    exit(1);
+  }
+  if (header.version != trace_version) {
+    fprintf(stderr, "%s has unsupported version %u.\n", filename.c_str(),
+            header.version);
+    exit(1);
+  }
+  if (header.record_size != sizeof(TraceRecord)) {
+    fprintf(stderr, "%s has records of %u bytes; expected %zu.\n",
+            filename.c_str(), header.record_size, sizeof(TraceRecord));
+    exit(1);
+  }
+
+  vector<TraceRecord> records;
+  const size_t chunk = 1 << 16;
+  while (true) {
+    size_t n = records.size();
+    records.resize(n + chunk);
+    size_t got = fread(&records[n], sizeof(TraceRecord), chunk, in);
+    records.resize(n + got);
+    if (got < chunk)
+      break;
+  }
+  fclose(in);
+  if (only_event >= 0)
+    records.erase(remove_if(records.begin(), records.end(),
+                            [only_event](const TraceRecord& r) {
+                              return r.event != only_event;
+                            }),
+                  records.end());
+  for (const auto& r : records)
+    if (r.event >= NUM_TRACE_EVENTS) {
+      fprintf(stderr, "%s has an event of unknown type %u.\n",
+              filename.c_str(), r.event);
+      exit(1);
+    }
+  // Each thread's records are in order, but the threads are interleaved
+  // as they were drained
+  if (sorted)
+    stable_sort(records.begin(), records.end(),
+                [](const TraceRecord& a, const TraceRecord& b) {
+                  return a.wall_time < b.wall_time;
+                });
+
+  // The named fields of the events in the output, in order of first use
+  vector<bool> present(NUM_TRACE_EVENTS, false);
+  for (const auto& r : records)
+    present[r.event] = true;
+  vector<Column> extra;
+  for (int e = 0; e < NUM_TRACE_EVENTS; e++) {
+    if (!present[e])
+      continue;
+    for (int f = 0; f < TRACE_FIELDS && trace_events[e].fields[f]; f++) {
+      string name = trace_events[e].fields[f];
+      auto it = find_if(extra.begin(), extra.end(),
+                        [&name](const Column& c) { return c.name == name; });
+      if (it == extra.end()) {
+        extra.push_back(Column(name));
+        it = extra.end() - 1;
+      }
+      it->field_of[e] = f;
+    }
+  }
+  vector<string> names = {"thread", "wall_time", "time", "event", "seq",
+                          "cwnd", "rate", "rtt"};
+  for (const auto& c : extra)
+    names.push_back(c.name);
+
+  if (format == "csv") {
+    FILE* f = out == "" ? stdout : fopen(out.c_str(), "w");
+    if (f == nullptr) {
+      perror(out.c_str());
+      exit(1);
+    }
+    for (size_t c = 0; c < names.size(); c++)
+      fprintf(f, "%s%s", c ? "," : "", names[c].c_str());
+    fprintf(f, "\n");
+    for (const auto& r : records) {
+      fprintf(f, "%u,%.6f", r.thread, r.wall_time / 1e6);
+      for (size_t c = 2; c < names.size(); c++) {
+        double v = value_of(r, c, extra);
+        if (c == 3)
+          fprintf(f, ",%s", trace_events[r.event].name);
+        else if (std::isnan(v))
+          fputs(",", f);
+        else
+          fprintf(f, ",%.9g", v);
+      }
+      fprintf(f, "\n");
+    }
+    if (f != stdout && fclose(f) != 0) {
+      perror(out.c_str());
+      exit(1);
+    }
+    return 0;
+  }
+
+  // A file of doubles per column, and <out>.columns naming them and the
+  // event numbers
+  string index_name = out + ".columns";
+  FILE* index = fopen(index_name.c_str(), "w");
+  if (index == nullptr) {
+    perror(index_name.c_str());
+    exit(1);
+  }
+  fprintf(index, "# %zu rows of float64 in %s.<column>.f64\n", records.size(),
+          out.c_str());
+  for (const auto& name : names)
+    fprintf(index, "column %s\n", name.c_str());
+  for (int e = 0; e < NUM_TRACE_EVENTS; e++)
+    fprintf(index, "event %d %s\n", e, trace_events[e].name);
+  fclose(index);
+
+  vector<double> values(records.size());
+  for (size_t c = 0; c < names.size(); c++) {
+    for (size_t i = 0; i < records.size(); i++)
+      values[i] = value_of(records[i], c, extra);
+    string name = out + "." + names[c] + ".f64";
+    FILE* f = fopen(name.c_str(), "wb");
+    if (f == nullptr || fwrite(values.data(), sizeof(double), values.size(), f)
+        != values.size()) {
+      perror(name.c_str());
+      exit(1);
+    }
+    fclose(f);
+  }
+  return 0;
+}
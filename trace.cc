@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "trace.hh"
+
+const TraceEventInfo trace_events[NUM_TRACE_EVENTS] = {
+  {"dropped", {"records"}},
+  // On every ACK, from MarkovianCC::update_intersend_time
+  {"copa_window", {"target_window", "min_rtt", "delta", "update_amt",
+                   "slow_start"}},
+  // When delta changes
+  {"copa_delta", {"delta", "previous_delta", "pkt_lost", "loss_sensitive"}},
+  // An ACK that skipped over packets
+  {"copa_loss", {"num_pkts_lost", "reduced"}},
+  // Every rate update, as SlowConv::log_state
+  {"slowconv_state", {"state", "prev_measured_sending_rate",
+                      "cum_segs_sent", "cum_segs_delivered",
+                      "cum_segs_lost", "expected_cum_sent"}},
+  // Every rate update, as SlowConv::log_beliefs
+  {"slowconv_beliefs", {"min_qdel", "min_c", "max_c", "min_c_lambda",
+                        "bq_belief1", "bq_belief2",
+                        "prev_consistent_min_c_lambda"}},
+};
+
+std::atomic<Tracer*> Tracer::active(nullptr);
+
+// Tells tracers apart, even at the same address
+static std::atomic<uint64_t> num_tracers(0);
+
+// The ring of this thread and the tracer it belongs to
+static thread_local uint64_t ring_owner = 0;
+static thread_local void* this_thread_ring = nullptr;
+
+Tracer::Ring::Ring(uint16_t thread)
+  : records(new TraceRecord[capacity]), thread(thread), cached_tail(0),
+    dropped(0), padding1(), head(0), padding2(), tail(0), padding3()
+{}
+
+Tracer::Tracer(const std::string& filename)
+  : id(++num_tracers), file(nullptr),
+    start(std::chrono::steady_clock::now()), rings_lock(), rings(),
+    stop(false), drainer()
+{
+  if (active.load() != nullptr) {
+    fprintf(stderr, "Only one trace can be recorded at a time.\n");
+    exit(1);
+  }
+  file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    perror(filename.c_str());
+    exit(1);
+  }
+  setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+  TraceFileHeader header;
+  memcpy(header.magic, trace_magic, sizeof(trace_magic));
+  header.version = trace_version;
+  header.record_size = sizeof(TraceRecord);
+  header.start_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+  fwrite(&header, sizeof(header), 1, file);
+
+  drainer = std::thread(&Tracer::run, this);
+  active.store(this, std::memory_order_release);
+}
+
+Tracer::~Tracer() {
+  active.store(nullptr, std::memory_order_release);
+  stop = true;
+  drainer.join();
+  drain();
+
+  // Say how many records were lost, if any
+  for (const auto& ring : rings) {
+    uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+    if (dropped == 0)
+      continue;
+    TraceRecord r;
+    r.wall_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+    r.time = r.cwnd = r.rate = r.rtt = std::numeric_limits<double>::quiet_NaN();
+    r.event = TRACE_DROPPED;
+    r.thread = ring->thread;
+    r.seq = -1;
+    std::fill(r.fields, r.fields + TRACE_FIELDS, r.time);
+    r.fields[0] = dropped;
+    fwrite(&r, sizeof(r), 1, file);
+    fprintf(stderr, "The trace lost %llu records of thread %u.\n",
+            (unsigned long long) dropped, ring->thread);
+  }
+  if (fclose(file) != 0)
+    perror("fclose");
+}
+
+Tracer::Ring* Tracer::ring_of_this_thread() {
+  if (ring_owner != id) {
+    std::lock_guard<std::mutex> lock(rings_lock);
+    rings.emplace_back(new Ring(rings.size()));
+    ring_owner = id;
+    this_thread_ring = rings.back().get();
+  }
+  return static_cast<Ring*>(this_thread_ring);
+}
+
+void Tracer::record(TraceEvent event, double time, int seq, double cwnd,
+                    double rate, double rtt,
+                    std::initializer_list<double> fields) {
+  Ring* ring = ring_of_this_thread();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->cached_tail >= Ring::capacity) {
+    ring->cached_tail = ring->tail.load(std::memory_order_acquire);
+    if (head - ring->cached_tail >= Ring::capacity) {
+      ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  TraceRecord& r = ring->records[head & (Ring::capacity - 1)];
+  r.wall_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  r.time = time;
+  r.event = event;
+  r.thread = ring->thread;
+  r.seq = seq;
+  r.cwnd = cwnd;
+  r.rate = rate;
+  r.rtt = rtt;
+  int i = 0;
+  for (auto it = fields.begin(); it != fields.end() && i < TRACE_FIELDS; ++it)
+    r.fields[i++] = *it;
+  for (; i < TRACE_FIELDS; i++)
+    r.fields[i] = std::numeric_limits<double>::quiet_NaN();
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::drain() {
+  std::lock_guard<std::mutex> lock(rings_lock);
+  for (const auto& ring : rings) {
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    // In at most two pieces, as the records may wrap around
+    while (tail != head) {
+      uint64_t begin = tail & (Ring::capacity - 1);
+      uint64_t n = std::min(head - tail, Ring::capacity - begin);
+      fwrite(&ring->records[begin], sizeof(TraceRecord), n, file);
+      tail += n;
+    }
+    ring->tail.store(tail, std::memory_order_release);
+  }
+}
+
+void Tracer::run() {
+  while (!stop) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    drain();
+  }
+}
@@ -0,0 +1,137 @@
+#ifndef TRACE_HH
+#define TRACE_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Binary trace of controller events, cheap enough to leave on at full
+// rate (unlike the text logs, which flush a line per event). Each thread
+// appends fixed size records to a ring of its own, without locks or
+// system calls, and a background thread drains the rings into the file.
+// A record that finds its ring full is dropped and counted. See
+// trace-decode.cc to convert a trace to CSV or columns.
+
+enum TraceEvent : uint16_t {
+  // fields[0]: records lost because the ring of 'thread' was full
+  TRACE_DROPPED = 0,
+  // MarkovianCC (Copa), see trace_events in trace.cc for the fields
+  TRACE_COPA_WINDOW,
+  TRACE_COPA_DELTA,
+  TRACE_COPA_LOSS,
+  // SlowConv
+  TRACE_SLOWCONV_STATE,
+  TRACE_SLOWCONV_BELIEFS,
+  NUM_TRACE_EVENTS
+};
+
+const int TRACE_FIELDS = 7;
+
+struct TraceRecord {
+  // ns since the trace started
+  uint64_t wall_time;
+  // On the clock of the controller, ms
+  double time;
+  uint16_t event;
+  // Index of the ring, in the order threads first traced
+  uint16_t thread;
+  // Of the packet, or -1
+  int32_t seq;
+  // Window (packets), sending rate (packets/s) and RTT (ms), NaN if
+  // unknown
+  double cwnd;
+  double rate;
+  double rtt;
+  // Event specific, NaN if unused
+  double fields[TRACE_FIELDS];
+};
+
+struct TraceEventInfo {
+  const char* name;
+  const char* fields[TRACE_FIELDS];
+};
+// Indexed by TraceEvent. Unused fields have a nullptr name.
+extern const TraceEventInfo trace_events[NUM_TRACE_EVENTS];
+
+const char trace_magic[8] = {'G', 'C', 'C', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t trace_version = 1;
+
+// Followed by the records
+struct TraceFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  // Unix time the trace started, ns
+  uint64_t start_time;
+};
+
+class Tracer {
+  // Single producer (its thread), single consumer (the drain thread)
+  struct Ring {
+    static const uint64_t capacity = 1 << 14;
+    std::unique_ptr<TraceRecord[]> records;
+    uint16_t thread;
+    // The producer's, so that it rarely reads 'tail'
+    uint64_t cached_tail;
+    // Written by the producer only, read once it has stopped
+    std::atomic<uint64_t> dropped;
+    char padding1[64];
+    std::atomic<uint64_t> head;
+    char padding2[64];
+    // The consumer's, alone on its line
+    std::atomic<uint64_t> tail;
+    char padding3[64];
+
+    explicit Ring(uint16_t thread);
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+  };
+
+  static std::atomic<Tracer*> active;
+
+  uint64_t id;
+  FILE* file;
+  std::chrono::steady_clock::time_point start;
+  std::mutex rings_lock;
+  std::vector<std::unique_ptr<Ring>> rings;
+  std::atomic<bool> stop;
+  std::thread drainer;
+
+  Ring* ring_of_this_thread();
+  // Writes what the rings hold to the file
+  void drain();
+  void run();
+
+ public:
+  // Traces to 'filename' until destroyed, which must be after the last
+  // event is traced. Exits on failure.
+  explicit Tracer(const std::string& filename);
+  ~Tracer();
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  // The tracer in use, if any
+  static Tracer* instance() { return active.load(std::memory_order_acquire); }
+
+  // Up to TRACE_FIELDS event specific fields
+  void record(TraceEvent event, double time, int seq, double cwnd,
+              double rate, double rtt, std::initializer_list<double> fields);
+};
+
+// Traces an event if tracing is on; a load and a branch otherwise
+inline void trace(TraceEvent event, double time, int seq, double cwnd,
+                  double rate, double rtt,
+                  std::initializer_list<double> fields = {}) {
+  Tracer* tracer = Tracer::instance();
+  if (tracer != nullptr)
+    tracer->record(event, time, seq, cwnd, rate, rtt, fields);
+}
+
+#endif
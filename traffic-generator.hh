@@ -1,14 +1,19 @@
 #ifndef TRAFFIC_GENERATOR_HH
 #define TRAFFIC_GENERATOR_HH
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <thread>
 #include <vector>
 
 #include <boost/random/uniform_int_distribution.hpp>
 
 #include "exponential.hh"
+#include "flow-size-distribution.hh"
 #include "random.hh"
 #include "remycc.hh"
+#include "results.hh"
 
 
 template<class T>
@@ -32,7 +37,28 @@ private:
 
 	std::vector< std::thread > _senders;
 
+	// Flow sizes from an empirical distribution ('cdf='), which replace
+	// the on durations. With 'load=', flows arrive as a Poisson process
+	// offering that fraction of 'link_mbps' instead of after the off
+	// durations. Flows of a sender run one after another, so one that
+	// arrives while another runs waits; its completion time counts from
+	// its arrival.
+	FlowSizeDistribution _flow_sizes;
+	double _load;
+	double _link_mbps;
+	// ms. Twice it (the handshake and the last ACK) is added to the time
+	// a flow would take alone at the link rate to get the completion time
+	// its slowdown is relative to.
+	double _base_rtt;
+
+	// Of each sized flow
+	struct FlowCompletion {
+		double size, fct, slowdown;
+	};
+	std::vector< FlowCompletion > _completions;
+
 	void send_data(int seed, int id);
+	void print_completions();
 
 public:
 	TrafficGenerator(T &s_ctcp, double s_mean_on_unit, double s_mean_off_unit, std::string traffic_params)
@@ -40,11 +66,19 @@ public:
 			_switch_type(SwitchType::TIME_SWITCHED),
 			_traffic_params({ s_mean_off_unit, s_mean_on_unit, (unsigned int)-1 }),
 			_ctcp(s_ctcp),
-			_senders()
+			_senders(),
+			_flow_sizes(),
+			_load(0),
+			_link_mbps(0),
+			_base_rtt(0),
+			_completions()
 	{
 		_traffic_params._on_off._mean_on_unit = s_mean_on_unit;
 		_traffic_params._on_off._mean_off_unit = s_mean_off_unit;
 
+		std::string cdf_file;
+		double cdf_unit = 1;
+
 		// parse traffic_params
 		size_t start_pos = 0;
 		while (start_pos < traffic_params.length()) {
@@ -63,11 +97,28 @@ public:
 			else if (arg.substr(0, 11) == "num_cycles=")
 				_traffic_params._on_off.num_cycles = (unsigned int) \
 					atoi(arg.substr(11).c_str());
+			else if (arg.substr(0, 4) == "cdf=")
+				cdf_file = arg.substr(4);
+			else if (arg.substr(0, 9) == "cdf_unit=")
+				cdf_unit = atof(arg.substr(9).c_str());
+			else if (arg.substr(0, 5) == "load=")
+				_load = atof(arg.substr(5).c_str());
+			else if (arg.substr(0, 10) == "link_mbps=")
+				_link_mbps = atof(arg.substr(10).c_str());
+			else if (arg.substr(0, 9) == "base_rtt=")
+				_base_rtt = atof(arg.substr(9).c_str());
 			else 
 				std::cout << "Unrecognised parameter: " << arg << endl;
 
 			start_pos = end_pos + 1;
 		}
+
+		if (cdf_file != "" && !_flow_sizes.load(cdf_file, cdf_unit))
+			exit(1);
+		if (_load > 0 && (!_flow_sizes.loaded() || _link_mbps <= 0)) {
+			fprintf(stderr, "An offered load needs 'cdf=' and 'link_mbps='.\n");
+			exit(1);
+		}
 	}
 
 	void spawn_senders(int num_senders);
@@ -79,6 +130,13 @@ void TrafficGenerator<T>::send_data(int seed, int id) {
 	Exponential on (1 / _traffic_params._on_off._mean_on_unit, prng);
 	Exponential off (1 / _traffic_params._on_off._mean_off_unit, prng);
 
+	// Bytes per ms of the link, and the mean time between arrivals to
+	// offer the load
+	double link_rate = _link_mbps * 1e3 / 8;
+	bool sized = _flow_sizes.loaded();
+	Exponential arrivals(_load > 0 ? _load * link_rate / _flow_sizes.mean() : 1, prng);
+	std::chrono::steady_clock::time_point arrival = std::chrono::steady_clock::now();
+
 	unsigned int flow_id = 0;
 	while (1) {
 		double off_duration = off.sample();
@@ -88,18 +146,82 @@ void TrafficGenerator<T>::send_data(int seed, int id) {
 			off_duration = _traffic_params._on_off._mean_off_unit;
 			on_duration = _traffic_params._on_off._mean_on_unit;
 		}
+		if (sized)
+			on_duration = _flow_sizes.sample(prng);
 
-		std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(unsigned(off_duration)));
+		if (_load > 0) {
+			arrival += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double, std::milli>(arrivals.sample()));
+			std::this_thread::sleep_until(arrival);
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(unsigned(off_duration)));
+			arrival = std::chrono::steady_clock::now();
+		}
 
-		bool byte_switched = (_switch_type == SwitchType::BYTE_SWITCHED);
+		bool byte_switched = sized || (_switch_type == SwitchType::BYTE_SWITCHED);
 		_ctcp.send_data(on_duration, byte_switched, flow_id, id);
 
+		if (sized) {
+			double fct = std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - arrival).count();
+			// The FCT includes each flow's handshake, so the ideal does too
+			double ideal = 2 * _base_rtt + on_duration / link_rate;
+			double slowdown = (_link_mbps > 0) ? fct / ideal : NAN;
+			_completions.push_back({on_duration, fct, slowdown});
+			std::cout<<"Flow completion time: "<<fct<<" ms, slowdown "<<slowdown<<endl;
+			if (ResultLog::instance() != nullptr) {
+				ResultRecord record("fct");
+				record.add("src_id", id)
+					.add("flow_id", flow_id)
+					.add("size_bytes", on_duration)
+					.add("fct_ms", fct)
+					.add("slowdown", slowdown);
+				ResultLog::instance()->write(record);
+			}
+		}
+
 		++ flow_id;
 		std::cout<<"Sender: "<<id<<", Flow: "<<flow_id<<". Transmitted for "<<on_duration<<(byte_switched?" bytes.":" ms.")<<endl<<std::flush;
 
 		if (flow_id >= _traffic_params._on_off.num_cycles)
 			break;
 	}
+	if (sized)
+		print_completions();
+}
+
+// Completion times and slowdowns of small, medium and large flows, as in
+// the pFabric paper
+template<class T>
+void TrafficGenerator<T>::print_completions() {
+	const double bounds[] = {100e3, 10e6, INFINITY};
+	const char* names[] = {"(0, 100KB]", "(100KB, 10MB]", "(10MB, inf)"};
+	std::cout<<"\nFlow completion times (ms) and slowdowns of "<<_completions.size()<<" flows"<<endl;
+	double lower = 0;
+	for (int b = 0; b < 3; b++) {
+		std::vector< double > fcts, slowdowns;
+		for (const auto& c : _completions)
+			if (c.size > lower && c.size <= bounds[b]) {
+				fcts.push_back(c.fct);
+				slowdowns.push_back(c.slowdown);
+			}
+		lower = bounds[b];
+		if (fcts.empty())
+			continue;
+		std::sort(fcts.begin(), fcts.end());
+		std::sort(slowdowns.begin(), slowdowns.end());
+		size_t p99 = std::min(fcts.size() - 1, size_t(std::ceil(0.99 * fcts.size())) - 1);
+		double mean_fct = 0, mean_slowdown = 0;
+		for (size_t i = 0; i < fcts.size(); i++) {
+			mean_fct += fcts[i] / fcts.size();
+			mean_slowdown += slowdowns[i] / slowdowns.size();
+		}
+		char buf[256];
+		snprintf(buf, sizeof(buf), "\t%s: n=%zu FCT mean=%.3f p99=%.3f slowdown mean=%.3f p99=%.3f",
+			names[b], fcts.size(), mean_fct, fcts[p99], mean_slowdown, slowdowns[p99]);
+		std::cout<<buf<<endl;
+	}
 }
 
 template<class T>
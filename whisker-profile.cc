@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <functional>
+#include <unistd.h>
+
+#include "whisker-profile.hh"
+
+using namespace std;
+
+/* a cache line of counters */
+static const size_t padding = 64 / sizeof( atomic< uint64_t > );
+
+WhiskerProfile::Counters::Counters( const size_t num_leaves, const unsigned int datasize )
+  : _values( new atomic< uint64_t >[ 2 * padding + num_leaves * ( 1 + datasize * num_buckets ) ]() ),
+    _hits( _values.get() + padding ),
+    _buckets( _hits + num_leaves )
+{
+}
+
+template < typename MemoryType >
+WhiskerProfile::WhiskerProfile( const BasicWhiskerTree< MemoryType > & tree )
+  : _datasize( MemoryType::datasize ),
+    _leaves(),
+    _registry_lock(),
+    _counters()
+{
+  vector< const BasicWhisker< MemoryType > * > whiskers;
+  tree.leaves( whiskers );
+  for ( unsigned int n = 0; n < whiskers.size(); n++ ) {
+    const BasicWhisker< MemoryType > * w = whiskers[ n ];
+    const RemyBuffers::Whisker dna = w->DNA();
+    const MemoryType lower( true, dna.domain().lower() ), upper( false, dna.domain().upper() );
+    Leaf leaf = { n, w, vector< double >(), vector< double >(), int( dna.window_increment() ), dna.window_multiple(), dna.intersend() };
+    for ( unsigned int i = 0; i < MemoryType::datasize; i++ ) {
+      leaf.lower.push_back( lower.field( i ) );
+      leaf.upper.push_back( upper.field( i ) );
+    }
+    _leaves.push_back( leaf );
+  }
+  sort( _leaves.begin(), _leaves.end(),
+        [] ( const Leaf & a, const Leaf & b ) { return less< const void * >()( a.whisker, b.whisker ); } );
+}
+
+WhiskerProfile::WhiskerProfile( const FlatWhiskerTree & tree )
+  : _datasize( 0 ),
+    _leaves(),
+    _registry_lock(),
+    _counters()
+{
+  switch ( tree.memory_type() ) {
+  case RemyBuffers::MEMORY_WITH_LOSS_SIGNAL:
+    _datasize = MemoryWithLossSignal::datasize;
+    break;
+  case RemyBuffers::MEMORY_WITHOUT_SLOW_REWMA:
+    _datasize = MemoryWithoutSlowRewma::datasize;
+    break;
+  default:
+    _datasize = MemoryDefault::datasize;
+  }
+
+  /* the nodes, and so the leaves, are in ascending order already */
+  for ( unsigned int i = 0; i < tree.num_nodes(); i++ ) {
+    const FlatWhiskerNode & node = tree.node( i );
+    if ( node.num_children > 0 ) {
+      continue;
+    }
+    Leaf leaf = { i, &node.whisker,
+                  vector< double >( node.lower, node.lower + _datasize ),
+                  vector< double >( node.upper, node.upper + _datasize ),
+                  node.whisker.window_increment, node.whisker.window_multiple, node.whisker.intersend };
+    _leaves.push_back( leaf );
+  }
+}
+
+WhiskerProfile::Counters & WhiskerProfile::register_counters( void )
+{
+  lock_guard< mutex > lock( _registry_lock );
+  _counters.emplace_back( new Counters( _leaves.size(), _datasize ) );
+  return *_counters.back();
+}
+
+int WhiskerProfile::leaf_of( const void * whisker ) const
+{
+  auto it = lower_bound( _leaves.begin(), _leaves.end(), whisker,
+                         [] ( const Leaf & a, const void * w ) { return less< const void * >()( a.whisker, w ); } );
+  if ( it == _leaves.end() || it->whisker != whisker ) {
+    return -1;
+  }
+  return it - _leaves.begin();
+}
+
+int WhiskerProfile::bucket_of( const double value )
+{
+  if ( !( value > 0 ) ) {
+    return 0;
+  }
+  const double b = 1 + floor( 2 * ( log2( value ) - min_octave ) );
+  return int( max( 1.0, min( b, double( num_buckets - 1 ) ) ) );
+}
+
+/* The counters have a single writer, so a plain load and store suffice */
+static void increment( atomic< uint64_t > & counter )
+{
+  counter.store( counter.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+}
+
+template < typename MemoryType >
+void WhiskerProfile::record( Counters & counters, const void * whisker, const MemoryType & memory ) const
+{
+  const int leaf = leaf_of( whisker );
+  if ( leaf < 0 ) {
+    return;
+  }
+  increment( counters._hits[ leaf ] );
+  atomic< uint64_t > * buckets = counters._buckets + leaf * _datasize * num_buckets;
+  for ( unsigned int i = 0; i < MemoryType::datasize; i++ ) {
+    increment( buckets[ i * num_buckets + bucket_of( memory.field( i ) ) ] );
+  }
+}
+
+bool WhiskerProfile::dump( const string & filename )
+{
+  /* sum the counters of all controllers */
+  const size_t num_leaves = _leaves.size();
+  vector< uint64_t > hits( num_leaves, 0 ), buckets( num_leaves * _datasize * num_buckets, 0 );
+  {
+    lock_guard< mutex > lock( _registry_lock );
+    for ( const auto & c : _counters ) {
+      for ( size_t i = 0; i < hits.size(); i++ ) {
+        hits[ i ] += c->_hits[ i ].load( memory_order_relaxed );
+      }
+      for ( size_t i = 0; i < buckets.size(); i++ ) {
+        buckets[ i ] += c->_buckets[ i ].load( memory_order_relaxed );
+      }
+    }
+  }
+  uint64_t total = 0;
+  for ( const auto & h : hits ) {
+    total += h;
+  }
+
+  vector< size_t > order( num_leaves );
+  for ( size_t i = 0; i < num_leaves; i++ ) {
+    order[ i ] = i;
+  }
+  stable_sort( order.begin(), order.end(), [ &hits ] ( size_t a, size_t b ) { return hits[ a ] > hits[ b ]; } );
+
+  /* write to a temporary file and rename it, so that readers never see a
+     partial snapshot */
+  string tmpname = filename + ".tmp";
+  FILE * f = fopen( tmpname.c_str(), "w" );
+  if ( !f ) {
+    perror( "fopen" );
+    return false;
+  }
+  fprintf( f, "# whisker profile: %zu leaves, %llu hits\n", num_leaves, (unsigned long long) total );
+  fprintf( f, "# leaf\thits\tshare\twindow_increment\twindow_multiple\tintersend\tdomain\n" );
+  for ( const auto & i : order ) {
+    const Leaf & leaf = _leaves[ i ];
+    fprintf( f, "%u\t%llu\t%.4f\t%d\t%g\t%g\t", leaf.number, (unsigned long long) hits[ i ],
+             total ? double( hits[ i ] ) / total : 0.0,
+             leaf.window_increment, leaf.window_multiple, leaf.intersend );
+    for ( unsigned int j = 0; j < _datasize; j++ ) {
+      fprintf( f, "%s[%g, %g)", j ? " " : "", leaf.lower[ j ], leaf.upper[ j ] );
+    }
+    fprintf( f, "\n" );
+  }
+
+  fprintf( f, "# leaf\tsignal\thistogram (bucket lower bound:hits)\n" );
+  for ( const auto & i : order ) {
+    if ( hits[ i ] == 0 ) {
+      break;
+    }
+    for ( unsigned int j = 0; j < _datasize; j++ ) {
+      fprintf( f, "%u\t%u\t", _leaves[ i ].number, j );
+      const uint64_t * h = buckets.data() + ( i * _datasize + j ) * num_buckets;
+      bool first = true;
+      for ( int b = 0; b < num_buckets; b++ ) {
+        if ( h[ b ] == 0 ) {
+          continue;
+        }
+        const double bound = b == 0 ? 0 : exp2( min_octave + ( b - 1 ) / 2.0 );
+        fprintf( f, "%s%g:%llu", first ? "" : " ", bound, (unsigned long long) h[ b ] );
+        first = false;
+      }
+      fprintf( f, "\n" );
+    }
+  }
+
+  bool ok = !ferror( f );
+  ok = ( fclose( f ) == 0 ) && ok;
+  if ( !ok || rename( tmpname.c_str(), filename.c_str() ) < 0 ) {
+    perror( "write" );
+    unlink( tmpname.c_str() );
+    return false;
+  }
+  return true;
+}
+
+template WhiskerProfile::WhiskerProfile( const BasicWhiskerTree< MemoryDefault > & );
+template WhiskerProfile::WhiskerProfile( const BasicWhiskerTree< MemoryWithLossSignal > & );
+template WhiskerProfile::WhiskerProfile( const BasicWhiskerTree< MemoryWithoutSlowRewma > & );
+template void WhiskerProfile::record( Counters &, const void *, const MemoryDefault & ) const;
+template void WhiskerProfile::record( Counters &, const void *, const MemoryWithLossSignal & ) const;
+template void WhiskerProfile::record( Counters &, const void *, const MemoryWithoutSlowRewma & ) const;
+
+WhiskerProfileDumper::WhiskerProfileDumper( WhiskerProfile & profile, const string & filename )
+  : _profile( profile ),
+    _filename( filename ),
+    _watcher()
+{
+  _watcher.reset( new SignalWatcher( SIGUSR1, [ this ] ( bool requested ) {
+        if ( requested && _profile.dump( _filename ) ) {
+          fprintf( stderr, "Wrote the whisker profile to %s.\n", _filename.c_str() );
+        }
+      } ) );
+}
+
+WhiskerProfileDumper::~WhiskerProfileDumper()
+{
+  _watcher.reset();
+  _profile.dump( _filename );
+}
@@ -0,0 +1,106 @@
+#ifndef WHISKER_PROFILE_HH
+#define WHISKER_PROFILE_HH
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "flat-whiskers.hh"
+#include "signal-watcher.hh"
+#include "whiskertree.hh"
+
+/* Opt-in profile of how a whisker tree is used: how often each leaf is
+   hit, and a histogram of each memory signal over the hits of a leaf.
+   Hot leaves are candidates to refine, and never-hit subtrees to prune.
+
+   Every controller records into counters of its own (registered once,
+   cache-line padded, and only written by that controller's thread), so
+   recording takes no lock and no atomic read-modify-write. A snapshot
+   sums the counters while they are being written, so it may be slightly
+   behind, but never stops the flows.
+
+   A profile is of one tree, whose leaves it tells apart by address. */
+class WhiskerProfile {
+public:
+  /* 2 buckets per octave from 2^min_octave; bucket 0 counts values at or
+     below 0, and the last values beyond the range */
+  static const int num_buckets = 64;
+  static const int min_octave = -8;
+
+  class Counters {
+    friend class WhiskerProfile;
+    /* num_leaves hits, then per leaf and signal num_buckets counts, with a
+       cache line of padding on either side */
+    std::unique_ptr< std::atomic< uint64_t >[] > _values;
+    std::atomic< uint64_t > * _hits;
+    std::atomic< uint64_t > * _buckets;
+
+  public:
+    Counters( const size_t num_leaves, const unsigned int datasize );
+    Counters( const Counters & ) = delete;
+    Counters & operator=( const Counters & ) = delete;
+  };
+
+private:
+  struct Leaf {
+    /* depth-first position among the leaves of a tree, or node index in
+       a compiled tree */
+    unsigned int number;
+    /* the address of the whisker in the tree */
+    const void * whisker;
+    std::vector< double > lower, upper;
+    int window_increment;
+    double window_multiple;
+    double intersend;
+  };
+
+  unsigned int _datasize;
+  /* in ascending order of whisker address */
+  std::vector< Leaf > _leaves;
+
+  std::mutex _registry_lock;
+  std::vector< std::unique_ptr< Counters > > _counters;
+
+  int leaf_of( const void * whisker ) const;
+  static int bucket_of( const double value );
+
+public:
+  template < typename MemoryType >
+  explicit WhiskerProfile( const BasicWhiskerTree< MemoryType > & tree );
+  explicit WhiskerProfile( const FlatWhiskerTree & tree );
+
+  WhiskerProfile( const WhiskerProfile & ) = delete;
+  WhiskerProfile & operator=( const WhiskerProfile & ) = delete;
+
+  /* Counters for one controller, valid as long as the profile */
+  Counters & register_counters( void );
+
+  /* 'whisker' is the result of a lookup in the tree of the profile */
+  template < typename MemoryType >
+  void record( Counters & counters, const void * whisker, const MemoryType & memory ) const;
+
+  /* Writes a snapshot: a line per leaf, hottest first, with its share of
+     the hits, action and domain, followed by the histograms of the leaves
+     that were hit. Prints an error and returns false on failure. */
+  bool dump( const std::string & filename );
+};
+
+/* Dumps 'profile' to 'filename' whenever the process gets SIGUSR1, and
+   once more when destroyed */
+class WhiskerProfileDumper {
+  WhiskerProfile & _profile;
+  std::string _filename;
+  std::unique_ptr< SignalWatcher > _watcher;
+
+public:
+  WhiskerProfileDumper( WhiskerProfile & profile, const std::string & filename );
+  ~WhiskerProfileDumper();
+
+  WhiskerProfileDumper( const WhiskerProfileDumper & ) = delete;
+  WhiskerProfileDumper & operator=( const WhiskerProfileDumper & ) = delete;
+};
+
+#endif
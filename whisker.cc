@@ -7,18 +7,20 @@
 
 using namespace std;
 
-vector< Whisker > Whisker::bisect( void ) const
+template < typename MemoryType >
+vector< BasicWhisker< MemoryType > > BasicWhisker< MemoryType >::bisect( void ) const
 {
-  vector< Whisker > ret;
+  vector< BasicWhisker > ret;
   for ( auto &x : _domain.bisect() ) {
-    Whisker new_whisker( *this );
+    BasicWhisker new_whisker( *this );
     new_whisker._domain = x;
     ret.push_back( new_whisker );
   }
   return ret;
 }
 
-Whisker::Whisker( const unsigned int s_window_increment, const double s_window_multiple, const double s_intersend, const MemoryRange & s_domain )
+template < typename MemoryType >
+BasicWhisker< MemoryType >::BasicWhisker( const unsigned int s_window_increment, const double s_window_multiple, const double s_intersend, const MemoryRange & s_domain )
   : _generation( 0 ),
     _window_increment( s_window_increment ),
     _window_multiple( s_window_multiple ),
@@ -27,7 +29,8 @@ Whisker::Whisker( const unsigned int s_window_increment, const double s_window_m
 {
 }
 
-Whisker::Whisker( const Whisker & other )
+template < typename MemoryType >
+BasicWhisker< MemoryType >::BasicWhisker( const BasicWhisker & other )
   : _generation( other._generation ),
     _window_increment( other._window_increment ),
     _window_multiple( other._window_multiple ),
@@ -37,13 +40,31 @@ Whisker::Whisker( const Whisker & other )
 }
 
 template < typename T >
-bool Whisker::OptimizationSetting< T >::eligible_value( const T & value ) const
+bool WhiskerOptimizationSetting< T >::eligible_value( const T & value ) const
 {
   return value >= min_value and value <= max_value;
 }
 
 template < typename T >
-vector< T > Whisker::OptimizationSetting< T >::alternatives( const T & value ) const
+void WhiskerOptimizationSetting< T >::set_from_DNA( const RemyBuffers::OptimizationSetting & dna )
+{
+  if ( dna.has_min_value() ) min_value = dna.min_value();
+  if ( dna.has_max_value() ) max_value = dna.max_value();
+  if ( dna.has_min_change() ) min_change = dna.min_change();
+  if ( dna.has_max_change() ) max_change = dna.max_change();
+  if ( dna.has_multiplier() ) multiplier = dna.multiplier();
+  if ( dna.has_default_value() ) default_value = dna.default_value();
+}
+
+void WhiskerOptimizationSettings::set_from_DNA( const RemyBuffers::OptimizationSettings & dna )
+{
+  if ( dna.has_window_increment() ) window_increment.set_from_DNA( dna.window_increment() );
+  if ( dna.has_window_multiple() ) window_multiple.set_from_DNA( dna.window_multiple() );
+  if ( dna.has_intersend() ) intersend.set_from_DNA( dna.intersend() );
+}
+
+template < typename T >
+vector< T > WhiskerOptimizationSetting< T >::alternatives( const T & value ) const
 {
   assert( eligible_value( value ) );
 
@@ -68,14 +89,24 @@ vector< T > Whisker::OptimizationSetting< T >::alternatives( const T & value ) c
   return ret;
 }
 
-vector< Whisker > Whisker::next_generation( void ) const
+template < typename MemoryType >
+bool BasicWhisker< MemoryType >::eligible( const OptimizationSettings & settings ) const
 {
-  vector< Whisker > ret;
+  return _window_increment >= 0
+    and settings.window_increment.eligible_value( _window_increment )
+    and settings.window_multiple.eligible_value( _window_multiple )
+    and settings.intersend.eligible_value( _intersend );
+}
 
-  for ( const auto & alt_window : get_optimizer().window_increment.alternatives( _window_increment ) ) {
-    for ( const auto & alt_multiple : get_optimizer().window_multiple.alternatives( _window_multiple ) ) {
-      for ( const auto & alt_intersend : get_optimizer().intersend.alternatives( _intersend ) ) {
-	Whisker new_whisker { *this };
+template < typename MemoryType >
+vector< BasicWhisker< MemoryType > > BasicWhisker< MemoryType >::next_generation( const OptimizationSettings & settings ) const
+{
+  vector< BasicWhisker > ret;
+
+  for ( const auto & alt_window : settings.window_increment.alternatives( _window_increment ) ) {
+    for ( const auto & alt_multiple : settings.window_multiple.alternatives( _window_multiple ) ) {
+      for ( const auto & alt_intersend : settings.intersend.alternatives( _intersend ) ) {
+	BasicWhisker new_whisker { *this };
 	new_whisker._generation++;
 
 	new_whisker._window_increment = alt_window;
@@ -92,12 +123,14 @@ vector< Whisker > Whisker::next_generation( void ) const
   return ret;
 }
 
-void Whisker::promote( const unsigned int generation )
+template < typename MemoryType >
+void BasicWhisker< MemoryType >::promote( const unsigned int generation )
 {
   _generation = max( _generation, generation );
 }
 
-string Whisker::str( const unsigned int total ) const
+template < typename MemoryType >
+string BasicWhisker< MemoryType >::str( const unsigned int total ) const
 {
   char tmp[ 256 ];
   snprintf( tmp, 256, "{%s} gen=%u usage=%.4f => (win=%d + %f * win, intersend=%f)",
@@ -105,7 +138,8 @@ string Whisker::str( const unsigned int total ) const
   return tmp;
 }
 
-RemyBuffers::Whisker Whisker::DNA( void ) const
+template < typename MemoryType >
+RemyBuffers::Whisker BasicWhisker< MemoryType >::DNA( void ) const
 {
   RemyBuffers::Whisker ret;
 
@@ -117,7 +151,8 @@ RemyBuffers::Whisker Whisker::DNA( void ) const
   return ret;
 }
 
-Whisker::Whisker( const RemyBuffers::Whisker & dna )
+template < typename MemoryType >
+BasicWhisker< MemoryType >::BasicWhisker( const RemyBuffers::Whisker & dna )
   : _generation( 0 ),
     _window_increment( dna.window_increment() ),
     _window_multiple( dna.window_multiple() ),
@@ -126,19 +161,25 @@ Whisker::Whisker( const RemyBuffers::Whisker & dna )
 {
 }
 
-void Whisker::round( void )
+template < typename MemoryType >
+void BasicWhisker< MemoryType >::round( void )
 {
   _window_multiple = (1.0/10000.0) * int( 10000 * _window_multiple );
   _intersend = (1.0/10000.0) * int( 10000 * _intersend );
 }
 
-size_t hash_value( const Whisker & whisker )
+template < typename MemoryType >
+size_t BasicWhisker< MemoryType >::hash( void ) const
 {
   size_t seed = 0;
-  boost::hash_combine( seed, whisker._window_increment );
-  boost::hash_combine( seed, whisker._window_multiple );
-  boost::hash_combine( seed, whisker._intersend );
-  boost::hash_combine( seed, whisker._domain );
+  boost::hash_combine( seed, _window_increment );
+  boost::hash_combine( seed, _window_multiple );
+  boost::hash_combine( seed, _intersend );
+  boost::hash_combine( seed, _domain );
 
   return seed;
 }
+
+template class BasicWhisker< MemoryDefault >;
+template class BasicWhisker< MemoryWithLossSignal >;
+template class BasicWhisker< MemoryWithoutSlowRewma >;
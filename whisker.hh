@@ -7,7 +7,64 @@
 #include "memoryrange.hh"
 #include "dna.pb.h"
 
-class Whisker {
+/* The search space of the optimizer, the same for every memory type */
+template < typename T >
+struct WhiskerOptimizationSetting
+{
+  T min_value; /* the smallest the value can be */
+  T max_value; /* the biggest */
+
+  T min_change; /* the smallest change to the value in an optimization exploration step */
+  T max_change; /* the biggest change */
+
+  T multiplier; /* we will explore multiples of the min_change until we hit the max_change */
+  /* the multiplier defines which multiple (e.g. 1, 2, 4, 8... or 1, 3, 9, 27... ) */
+
+  T default_value;
+
+  std::vector< T > alternatives( const T & value ) const;
+  bool eligible_value( const T & value ) const;
+
+  /* overrides the fields that are set in 'dna' */
+  void set_from_DNA( const RemyBuffers::OptimizationSetting & dna );
+
+  RemyBuffers::OptimizationSetting DNA( void ) const
+  {
+    RemyBuffers::OptimizationSetting ret;
+
+    ret.set_min_value( min_value );
+    ret.set_max_value( max_value );
+    ret.set_min_change( min_change );
+    ret.set_max_change( max_change );
+    ret.set_multiplier( multiplier );
+    ret.set_default_value( default_value );
+
+    return ret;
+  }
+};
+
+struct WhiskerOptimizationSettings
+{
+  WhiskerOptimizationSetting< unsigned int > window_increment;
+  WhiskerOptimizationSetting< double > window_multiple;
+  WhiskerOptimizationSetting< double > intersend;
+
+  RemyBuffers::OptimizationSettings DNA( void ) const
+  {
+    RemyBuffers::OptimizationSettings ret;
+
+    ret.mutable_window_increment()->CopyFrom( window_increment.DNA() );
+    ret.mutable_window_multiple()->CopyFrom( window_multiple.DNA() );
+    ret.mutable_intersend()->CopyFrom( intersend.DNA() );
+
+    return ret;
+  }
+
+  void set_from_DNA( const RemyBuffers::OptimizationSettings & dna );
+};
+
+template < typename MemoryType >
+class BasicWhisker {
 private:
   unsigned int _generation;
 
@@ -15,13 +72,16 @@ private:
   double _window_multiple;
   double _intersend;
 
-  MemoryRange _domain;
+  BasicMemoryRange< MemoryType > _domain;
 
 public:
-  Whisker( const Whisker & other );
-  Whisker( const unsigned int s_window_increment, const double s_window_multiple, const double s_intersend, const MemoryRange & s_domain );
+  typedef BasicMemoryRange< MemoryType > MemoryRange;
+  typedef WhiskerOptimizationSettings OptimizationSettings;
+
+  BasicWhisker( const BasicWhisker & other );
+  BasicWhisker( const unsigned int s_window_increment, const double s_window_multiple, const double s_intersend, const MemoryRange & s_domain );
 
-  Whisker( const MemoryRange & s_domain ) : Whisker( get_optimizer().window_increment.default_value,
+  BasicWhisker( const MemoryRange & s_domain ) : BasicWhisker( get_optimizer().window_increment.default_value,
 						     get_optimizer().window_multiple.default_value,
 						     get_optimizer().intersend.default_value, s_domain ) {}
 
@@ -34,74 +94,28 @@ public:
   const double & intersend( void ) const { return _intersend; }
   const MemoryRange & domain( void ) const { return _domain; }
 
-  std::vector< Whisker > next_generation( void ) const;
+  std::vector< BasicWhisker > next_generation( void ) const { return next_generation( get_optimizer() ); }
+  std::vector< BasicWhisker > next_generation( const OptimizationSettings & settings ) const;
+  /* whether the actions are within the search space of 'settings' */
+  bool eligible( const OptimizationSettings & settings ) const;
 
   void promote( const unsigned int generation );
 
   std::string str( const unsigned int total=1 ) const;
 
-  std::vector< Whisker > bisect( void ) const;
+  std::vector< BasicWhisker > bisect( void ) const;
 
   void demote( const unsigned int generation ) { _generation = generation; }
 
   RemyBuffers::Whisker DNA( void ) const;
-  Whisker( const RemyBuffers::Whisker & dna );
+  BasicWhisker( const RemyBuffers::Whisker & dna );
 
   void round( void );
 
-  bool operator==( const Whisker & other ) const { return (_window_increment == other._window_increment) && (_window_multiple == other._window_multiple) && (_intersend == other._intersend) && (_domain == other._domain); }
-
-  friend size_t hash_value( const Whisker & whisker );
-
-  template < typename T >
-  struct OptimizationSetting
-  {
-    T min_value; /* the smallest the value can be */
-    T max_value; /* the biggest */
-
-    T min_change; /* the smallest change to the value in an optimization exploration step */
-    T max_change; /* the biggest change */
-
-    T multiplier; /* we will explore multiples of the min_change until we hit the max_change */
-    /* the multiplier defines which multiple (e.g. 1, 2, 4, 8... or 1, 3, 9, 27... ) */
-
-    T default_value;
+  bool operator==( const BasicWhisker & other ) const { return (_window_increment == other._window_increment) && (_window_multiple == other._window_multiple) && (_intersend == other._intersend) && (_domain == other._domain); }
 
-    std::vector< T > alternatives( const T & value ) const;
-    bool eligible_value( const T & value ) const;
-
-    RemyBuffers::OptimizationSetting DNA( void ) const
-    {
-      RemyBuffers::OptimizationSetting ret;
-
-      ret.set_min_value( min_value );
-      ret.set_max_value( max_value );
-      ret.set_min_change( min_change );
-      ret.set_max_change( max_change );
-      ret.set_multiplier( multiplier );
-      ret.set_default_value( default_value );
-
-      return ret;
-    }
-  };
-
-  struct OptimizationSettings
-  {
-    OptimizationSetting< unsigned int > window_increment;
-    OptimizationSetting< double > window_multiple;
-    OptimizationSetting< double > intersend;
-
-    RemyBuffers::OptimizationSettings DNA( void ) const
-    {
-      RemyBuffers::OptimizationSettings ret;
-
-      ret.mutable_window_increment()->CopyFrom( window_increment.DNA() );
-      ret.mutable_window_multiple()->CopyFrom( window_multiple.DNA() );
-      ret.mutable_intersend()->CopyFrom( intersend.DNA() );
-
-      return ret;
-    }
-  };
+  size_t hash( void ) const;
+  friend size_t hash_value( const BasicWhisker & whisker ) { return whisker.hash(); }
 
   static const OptimizationSettings & get_optimizer( void ) {
     static OptimizationSettings default_settings {
@@ -113,4 +127,6 @@ public:
   }
 };
 
+typedef BasicWhisker< Memory > Whisker;
+
 #endif
@@ -7,14 +7,16 @@
 
 using namespace std;
 
-WhiskerTree::WhiskerTree()
-  : _domain( Memory(), MAX_MEMORY() ),
+template < typename MemoryType >
+BasicWhiskerTree< MemoryType >::BasicWhiskerTree()
+  : _domain( MemoryType(), MemoryType::max_memory() ),
     _children(),
     _leaf( 1, Whisker( _domain ) )
 {
 }
 
-WhiskerTree::WhiskerTree( const Whisker & whisker, const bool bisect )
+template < typename MemoryType >
+BasicWhiskerTree< MemoryType >::BasicWhiskerTree( const Whisker & whisker, const bool bisect )
   : _domain( whisker.domain() ),
     _children(),
     _leaf()
@@ -23,12 +25,13 @@ WhiskerTree::WhiskerTree( const Whisker & whisker, const bool bisect )
     _leaf.push_back( whisker );
   } else {
     for ( auto &x : whisker.bisect() ) {
-      _children.push_back( WhiskerTree( x, false ) );
+      _children.push_back( BasicWhiskerTree( x, false ) );
     }
   }
 }
 
-void WhiskerTree::reset_counts( void )
+template < typename MemoryType >
+void BasicWhiskerTree< MemoryType >::reset_counts( void )
 {
   if ( is_leaf() ) {
     _leaf.front().reset_count();
@@ -39,7 +42,8 @@ void WhiskerTree::reset_counts( void )
   }
 }
 
-const Whisker & WhiskerTree::use_whisker( const Memory & _memory, const bool track ) const
+template < typename MemoryType >
+const BasicWhisker< MemoryType > & BasicWhiskerTree< MemoryType >::use_whisker( const MemoryType & _memory, const bool track ) const
 {
   const Whisker * ret( whisker( _memory ) );
 
@@ -59,7 +63,8 @@ const Whisker & WhiskerTree::use_whisker( const Memory & _memory, const bool tra
   return *ret;
 }
 
-const Whisker * WhiskerTree::whisker( const Memory & _memory ) const
+template < typename MemoryType >
+const BasicWhisker< MemoryType > * BasicWhiskerTree< MemoryType >::whisker( const MemoryType & _memory ) const
 {
   if ( !_domain.contains( _memory ) ) {
     return nullptr;
@@ -81,7 +86,8 @@ const Whisker * WhiskerTree::whisker( const Memory & _memory ) const
   return nullptr;
 }
 
-const Whisker * WhiskerTree::most_used( const unsigned int max_generation ) const
+template < typename MemoryType >
+const BasicWhisker< MemoryType > * BasicWhiskerTree< MemoryType >::most_used( const unsigned int max_generation ) const
 {
   if ( is_leaf() ) {
     if ( (_leaf.front().generation() <= max_generation)
@@ -108,7 +114,8 @@ const Whisker * WhiskerTree::most_used( const unsigned int max_generation ) cons
   return ret;
 }
 
-void WhiskerTree::reset_generation( void )
+template < typename MemoryType >
+void BasicWhiskerTree< MemoryType >::reset_generation( void )
 {
   if ( is_leaf() ) {
     assert( _leaf.size() == 1 );
@@ -121,7 +128,8 @@ void WhiskerTree::reset_generation( void )
   }
 }
 
-void WhiskerTree::promote( const unsigned int generation )
+template < typename MemoryType >
+void BasicWhiskerTree< MemoryType >::promote( const unsigned int generation )
 {
   if ( is_leaf() ) {
     assert( _leaf.size() == 1 );
@@ -134,7 +142,8 @@ void WhiskerTree::promote( const unsigned int generation )
   }
 }
 
-bool WhiskerTree::replace( const Whisker & w )
+template < typename MemoryType >
+bool BasicWhiskerTree< MemoryType >::replace( const Whisker & w )
 {
   if ( !_domain.contains( w.domain().range_median() ) ) {
     return false;
@@ -156,7 +165,8 @@ bool WhiskerTree::replace( const Whisker & w )
   return false;
 }
 
-bool WhiskerTree::replace( const Whisker & src, const WhiskerTree & dst )
+template < typename MemoryType >
+bool BasicWhiskerTree< MemoryType >::replace( const Whisker & src, const BasicWhiskerTree & dst )
 {
   if ( !_domain.contains( src.domain().range_median() ) ) {
     return false;
@@ -179,7 +189,8 @@ bool WhiskerTree::replace( const Whisker & src, const WhiskerTree & dst )
   return false;
 }
 
-unsigned int WhiskerTree::total_whisker_queries( void ) const
+template < typename MemoryType >
+unsigned int BasicWhiskerTree< MemoryType >::total_whisker_queries( void ) const
 {
   if ( is_leaf() ) {
     assert( _children.empty() );
@@ -190,16 +201,18 @@ unsigned int WhiskerTree::total_whisker_queries( void ) const
 		     _children.end(),
 		     0,
 		     []( const unsigned int sum, 
-			 const WhiskerTree & x )
+			 const BasicWhiskerTree & x )
 		     { return sum + x.total_whisker_queries(); } );
 }
 
-string WhiskerTree::str() const
+template < typename MemoryType >
+string BasicWhiskerTree< MemoryType >::str() const
 {
   return str( total_whisker_queries() );
 }
 
-string WhiskerTree::str( const unsigned int total ) const
+template < typename MemoryType >
+string BasicWhiskerTree< MemoryType >::str( const unsigned int total ) const
 {
   if ( is_leaf() ) {
     assert( _children.empty() );
@@ -216,7 +229,8 @@ string WhiskerTree::str( const unsigned int total ) const
   return ret;
 }
 
-unsigned int WhiskerTree::num_children( void ) const
+template < typename MemoryType >
+unsigned int BasicWhiskerTree< MemoryType >::num_children( void ) const
 {
   if ( is_leaf() ) {
     assert( _leaf.size() == 1 );
@@ -226,12 +240,26 @@ unsigned int WhiskerTree::num_children( void ) const
   return _children.size();
 }
 
-bool WhiskerTree::is_leaf( void ) const
+template < typename MemoryType >
+bool BasicWhiskerTree< MemoryType >::is_leaf( void ) const
 {
   return !_leaf.empty();
 }
 
-RemyBuffers::WhiskerTree WhiskerTree::DNA( void ) const
+template < typename MemoryType >
+void BasicWhiskerTree< MemoryType >::leaves( std::vector< const Whisker * > & out ) const
+{
+  if ( is_leaf() ) {
+    out.push_back( &_leaf.front() );
+  } else {
+    for ( const auto &x : _children ) {
+      x.leaves( out );
+    }
+  }
+}
+
+template < typename MemoryType >
+RemyBuffers::WhiskerTree BasicWhiskerTree< MemoryType >::DNA( void ) const
 {
   RemyBuffers::WhiskerTree ret;
 
@@ -245,13 +273,17 @@ RemyBuffers::WhiskerTree WhiskerTree::DNA( void ) const
     for ( auto &x : _children ) {
       RemyBuffers::WhiskerTree *child = ret.add_children();
       *child = x.DNA();
+      child->clear_memory_type();
     }
   }
 
+  ret.set_memory_type( MemoryType::type );
+
   return ret;
 }
 
-WhiskerTree::WhiskerTree( const RemyBuffers::WhiskerTree & dna )
+template < typename MemoryType >
+BasicWhiskerTree< MemoryType >::BasicWhiskerTree( const RemyBuffers::WhiskerTree & dna )
   : _domain( dna.domain() ),
     _children(),
     _leaf()
@@ -266,3 +298,7 @@ WhiskerTree::WhiskerTree( const RemyBuffers::WhiskerTree & dna )
     }
   }
 }
+
+template class BasicWhiskerTree< MemoryDefault >;
+template class BasicWhiskerTree< MemoryWithLossSignal >;
+template class BasicWhiskerTree< MemoryWithoutSlowRewma >;
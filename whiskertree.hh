@@ -7,26 +7,30 @@
 #include "memoryrange.hh"
 #include "dna.pb.h"
 
-class WhiskerTree {
+template < typename MemoryType >
+class BasicWhiskerTree {
+public:
+  typedef BasicWhisker< MemoryType > Whisker;
+
 private:
-  MemoryRange _domain;
+  BasicMemoryRange< MemoryType > _domain;
 
-  std::vector< WhiskerTree > _children;
+  std::vector< BasicWhiskerTree > _children;
   std::vector< Whisker > _leaf;
 
-  const Whisker * whisker( const Memory & _memory ) const;
+  const Whisker * whisker( const MemoryType & _memory ) const;
 
 public:
-  WhiskerTree();
+  BasicWhiskerTree();
 
-  WhiskerTree( const Whisker & whisker, const bool bisect );
+  BasicWhiskerTree( const Whisker & whisker, const bool bisect );
 
-  const Whisker & use_whisker( const Memory & _memory, const bool track ) const;
+  const Whisker & use_whisker( const MemoryType & _memory, const bool track ) const;
 
   void use_window( const unsigned int win ) const;
 
   bool replace( const Whisker & w );
-  bool replace( const Whisker & src, const WhiskerTree & dst );
+  bool replace( const Whisker & src, const BasicWhiskerTree & dst );
   const Whisker * most_used( const unsigned int max_generation ) const;
 
   void reset_counts( void );
@@ -41,8 +45,13 @@ public:
 
   bool is_leaf( void ) const;
 
+  /* appends the leaves in depth-first order */
+  void leaves( std::vector< const Whisker * > & out ) const;
+
   RemyBuffers::WhiskerTree DNA( void ) const;
-  WhiskerTree( const RemyBuffers::WhiskerTree & dna );
+  BasicWhiskerTree( const RemyBuffers::WhiskerTree & dna );
 };
 
+typedef BasicWhiskerTree< Memory > WhiskerTree;
+
 #endif